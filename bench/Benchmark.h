@@ -0,0 +1,145 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_BENCH_BENCHMARK_H_
+#define WPS_BENCH_BENCHMARK_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+namespace WPS {
+namespace Bench {
+
+/**
+ * Heap allocations made by the process, counted when the C library's
+ * allocator can be interposed (glibc), see \c Allocations::isCounted().
+ */
+struct Allocations
+{
+    Allocations()
+        : count(0)
+        , bytes(0)
+    {}
+
+    static bool isCounted();
+
+    /**
+     * @return the allocations made so far.
+     */
+    static Allocations get();
+
+    unsigned long long count;
+    unsigned long long bytes;
+};
+
+/**
+ * Runs operations back to back for a given time and reports
+ * nanoseconds, allocations and allocated bytes per operation.
+ */
+class Benchmark
+{
+public:
+
+    /**
+     * @param seconds how long each operation is measured for.
+     * @param filter only runs the operations whose name contains it,
+     *               all of them if \c NULL.
+     */
+    Benchmark(double seconds, const char* filter)
+        : _seconds(seconds)
+        , _filter(filter)
+    {
+        printf("%-36s %12s %12s %12s\n",
+               "benchmark", "ns/op", "allocs/op", "bytes/op");
+    }
+
+    /**
+     * Measure \c op, a functor called without arguments.
+     */
+    template <class Operation>
+    void run(const char* name, Operation& op)
+    {
+        if (_filter != NULL && strstr(name, _filter) == NULL)
+            return;
+
+        // Warm up caches and buffers reused from one call to the next
+        op();
+
+        // Find a batch long enough for the clock to be precise
+        unsigned long iterations = 1;
+        double elapsed;
+        for (;;)
+        {
+            elapsed = time(op, iterations);
+            if (elapsed >= CALIBRATION_SECONDS || elapsed >= _seconds)
+                break;
+            iterations *= 2;
+        }
+
+        if (elapsed < _seconds)
+        {
+            iterations = static_cast<unsigned long>(
+                iterations * (_seconds / elapsed)) + 1;
+        }
+
+        const Allocations before = Allocations::get();
+        elapsed = time(op, iterations);
+        const Allocations after = Allocations::get();
+
+        printf("%-36s %12.1f", name, elapsed * 1e9 / iterations);
+        if (Allocations::isCounted())
+        {
+            printf(" %12.1f %12.1f\n",
+                   static_cast<double>(after.count - before.count) / iterations,
+                   static_cast<double>(after.bytes - before.bytes) / iterations);
+        }
+        else
+            printf(" %12s %12s\n", "-", "-");
+
+        fflush(stdout);
+    }
+
+private:
+
+    static const double CALIBRATION_SECONDS;
+
+    static double now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    template <class Operation>
+    static double time(Operation& op, unsigned long iterations)
+    {
+        const double started = now();
+        for (unsigned long i = 0; i < iterations; ++i)
+            op();
+        return now() - started;
+    }
+
+private:
+
+    const double _seconds;
+    const char* const _filter;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Benchmark.h"
+
+#include "wifi/nl80211/Nl80211Scan.h"
+
+#include <memory>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <netlink/genl/genl.h>
+
+#include <linux/nl80211.h>
+
+namespace WPS {
+namespace Bench {
+
+using namespace WPS::SPI;
+
+/**
+ * Information elements of a typical beacon: SSID, supported rates,
+ * DS parameter set, RSN and a vendor specific element.
+ */
+static const unsigned char BEACON_IES[] = {
+    0x00, 11, 'x', 'f', 'i', 'n', 'i', 't', 'y', 'w', 'i', 'f', 'i',
+    0x01, 8, 0x82, 0x84, 0x8b, 0x96, 0x0c, 0x12, 0x18, 0x24,
+    0x03, 1, 6,
+    0x30, 20, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00,
+              0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f,
+              0xac, 0x02, 0x0c, 0x00,
+    0xdd, 7, 0x00, 0x50, 0xf2, 0x02, 0x00, 0x01, 0x00
+};
+
+/**
+ * A scan result as dumped by the kernel for \c NL80211_CMD_GET_SCAN.
+ */
+static nl_msg*
+newScanResult()
+{
+    static const unsigned char BSSID[] = { 0x00, 0x09, 0x5B, 0xC9, 0x17, 0xF0 };
+
+    nl_msg* msg = nlmsg_alloc();
+    if (! msg)
+        return NULL;
+
+    nlattr* bss = NULL;
+    if (! genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, 0, 0, 0,
+                      NL80211_CMD_NEW_SCAN_RESULTS, 0)
+            || ! (bss = nla_nest_start(msg, NL80211_ATTR_BSS))
+            || nla_put(msg, NL80211_BSS_BSSID, sizeof(BSSID), BSSID) < 0
+            || nla_put_u32(msg, NL80211_BSS_FREQUENCY, 2437) < 0
+            || nla_put_u16(msg, NL80211_BSS_BEACON_INTERVAL, 100) < 0
+            || nla_put_u16(msg, NL80211_BSS_CAPABILITY, 0x0411) < 0
+            || nla_put(msg, NL80211_BSS_INFORMATION_ELEMENTS,
+                       sizeof(BEACON_IES), BEACON_IES) < 0
+            || nla_put_u32(msg, NL80211_BSS_SIGNAL_MBM,
+                           static_cast<uint32_t>(-6700)) < 0
+            || nla_put_u32(msg, NL80211_BSS_SEEN_MS_AGO, 120) < 0
+            || nla_nest_end(msg, bss) < 0)
+    {
+        nlmsg_free(msg);
+        return NULL;
+    }
+
+    return msg;
+}
+
+class ParseAccessPoint
+{
+public:
+
+    ParseAccessPoint()
+        : _msg(newScanResult())
+    {
+        std::auto_ptr<Nl80211::AP> ap;
+        if (! _msg || ! Nl80211::parseAccessPoint(_msg, ap))
+        {
+            fprintf(stderr, "shlc-bench: nl80211 scan result not parsed\n");
+            exit(1);
+        }
+    }
+
+    ~ParseAccessPoint()
+    {
+        nlmsg_free(_msg);
+    }
+
+    void operator()()
+    {
+        std::auto_ptr<Nl80211::AP> ap;
+        Nl80211::parseAccessPoint(_msg, ap);
+    }
+
+private:
+
+    ParseAccessPoint(const ParseAccessPoint&);
+    ParseAccessPoint& operator=(const ParseAccessPoint&);
+
+private:
+
+    nl_msg* const _msg;
+};
+
+void
+runNl80211Benchmarks(Benchmark& benchmark)
+{
+    ParseAccessPoint parseAccessPoint;
+    benchmark.run("nl80211 parseAccessPoint", parseAccessPoint);
+}
+
+}
+}
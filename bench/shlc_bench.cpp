@@ -0,0 +1,786 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Microbenchmarks of the code run for every location request,
+ * on synthetic scans and one second of typical GPS output:
+ *
+ *   shlc-bench [-t seconds per benchmark] [name filter]
+ *
+ * Configure a release build with -DWPS_MAX_LOG_LEVEL=info
+ * (or -DWPS_SPI_LOGGER=null) so that debug logging isn't measured.
+ */
+
+#include "Benchmark.h"
+
+#include "LocationRSDecoder.h"
+#include "Protocol.h"
+#include "XmlUtils.h"
+
+#include "spi/DOM.h"
+#include "spi/MAC.h"
+#include "spi/XmlParser.h"
+
+#include "nmea/NMEA.h"
+#include "nmea/Info.h"
+
+#include "gps/protocol/sirf/SirfProtocol.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+using namespace WPS::API;
+using namespace WPS::SPI;
+using namespace WPS::Bench;
+
+#ifdef SHLC_BENCH_NL80211
+namespace WPS {
+namespace Bench {
+
+void runNl80211Benchmarks(Benchmark& benchmark);
+
+}
+}
+#endif
+
+/**********************************************************************/
+/*                                                                    */
+/* Allocations                                                        */
+/*                                                                    */
+/**********************************************************************/
+
+static unsigned long long allocationCount = 0;
+static unsigned long long allocationBytes = 0;
+
+#ifdef __GLIBC__
+
+// operator new and the libraries in use all end up in malloc(),
+// which glibc lets the executable replace.
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+
+void*
+malloc(size_t size)
+{
+    ++allocationCount;
+    allocationBytes += size;
+    return __libc_malloc(size);
+}
+
+void*
+calloc(size_t count, size_t size)
+{
+    ++allocationCount;
+    allocationBytes += count * size;
+    return __libc_calloc(count, size);
+}
+
+void*
+realloc(void* p, size_t size)
+{
+    ++allocationCount;
+    allocationBytes += size;
+    return __libc_realloc(p, size);
+}
+
+}
+
+/*static*/ bool
+Allocations::isCounted()
+{
+    return true;
+}
+
+#else
+
+/*static*/ bool
+Allocations::isCounted()
+{
+    return false;
+}
+
+#endif
+
+/*static*/ Allocations
+Allocations::get()
+{
+    Allocations allocations;
+    allocations.count = allocationCount;
+    allocations.bytes = allocationBytes;
+    return allocations;
+}
+
+const double Benchmark::CALIBRATION_SECONDS = .01;
+
+/**********************************************************************/
+/*                                                                    */
+/* Inputs                                                             */
+/*                                                                    */
+/**********************************************************************/
+
+/**
+ * A scan of \c size access points with made up but plausible values:
+ * a few SSIDs shared by many access points, some to be escaped,
+ * and readings of various ages.
+ */
+static Scan
+makeScan(size_t size)
+{
+    static const char* SSIDS[] = {
+        "xfinitywifi",
+        "eduroam",
+        "Guest & Visitors",
+        "HOME-4F2A",
+        "<hidden>",
+        "Caf\xc3\xa9 Wi-Fi",
+        ""
+    };
+
+    Scan scan;
+    scan.aps.reserve(size);
+
+    srand(42);
+    for (size_t i = 0; i < size; ++i)
+    {
+        MAC::raw_type mac;
+        for (size_t b = 0; b < sizeof(mac); ++b)
+            mac[b] = static_cast<unsigned char>(rand());
+        mac[0] &= ~0x02;  // globally unique
+
+        const char* ssid = SSIDS[rand() % (sizeof(SSIDS) / sizeof(SSIDS[0]))];
+
+        Timer timestamp;
+        timestamp.reset(rand() % 5000);
+
+        scan.aps.push_back(
+            ScannedAccessPoint(MAC(mac),
+                               static_cast<short>(-30 - rand() % 65),
+                               timestamp,
+                               ScannedAccessPoint::SSID(ssid, ssid + strlen(ssid))));
+    }
+
+    return scan;
+}
+
+/**
+ * A response locating a scan of \c nap access points.
+ */
+static const char LOCATION_RS[] =
+    "<?xml version='1.0'?>"
+    "<LocationRS version='2.26' xmlns='http://skyhookwireless.com/wps/2005'>"
+    "<location nap='42' ncell='1' nsat='0' nlac='0' age='0' rqtime='0'>"
+    "<latitude>42.351599</latitude>"
+    "<longitude>-71.048601</longitude>"
+    "<hpe>25</hpe>"
+    "</location>"
+    "</LocationRS>";
+
+/**
+ * One second of output of a receiver with a fix.
+ */
+static const char NMEA_EPOCH[] =
+    "$GPGGA,172724.00,4221.0960,N,07102.9160,W,1,09,0.9,12.4,M,-33.7,M,,*66\r\n"
+    "$GPGSA,A,3,02,05,07,09,13,16,20,23,30,,,,1.6,0.9,1.3*32\r\n"
+    "$GPGSV,3,1,11,02,33,310,41,05,71,073,45,07,22,162,38,09,11,043,33*7F\r\n"
+    "$GPGSV,3,2,11,13,48,221,44,16,09,115,30,20,35,279,40,23,12,325,35*73\r\n"
+    "$GPGSV,3,3,11,26,04,038,,29,06,185,,30,57,118,46*48\r\n"
+    "$GPRMC,172724.00,A,4221.0960,N,07102.9160,W,0.42,273.1,160908,,,A*7E\r\n"
+    "$GPGLL,4221.0960,N,07102.9160,W,172724.00,A*13\r\n";
+
+/**
+ * Builds SiRF binary messages.
+ */
+class SirfWriter
+{
+public:
+
+    SirfWriter& put8(unsigned long value)
+    {
+        _payload += static_cast<char>(value & 0xff);
+        return *this;
+    }
+
+    SirfWriter& put16(unsigned long value)
+    {
+        return put8(value >> 8).put8(value);
+    }
+
+    SirfWriter& put32(unsigned long value)
+    {
+        return put16(value >> 16).put16(value);
+    }
+
+    SirfWriter& zeros(size_t size)
+    {
+        _payload.append(size, '\0');
+        return *this;
+    }
+
+    /**
+     * Frame the payload written so far and append it to \c stream.
+     */
+    void frame(std::string& stream)
+    {
+        unsigned long checksum = 0;
+        for (size_t i = 0; i < _payload.size(); ++i)
+            checksum += static_cast<unsigned char>(_payload[i]);
+
+        SirfWriter message;
+        message.put16(0xA0A2)
+               .put16(_payload.size());
+        message._payload += _payload;
+        message.put16(checksum & 0x7FFF)
+               .put16(0xB0B3);
+
+        stream += message._payload;
+        _payload.clear();
+    }
+
+private:
+
+    std::string _payload;
+};
+
+/**
+ * One second of output of a receiver with a fix: Measured Navigation
+ * Data (2, ignored), Measured Tracker Data (4) and Geodetic Navigation
+ * Data (41).
+ */
+static std::string
+makeSirfEpoch()
+{
+    std::string stream;
+    SirfWriter message;
+
+    message.put8(2).zeros(40);
+    message.frame(stream);
+
+    static const unsigned char SATELLITES[] = { 2, 5, 7, 9, 13, 16, 20, 23, 26, 29, 30, 31 };
+
+    message.put8(4)
+           .put16(1495)            // week
+           .put32(23244400)        // time of week, 1/100 s
+           .put8(sizeof(SATELLITES));
+    for (size_t i = 0; i < sizeof(SATELLITES); ++i)
+    {
+        message.put8(SATELLITES[i])
+               .put8(40 + 13 * i)  // azimuth, 2/3 degree
+               .put8(20 + 9 * i)   // elevation, 1/2 degree
+               .put16(0xBF);       // state
+        for (int j = 0; j < 10; ++j)
+            message.put8(30 + i);  // C/N0
+    }
+    message.frame(stream);
+
+    message.put8(41)
+           .put16(0)               // navigation valid
+           .put16(0x0004)          // 3-SV KF solution
+           .put16(1495)            // week
+           .put32(232444000)       // time of week, ms
+           .put16(2008).put8(9).put8(16).put8(17).put8(27).put16(24000)
+           .put32(0x6000D2D2)      // satellites used
+           .put32(423516000)       // latitude, 1e-7 degree
+           .put32(static_cast<unsigned long>(-710486000L))
+           .put32(1240)            // height, cm
+           .put32(4610)            // altitude, cm
+           .put8(21)               // map datum
+           .put16(42)              // speed, cm/s
+           .put16(27310)           // bearing, 1/100 degree
+           .put16(0).put16(0).put16(0)
+           .put32(1200)            // horizontal position error, cm
+           .put32(1800)            // vertical position error, cm
+           .put32(0).put16(0)
+           .put32(0).put32(0).put32(0).put32(0).put32(0)
+           .put16(0).put16(0)
+           .put8(9)                // satellites in fix
+           .put8(5)                // HDOP, 1/5
+           .put8(0);
+    message.frame(stream);
+
+    return stream;
+}
+
+/**********************************************************************/
+/*                                                                    */
+/* Operations                                                         */
+/*                                                                    */
+/**********************************************************************/
+
+/*
+ * Inputs are checked once when an operation is set up rather than
+ * asserted while it runs, so that release builds measure what
+ * they are expected to.
+ */
+
+static void
+expect(bool condition, const char* what)
+{
+    if (! condition)
+    {
+        fprintf(stderr, "shlc-bench: %s\n", what);
+        exit(1);
+    }
+}
+
+class LocationRQ
+{
+public:
+
+    explicit LocationRQ(size_t size)
+        : _scan(makeScan(size))
+    {
+        Protocol::authentication("0123456789abcdef", "benchmark", _authentication);
+    }
+
+    void operator()()
+    {
+        Protocol::locationRQ(_authentication, _scan, _rq);
+    }
+
+private:
+
+    const Scan _scan;
+    std::string _authentication;
+    std::string _rq;
+};
+
+/**
+ * Copies of scans are kept by the cache and the aggregator.
+ */
+class CopyScan
+{
+public:
+
+    explicit CopyScan(size_t size)
+        : _scan(makeScan(size))
+        , _size(0)
+    {}
+
+    void operator()()
+    {
+        const std::vector<ScannedAccessPoint> copy(_scan.aps);
+        _size += copy.size();
+    }
+
+private:
+
+    const Scan _scan;
+    size_t _size;
+};
+
+class ParseXml
+{
+public:
+
+    explicit ParseXml(const char* xml)
+        : _xml(xml)
+        , _size(strlen(xml))
+        , _parser(XmlParser::newInstance())
+    {
+        std::auto_ptr<DOMDocument> doc(_parser->parse(_xml, _size));
+        expect(doc.get() != NULL, "invalid XML");
+    }
+
+    void operator()()
+    {
+        std::auto_ptr<DOMDocument> doc(_parser->parse(_xml, _size));
+    }
+
+private:
+
+    const char* const _xml;
+    const size_t _size;
+    std::auto_ptr<XmlParser> _parser;
+};
+
+class ParseLocationRS
+{
+public:
+
+    ParseLocationRS()
+        : _doc(std::auto_ptr<XmlParser>(XmlParser::newInstance())
+                   ->parse(LOCATION_RS, sizeof(LOCATION_RS) - 1))
+    {
+        expect(_doc.get() != NULL, "invalid LocationRS");
+
+        (*this)();
+        expect(_locations.size() == 1, "LocationRS not parsed");
+    }
+
+    void operator()()
+    {
+        _locations.clear();
+        Protocol::parseLocationRS(_doc.get(), 0, _locations);
+    }
+
+private:
+
+    std::auto_ptr<DOMDocument> _doc;
+    std::vector<LiteLocation> _locations;
+};
+
+/**
+ * Reads the response through the \c DOMNode interface, whose strings
+ * are converted to the charset of the locale.
+ */
+class ReadDOMNodes
+{
+public:
+
+    ReadDOMNodes()
+        : _doc(std::auto_ptr<XmlParser>(XmlParser::newInstance())
+                   ->parse(LOCATION_RS, sizeof(LOCATION_RS) - 1))
+    {
+        expect(_doc.get() != NULL, "invalid LocationRS");
+    }
+
+    void operator()()
+    {
+        std::auto_ptr<DOMNode> root(_doc->getDocumentElement());
+        std::auto_ptr<DOMNodeList> nodes(root->getChildNodes());
+        for (unsigned long i = 0; i < nodes->getLength(); ++i)
+        {
+            std::auto_ptr<DOMNode> node(nodes->getItem(i));
+            node->getNamespaceURI();
+            node->getLocalName();
+            node->getAttributeNS("", "nap");
+            node->getAttributeNS("", "age");
+        }
+    }
+
+private:
+
+    std::auto_ptr<DOMDocument> _doc;
+};
+
+/**
+ * Feeds the response to a decoder in parts of \c chunk bytes,
+ * as a download would.
+ */
+class DecodeLocationRS
+{
+public:
+
+    explicit DecodeLocationRS(size_t chunk)
+        : _chunk(chunk)
+    {
+        (*this)();
+        expect(_locations.size() == 1, "LocationRS not decoded");
+    }
+
+    void operator()()
+    {
+        _locations.clear();
+
+        _decoder.begin();
+        for (size_t i = 0; i < sizeof(LOCATION_RS) - 1; i += _chunk)
+        {
+            _decoder.data(LOCATION_RS + i,
+                          std::min(_chunk, sizeof(LOCATION_RS) - 1 - i));
+        }
+        _decoder.getLocations(_locations);
+    }
+
+private:
+
+    const size_t _chunk;
+    LocationRSDecoder _decoder;
+    std::vector<LiteLocation> _locations;
+};
+
+class ParseNmea
+{
+public:
+
+    ParseNmea()
+    {
+        unsigned int sentences = NMEA::ALL;
+        NMEA::parse(NMEA_EPOCH, _info, sentences);
+        expect(sentences == (NMEA::GGA | NMEA::GSA | NMEA::GSV | NMEA::RMC | NMEA::GLL),
+               "NMEA sentences not parsed");
+    }
+
+    void operator()()
+    {
+        NMEA::parse(NMEA_EPOCH, _info);
+    }
+
+private:
+
+    NMEA::Info _info;
+};
+
+class ParseSirf
+{
+public:
+
+    ParseSirf()
+        : _stream(makeSirfEpoch())
+    {
+        const size_t parsed = _protocol.tryParse(_stream.data(), _stream.size());
+        expect(parsed == _stream.size()
+                   && _protocol.data().fix.get() != NULL
+                   && _protocol.data().satellites.size() == 12,
+               "SiRF messages not parsed");
+    }
+
+    void operator()()
+    {
+        _protocol.tryParse(_stream.data(), _stream.size());
+    }
+
+private:
+
+    const std::string _stream;
+    SirfProtocol _protocol;
+};
+
+class Utf8Test
+{
+public:
+
+    explicit Utf8Test(const char* ssid)
+        : _ssid(ssid, ssid + strlen(ssid))
+        , _valid(false)
+    {
+        expect(xmlUtf8Test(_ssid), "invalid UTF-8");
+    }
+
+    void operator()()
+    {
+        _valid = xmlUtf8Test(_ssid);
+    }
+
+private:
+
+    const std::vector<unsigned char> _ssid;
+    bool _valid;
+};
+
+class Escape
+{
+public:
+
+    explicit Escape(const char* s)
+        : _s(s)
+    {}
+
+    void operator()()
+    {
+        _escaped = xmlEscape(_s);
+    }
+
+private:
+
+    const std::string _s;
+    std::string _escaped;
+};
+
+/**
+ * SSIDs as seen in a city scan: mostly ASCII of every length up to the
+ * 32 allowed, a few to be escaped and a few in UTF-8.
+ */
+static const char* const SSID_CORPUS[] = {
+    "xfinitywifi",
+    "eduroam",
+    "NETGEAR-5G",
+    "ATT8jN2x4Q",
+    "DIRECT-3F-HP OfficeJet Pro 8710",
+    "Linksys01234",
+    "HOME-4F2A-5",
+    "Starbucks WiFi",
+    "TP-Link_9C2E",
+    "CableWiFi",
+    "MySpectrumWiFi58-2G",
+    "Verizon_7KQ9XD",
+    "Google Starbucks",
+    "NYC Free Public WiFi",
+    "BostonPublicLibrary-Guest-5GHz",
+    "Guest & Visitors",
+    "Bob's iPhone",
+    "<hidden>",
+    "Caf\xc3\xa9 Wi-Fi",
+    "\xd0\x94\xd0\xbe\xd0\xbc\xd0\xb0\xd1\x88\xd0\xbd\xd0\xb8\xd0\xb9",
+    "\xe3\x83\x95\xe3\x83\xaa\xe3\x83\xbcWi-Fi",
+    "\xf0\x9f\x93\xb6 Pretty Fly for a WiFi"
+};
+
+static const size_t SSID_CORPUS_SIZE =
+    sizeof(SSID_CORPUS) / sizeof(SSID_CORPUS[0]);
+
+class Utf8TestCorpus
+{
+public:
+
+    Utf8TestCorpus()
+        : _valid(0)
+    {
+        for (size_t i = 0; i < SSID_CORPUS_SIZE; ++i)
+        {
+            const char* ssid = SSID_CORPUS[i];
+            _ssids.push_back(std::vector<unsigned char>(ssid, ssid + strlen(ssid)));
+            expect(xmlUtf8Test(_ssids.back()), "invalid UTF-8");
+        }
+    }
+
+    void operator()()
+    {
+        for (size_t i = 0; i < _ssids.size(); ++i)
+            _valid += xmlUtf8Test(_ssids[i]);
+    }
+
+private:
+
+    std::vector<std::vector<unsigned char> > _ssids;
+    size_t _valid;
+};
+
+class EscapeCorpus
+{
+public:
+
+    EscapeCorpus()
+        : _ssids(SSID_CORPUS, SSID_CORPUS + SSID_CORPUS_SIZE)
+        , _size(0)
+    {}
+
+    void operator()()
+    {
+        for (size_t i = 0; i < _ssids.size(); ++i)
+            _size += xmlEscape(_ssids[i]).size();
+    }
+
+private:
+
+    const std::vector<std::string> _ssids;
+    size_t _size;
+};
+
+class MacToString
+{
+public:
+
+    MacToString()
+    {
+        // 00:09:5B:C9:17:F0
+        static const MAC::raw_type RAW = { 0xF0, 0x17, 0xC9, 0x5B, 0x09, 0x00 };
+        _mac = RAW;
+    }
+
+    void operator()()
+    {
+        _s = _mac.toString();
+    }
+
+private:
+
+    MAC _mac;
+    std::string _s;
+};
+
+/**********************************************************************/
+/*                                                                    */
+/* main                                                               */
+/*                                                                    */
+/**********************************************************************/
+
+static void
+usage(const char* program)
+{
+    fprintf(stderr, "usage: %s [-t seconds per benchmark] [name filter]\n", program);
+}
+
+int
+main(int argc, char* argv[])
+{
+    double seconds = 1.;
+    const char* filter = NULL;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else if (argv[i][0] != '-' && filter == NULL)
+            filter = argv[i];
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Benchmark benchmark(seconds, filter);
+
+    LocationRQ locationRQ10(10);
+    LocationRQ locationRQ100(100);
+    LocationRQ locationRQ500(500);
+    benchmark.run("Protocol::locationRQ/10", locationRQ10);
+    benchmark.run("Protocol::locationRQ/100", locationRQ100);
+    benchmark.run("Protocol::locationRQ/500", locationRQ500);
+
+    CopyScan copyScan100(100);
+    benchmark.run("ScannedAccessPoint copy/100", copyScan100);
+
+    ParseXml parseXml(LOCATION_RS);
+    ParseLocationRS parseLocationRS;
+    benchmark.run("XmlParser::parse/LocationRS", parseXml);
+    benchmark.run("Protocol::parseLocationRS", parseLocationRS);
+
+    ReadDOMNodes readDOMNodes;
+    benchmark.run("DOMNode/LocationRS", readDOMNodes);
+
+    DecodeLocationRS decodeLocationRS(sizeof(LOCATION_RS));
+    DecodeLocationRS decodeLocationRS16(16);
+    benchmark.run("LocationRSDecoder", decodeLocationRS);
+    benchmark.run("LocationRSDecoder/16B chunks", decodeLocationRS16);
+
+    ParseNmea parseNmea;
+    ParseSirf parseSirf;
+    benchmark.run("NMEA::parse/epoch", parseNmea);
+    benchmark.run("SirfProtocol::tryParse/epoch", parseSirf);
+
+    Utf8Test utf8TestAscii("xfinitywifi-5G-0123456789abcdef");
+    Utf8Test utf8TestUtf8("Caf\xc3\xa9 \xe6\x97\xa0\xe7\xba\xbf \xf0\x9f\x93\xb6");
+    benchmark.run("xmlUtf8Test/ascii", utf8TestAscii);
+    benchmark.run("xmlUtf8Test/utf8", utf8TestUtf8);
+
+    Escape escapePlain("xfinitywifi-5G-0123456789abcdef");
+    Escape escapeEscaped("Guest & Visitors <5G>");
+    benchmark.run("xmlEscape/plain", escapePlain);
+    benchmark.run("xmlEscape/escaped", escapeEscaped);
+
+    Utf8TestCorpus utf8TestCorpus;
+    EscapeCorpus escapeCorpus;
+    benchmark.run("xmlUtf8Test/SSID corpus", utf8TestCorpus);
+    benchmark.run("xmlEscape/SSID corpus", escapeCorpus);
+
+    MacToString macToString;
+    benchmark.run("MAC::toString", macToString);
+
+#ifdef SHLC_BENCH_NL80211
+    runNl80211Benchmarks(benchmark);
+#endif
+
+    return 0;
+}
@@ -161,6 +161,382 @@ typedef struct
     unsigned long age;
 } SHLC_Location;
 
+/**
+ * A Wi-Fi access point observed by the caller.
+ *
+ * \see SHLC_Scan
+ */
+typedef struct
+{
+    /**
+     * The MAC address in transmission order,
+     * e.g. <code>{0x00, 0x11, 0x22, 0x33, 0x44, 0x55}</code>
+     * for <code>00:11:22:33:44:55</code>.
+     */
+    unsigned char mac[6];
+
+    /**
+     * The received signal strength in dBm.
+     */
+    short rssi;
+
+    /**
+     * Number of milliseconds elapsed since the access point was observed.
+     */
+    unsigned long age;
+
+    /**
+     * The raw SSID of the access point, or \c NULL if unknown.
+     */
+    const unsigned char* ssid;
+
+    /**
+     * The number of bytes in \c ssid.
+     */
+    unsigned char ssid_length;
+} SHLC_AccessPoint;
+
+/**
+ * Cell tower radio type.
+ */
+typedef enum
+{
+    SHLC_CELL_TYPE_GSM = 1,
+    SHLC_CELL_TYPE_UMTS = 2,
+    SHLC_CELL_TYPE_LTE = 3
+} SHLC_CellType;
+
+/**
+ * A cell tower observed by the caller.
+ *
+ * \see SHLC_Scan
+ */
+typedef struct
+{
+    SHLC_CellType type;
+
+    /**
+     * Mobile country code.
+     */
+    unsigned short mcc;
+
+    /**
+     * Mobile network code.
+     */
+    unsigned short mnc;
+
+    /**
+     * Cell identifier.
+     */
+    int ci;
+
+    /**
+     * Location area code for GSM and UMTS,
+     * tracking area code for LTE.
+     */
+    int lac;
+
+    /**
+     * The received signal strength in dBm.
+     */
+    short rssi;
+
+    /**
+     * Timing advance, or \c 0 if unknown.
+     */
+    int timing_advance;
+
+    /**
+     * Number of milliseconds elapsed since the cell tower was observed.
+     */
+    unsigned long age;
+} SHLC_CellTower;
+
+/**
+ * A GPS fix acquired by the caller.
+ *
+ * \see SHLC_Scan
+ */
+typedef struct
+{
+    //@{
+    /**
+     * Coordinates in decimal degrees.
+     */
+    double latitude;
+    double longitude;
+    //@}
+
+    /**
+     * Horizontal positioning error in meters, or \c 0 if unknown.
+     */
+    double hpe;
+
+    /**
+     * Non-zero if \c altitude is known.
+     */
+    int has_altitude;
+
+    /**
+     * Altitude above mean sea level in meters.
+     */
+    double altitude;
+
+    /**
+     * Speed in km/hr, negative if unknown.
+     */
+    double speed;
+
+    /**
+     * Bearing in degrees from north clockwise, negative if unknown.
+     */
+    double bearing;
+
+    /**
+     * The number of satellites used in the fix.
+     */
+    unsigned char nsat;
+
+    /**
+     * Number of milliseconds elapsed since the fix was acquired.
+     */
+    unsigned long age;
+} SHLC_GPSFix;
+
+/**
+ * Radio observations collected by the caller,
+ * e.g. on another device.
+ *
+ * \see SHLC_location_from_scan()
+ */
+typedef struct
+{
+    const SHLC_AccessPoint* aps;
+    unsigned int naps;
+
+    const SHLC_CellTower* cells;
+    unsigned int ncells;
+
+    const SHLC_GPSFix* gps;
+    unsigned int ngps;
+
+    /**
+     * Identifies the device the scan was collected on.
+     * \n
+     * If \c NULL, the identity of this device is used,
+     * which requires its Wi-Fi or cell adapter.
+     */
+    const char* username;
+} SHLC_Scan;
+
+/**
+ * Tunable behavior of a handle.
+ *
+ * \see SHLC_set_option()
+ */
+typedef enum
+{
+    /**
+     * Number of milliseconds during which the location determined for a scan
+     * is returned again for an equivalent scan (same access points at about
+     * the same strength, same cell towers) instead of querying the server.
+     * \n
+     * Scans that include GPS fixes are never served from the cache.
+     * \n
+     * Defaults to \c 0, which disables the cache.
+     */
+    SHLC_OPTION_CACHE_TTL = 1,
+
+    /**
+     * Minimum similarity, in percent, between the access points of a scan
+     * and those of a recently located scan for that location to be
+     * returned again instead of querying the server.
+     * \n
+     * Similarity is the number of access points seen in both scans
+     * over the number of access points seen in either.
+     * Scans with fewer than 3 access points or with GPS fixes
+     * are always sent to the server.
+     * \n
+     * Defaults to \c 0, which disables matching.
+     */
+    SHLC_OPTION_FINGERPRINT_THRESHOLD = 2,
+
+    /**
+     * Number of milliseconds during which a located scan
+     * can be matched by \c SHLC_OPTION_FINGERPRINT_THRESHOLD.
+     * \n
+     * Defaults to 10 minutes.
+     */
+    SHLC_OPTION_FINGERPRINT_TTL = 3,
+
+    /**
+     * Percentile, from \c 1 to \c 100, of the recent server response
+     * times after which a request that hasn't been answered yet is sent
+     * again on another connection, the first answer being used.
+     * \n
+     * For instance, with \c 95 about one request in twenty is duplicated.
+     * Requests are only duplicated once enough response times
+     * have been observed.
+     * \n
+     * Defaults to \c 0, which disables duplicate requests.
+     */
+    SHLC_OPTION_HEDGE_PERCENTILE = 4,
+
+    /**
+     * Number of milliseconds during which access points seen by a scan,
+     * including one requested by another application such as a network
+     * manager, are reported instead of starting a new scan.
+     * \n
+     * Saves the few seconds an active scan takes when the system
+     * scans regularly anyway. Not supported by all Wi-Fi adapters.
+     * \n
+     * Defaults to \c 0, which starts a new scan for every request.
+     */
+    SHLC_OPTION_MAX_SCAN_AGE = 5,
+
+    /**
+     * Maximum number of access points sent to the server.
+     * \n
+     * When set, duplicate readings and locally administered MACs
+     * (mobile hotspots and the like) are dropped, and the strongest
+     * access points are sent, spread over as many manufacturers
+     * as possible.
+     * \n
+     * Defaults to \c 0, which sends every access point scanned.
+     */
+    SHLC_OPTION_MAX_ACCESS_POINTS = 6,
+
+    /**
+     * Number of consecutive scans whose access points and cell towers
+     * are sent together by \c SHLC_location() and related functions,
+     * each with the time it was last seen.
+     * \n
+     * A single scan, especially on the move, misses some of the
+     * access points in range.
+     * \n
+     * Defaults to \c 0, which only sends the latest scan.
+     */
+    SHLC_OPTION_AGGREGATE_SCANS = 7,
+
+    /**
+     * Number of milliseconds beyond which an access point or a cell tower
+     * is no longer sent with \c SHLC_OPTION_AGGREGATE_SCANS.
+     * \n
+     * Defaults to 30 seconds.
+     */
+    SHLC_OPTION_AGGREGATE_MAX_AGE = 8,
+
+    /**
+     * Compression of the requests sent to the server,
+     * one of \c SHLC_Encoding.
+     * \n
+     * Compressed responses are accepted regardless.
+     * \n
+     * Defaults to \c SHLC_ENCODING_IDENTITY.
+     */
+    SHLC_OPTION_REQUEST_ENCODING = 9,
+
+    /**
+     * Encoding of the requests to and responses from the server,
+     * one of \c SHLC_Codec.
+     * \n
+     * Defaults to \c SHLC_CODEC_XML.
+     */
+    SHLC_OPTION_CODEC = 10
+} SHLC_Option;
+
+/**
+ * Request compression.
+ *
+ * \see SHLC_OPTION_REQUEST_ENCODING
+ */
+typedef enum
+{
+    /**
+     * Uncompressed.
+     */
+    SHLC_ENCODING_IDENTITY = 0,
+
+    SHLC_ENCODING_GZIP = 1,
+
+    SHLC_ENCODING_DEFLATE = 2,
+
+    /**
+     * Zstandard, with the dictionary passed to
+     * \c SHLC_set_compression_dictionary() if any.
+     * \n
+     * Only available if the library was built with zstd.
+     */
+    SHLC_ENCODING_ZSTD = 3
+} SHLC_Encoding;
+
+/**
+ * Encoding of requests and responses.
+ *
+ * \see SHLC_OPTION_CODEC
+ */
+typedef enum
+{
+    /**
+     * The XML protocol of Skyhook's servers.
+     */
+    SHLC_CODEC_XML = 0,
+
+    /**
+     * A compact binary encoding, for a proxy or server of one's own
+     * (\c samples/skyhookstandin.cpp answers it).
+     */
+    SHLC_CODEC_BINARY = 1
+} SHLC_Codec;
+
+/**
+ * Counters describing the activity of a handle.
+ *
+ * \see SHLC_get_statistics()
+ */
+typedef struct
+{
+    /**
+     * The number of requests answered from the cache.
+     */
+    unsigned long cache_hits;
+
+    /**
+     * The number of cacheable requests sent to the server.
+     */
+    unsigned long cache_misses;
+
+    /**
+     * The number of requests answered from a similar scan.
+     */
+    unsigned long fingerprint_hits;
+
+    /**
+     * The number of requests sent again because
+     * of \c SHLC_OPTION_HEDGE_PERCENTILE.
+     */
+    unsigned long hedged_requests;
+
+    /**
+     * The number of those answered before the original request.
+     */
+    unsigned long hedge_wins;
+} SHLC_Statistics;
+
+/**
+ * Receives the result of \c SHLC_location_async().
+ *
+ * \param rc a \c SHLC_ReturnCode
+ * \param location the determined location if \c rc is \c SHLC_OK,
+ *                 \c NULL otherwise.
+ *                 \n
+ *                 This pointer must be freed by calling \c SHLC_free_location().
+ * \param user_data value passed to \c SHLC_location_async().
+ */
+typedef void (*SHLC_LocationCallback)(SHLC_ReturnCode rc,
+                                      SHLC_Location* location,
+                                      void* user_data);
+
 /**
  * Return a string containing the version information
  * as <code>&lt;major&gt;.&lt;minor&gt;.&lt;revision&gt;.&lt;build&gt;</code>
@@ -175,6 +551,10 @@ SHLC_version();
  * \n
  * Must be called once before making any other calls,
  * e.g. on application startup.
+ * \n
+ * The handle owns the Wi-Fi, cell and GPS adapters, which are opened here
+ * and stay open until \c SHLC_deinit() so that consecutive location
+ * requests don't have to set them up again.
  *
  * \return an opaque handle to be passed to SHLC API calls
  *         or \c NULL if an error occurred.
@@ -187,6 +567,13 @@ SHLC_init();
  * \n
  * Must be called once to free resources held by the library
  * when it is no longer in use, e.g. on application shutdown.
+ * \n
+ * Closes the adapters opened by \c SHLC_init().
+ * \n
+ * Stops tracking, if started.
+ * \n
+ * Waits for the asynchronous requests that are being processed to complete.
+ * Requests that haven't started yet complete with \c SHLC_ERROR.
  *
  * \param handle handle value returned by \c SHLC_init().
  */
@@ -210,6 +597,251 @@ SHLC_location(const void* handle,
               const char* key,
               SHLC_Location** location);
 
+/**
+ * Request geographic location within a given time.
+ * \n
+ * Like \c SHLC_location(), except that the Wi-Fi scan is given only
+ * part of \c deadline. If it doesn't complete by then, the access points
+ * of the previous scan are sent instead, along with the cell towers and
+ * GPS fixes observed so far. The server request gets the time left.
+ *
+ * \param handle handle value returned by \c SHLC_init().
+ * \param key user's API key.
+ * \param deadline number of milliseconds within which to return.
+ * \param location pointer to return a \c SHLC_Location object.
+ *                 \n
+ *                 This pointer must be freed by calling \c SHLC_free_location().
+ *
+ * \return a \c SHLC_ReturnCode,
+ *         \c SHLC_ERROR_TIMEOUT if the server didn't answer in time.
+ */
+SHLC_EXPORT SHLC_ReturnCode
+SHLC_location_with_deadline(const void* handle,
+                            const char* key,
+                            unsigned long deadline,
+                            SHLC_Location** location);
+
+/**
+ * Request geographic location based on observations
+ * supplied by the caller.
+ * \n
+ * The radio adapters of this device aren't used.
+ *
+ * \param handle handle value returned by \c SHLC_init().
+ * \param key user's API key.
+ * \param scan the observations to locate.
+ * \param location pointer to return a \c SHLC_Location object.
+ *                 \n
+ *                 This pointer must be freed by calling \c SHLC_free_location().
+ *
+ * \return a \c SHLC_ReturnCode
+ */
+SHLC_EXPORT SHLC_ReturnCode
+SHLC_location_from_scan(const void* handle,
+                        const char* key,
+                        const SHLC_Scan* scan,
+                        SHLC_Location** location);
+
+/**
+ * Request geographic location for many scans supplied by the caller.
+ * \n
+ * Each scan is processed as by \c SHLC_location_from_scan();
+ * several requests are processed in parallel on threads owned by
+ * the library, the calling thread included.
+ *
+ * \param handle handle value returned by \c SHLC_init().
+ * \param key user's API key.
+ * \param scans the scans to locate.
+ * \param count the number of elements in \c scans, \c rcs and \c locations.
+ * \param rcs array to return the \c SHLC_ReturnCode of each scan.
+ * \param locations array to return a \c SHLC_Location object for each scan
+ *                  whose return code is \c SHLC_OK, \c NULL for the others.
+ *                  \n
+ *                  These pointers must be freed by calling \c SHLC_free_location().
+ *
+ * \return \c SHLC_OK once all scans were processed,
+ *         another \c SHLC_ReturnCode if the arguments are invalid.
+ */
+SHLC_EXPORT SHLC_ReturnCode
+SHLC_location_batch(const void* handle,
+                    const char* key,
+                    const SHLC_Scan* scans,
+                    unsigned int count,
+                    SHLC_ReturnCode* rcs,
+                    SHLC_Location** locations);
+
+/**
+ * Request geographic location without blocking the caller.
+ * \n
+ * The request is processed as by \c SHLC_location() on a thread owned by
+ * the library, which then calls \c callback exactly once.
+ *
+ * \param handle handle value returned by \c SHLC_init().
+ * \param key user's API key.
+ * \param callback function to receive the result.
+ *                 \n
+ *                 Called on a library thread, or from \c SHLC_deinit()
+ *                 if the request is cancelled.
+ *                 It must not call \c SHLC_deinit().
+ * \param user_data value passed as is to \c callback.
+ *
+ * \return \c SHLC_OK if the request was queued, in which case
+ *         \c callback will be called, another \c SHLC_ReturnCode otherwise.
+ */
+SHLC_EXPORT SHLC_ReturnCode
+SHLC_location_async(const void* handle,
+                    const char* key,
+                    SHLC_LocationCallback callback,
+                    void* user_data);
+
+/**
+ * Request geographic location without blocking the caller.
+ * \n
+ * The request is processed as by \c SHLC_location() on a thread owned by
+ * the library, and its result is picked up with \c SHLC_next_completion().
+ *
+ * \param handle handle value returned by \c SHLC_init().
+ * \param key user's API key.
+ * \param user_data value returned as is by \c SHLC_next_completion().
+ *
+ * \return \c SHLC_OK if the request was queued, in which case
+ *         it will complete, another \c SHLC_ReturnCode otherwise.
+ */
+SHLC_EXPORT SHLC_ReturnCode
+SHLC_location_queued(const void* handle,
+                     const char* key,
+                     void* user_data);
+
+/**
+ * Wait for a request made with \c SHLC_location_queued() to complete.
+ * \n
+ * Requests complete in no particular order.
+ *
+ * \param handle handle value returned by \c SHLC_init().
+ * \param timeout maximum number of milliseconds to wait.
+ * \param user_data pointer to return the value passed
+ *                  to \c SHLC_location_queued().
+ * \param rc pointer to return the \c SHLC_ReturnCode of the request.
+ * \param location pointer to return a \c SHLC_Location object
+ *                 if \c rc is \c SHLC_OK, \c NULL otherwise.
+ *                 \n
+ *                 This pointer must be freed by calling \c SHLC_free_location().
+ *
+ * \return \c SHLC_OK if a request completed,
+ *         \c SHLC_ERROR_TIMEOUT if none did within \c timeout.
+ */
+SHLC_EXPORT SHLC_ReturnCode
+SHLC_next_completion(const void* handle,
+                     unsigned long timeout,
+                     void** user_data,
+                     SHLC_ReturnCode* rc,
+                     SHLC_Location** location);
+
+/**
+ * Start tracking geographic location.
+ * \n
+ * A thread owned by the library requests location as by \c SHLC_location()
+ * every \c period milliseconds, reusing the adapters opened by
+ * \c SHLC_init(), and reports each result to \c callback.
+ * \n
+ * Only one tracking session is active per handle;
+ * starting a new one stops the previous one.
+ *
+ * \param handle handle value returned by \c SHLC_init().
+ * \param key user's API key.
+ * \param period number of milliseconds between the start of
+ *               consecutive requests, must not be 0.
+ *               \n
+ *               Requests are made back to back if one takes longer.
+ * \param callback function to receive each result.
+ *                 \n
+ *                 Called on the tracking thread.
+ *                 It must not call \c SHLC_start_tracking(),
+ *                 \c SHLC_stop_tracking() or \c SHLC_deinit().
+ * \param user_data value passed as is to \c callback.
+ *
+ * \return a \c SHLC_ReturnCode,
+ *         \c SHLC_ERROR if \c period is 0.
+ */
+SHLC_EXPORT SHLC_ReturnCode
+SHLC_start_tracking(const void* handle,
+                    const char* key,
+                    unsigned long period,
+                    SHLC_LocationCallback callback,
+                    void* user_data);
+
+/**
+ * Stop tracking geographic location.
+ * \n
+ * Once this returns, the callback passed to \c SHLC_start_tracking()
+ * is no longer called.
+ *
+ * \param handle handle value returned by \c SHLC_init().
+ */
+SHLC_EXPORT void
+SHLC_stop_tracking(const void* handle);
+
+/**
+ * Set an option.
+ *
+ * \param handle handle value returned by \c SHLC_init().
+ * \param option the option to set.
+ * \param value the new value of the option.
+ *
+ * \return \c SHLC_OK if the option was set, \c SHLC_ERROR otherwise.
+ */
+SHLC_EXPORT SHLC_ReturnCode
+SHLC_set_option(const void* handle,
+                SHLC_Option option,
+                unsigned long value);
+
+/**
+ * Retrieve the counters of a handle.
+ *
+ * \param handle handle value returned by \c SHLC_init().
+ * \param statistics pointer to the structure to fill.
+ *
+ * \return a \c SHLC_ReturnCode
+ */
+SHLC_EXPORT SHLC_ReturnCode
+SHLC_get_statistics(const void* handle,
+                    SHLC_Statistics* statistics);
+
+/**
+ * Set the url of the location server.
+ * \n
+ * Meant for testing against another server than Skyhook's.
+ *
+ * \param handle handle value returned by \c SHLC_init().
+ * \param url the url location requests are posted to.
+ *
+ * \return a \c SHLC_ReturnCode
+ */
+SHLC_EXPORT SHLC_ReturnCode
+SHLC_set_server_url(const void* handle,
+                    const char* url);
+
+/**
+ * Set the dictionary used to compress requests
+ * with \c SHLC_ENCODING_ZSTD.
+ * \n
+ * Requests are mostly the same markup around different values,
+ * a dictionary trained on typical requests (<tt>zstd --train</tt>)
+ * makes even small ones compress well. The server must have it too,
+ * it's identified by the id it was given when trained.
+ *
+ * \param handle handle value returned by \c SHLC_init().
+ * \param dictionary the dictionary, copied,
+ *                   or \c NULL to not use a dictionary.
+ * \param size the size of \c dictionary in bytes.
+ *
+ * \return a \c SHLC_ReturnCode
+ */
+SHLC_EXPORT SHLC_ReturnCode
+SHLC_set_compression_dictionary(const void* handle,
+                                const void* dictionary,
+                                unsigned long size);
+
 /**
  * Free a \c SHLC_Location object returned by \c SHLC_location().
  *
@@ -17,12 +17,14 @@
 #ifndef WPS_SPI_DOM_H_
 #define WPS_SPI_DOM_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
 namespace WPS {
 namespace SPI {
 
+class DOMDocument;
 class DOMNodeList;
 
 /**
@@ -189,6 +191,103 @@ private:
     DOMNodeList& operator=(const DOMNodeList&);
 };
 
+/**
+ * A reference to a node of a <tt>DOMDocument</tt>, to walk the document
+ * without allocating, unlike <tt>DOMNode</tt>.
+ * \n
+ * References are copied by value and remain valid as long as
+ * their document. Strings are in UTF-8, as stored by the document,
+ * rather than converted to the current locale.
+ *
+ * \code
+ *   for (DOMNodeRef node = parent.getFirstChild();
+ *        ! node.isNull();
+ *        node = node.getNextSibling())
+ *   {
+ *       if (node.isElement(namespaceURI, "location"))
+ *           ...
+ *   }
+ * \endcode
+ *
+ * @author Skyhook Wireless
+ */
+class DOMNodeRef
+{
+public:
+
+    /**
+     * A null reference.
+     */
+    DOMNodeRef()
+        : _document(NULL)
+        , _node(NULL)
+    {}
+
+    /**
+     * @return <tt>true</tt> if this refers to no node.
+     */
+    bool isNull() const
+    {
+        return _node == NULL;
+    }
+
+    /**
+     * @return the first child of this node,
+     *         a null reference if it has none.
+     */
+    inline DOMNodeRef getFirstChild() const;
+
+    /**
+     * @return the node following this one in its parent's children,
+     *         a null reference if it's the last one.
+     */
+    inline DOMNodeRef getNextSibling() const;
+
+    /**
+     * @param namespaceURI the namespace, "" for none
+     * @param localName the local name
+     *
+     * @return <tt>true</tt> if this is an <tt>ELEMENT_NODE</tt> named
+     *         \a localName in namespace \a namespaceURI.
+     */
+    inline bool isElement(const char* namespaceURI,
+                          const char* localName) const;
+
+    /**
+     * @return the text directly contained by this element,
+     *         "" if none.
+     *
+     * @see DOMNode::getNodeValue
+     */
+    inline const char* getText() const;
+
+    /**
+     * @param namespaceURI the namespace of the attribute's name, "" for none
+     * @param localName the local name of the attribute's name
+     *
+     * @return the value of the attribute of this element,
+     *         "" if it has none.
+     *
+     * @see DOMNode::getAttributeNS
+     */
+    inline const char* getAttributeNS(const char* namespaceURI,
+                                      const char* localName) const;
+
+private:
+
+    friend class DOMDocument;
+
+    DOMNodeRef(const DOMDocument* document, const void* node)
+        : _document(node != NULL ? document : NULL)
+        , _node(node)
+    {}
+
+private:
+
+    const DOMDocument* _document;
+    const void* _node;
+};
+
 /**
  * @see <a href="http://www.w3.org/TR/2000/REC-DOM-Level-2-Core-20001113/core.html#i-Document">Document Object Model (DOM) Level 2 Core Specification</a>
  *
@@ -206,6 +305,15 @@ public:
      */
     virtual DOMNode* getDocumentElement() const =0;
 
+    /**
+     * @return the root element of this document,
+     *         a null reference if it has none.
+     */
+    DOMNodeRef getDocumentElementRef() const
+    {
+        return DOMNodeRef(this, getRootNode());
+    }
+
     virtual ~DOMDocument()
     {}
 
@@ -214,6 +322,22 @@ protected:
     DOMDocument()
     {}
 
+    /**
+     * Implementation of <tt>DOMNodeRef</tt>, for the opaque \a node
+     * of this document, which is never <tt>NULL</tt>.
+     * The nodes returned are <tt>NULL</tt> if there is none.
+     */
+    virtual const void* getRootNode() const =0;
+    virtual const void* getFirstChild(const void* node) const =0;
+    virtual const void* getNextSibling(const void* node) const =0;
+    virtual bool isElement(const void* node,
+                           const char* namespaceURI,
+                           const char* localName) const =0;
+    virtual const char* getText(const void* node) const =0;
+    virtual const char* getAttributeNS(const void* node,
+                                       const char* namespaceURI,
+                                       const char* localName) const =0;
+
 private:
 
     /**
@@ -222,8 +346,52 @@ private:
      */
     DOMDocument(const DOMDocument&);
     DOMDocument& operator=(const DOMDocument&);
+
+    friend class DOMNodeRef;
 };
 
+/*
+ * DOMNodeRef, once DOMDocument is defined
+ */
+
+inline DOMNodeRef
+DOMNodeRef::getFirstChild() const
+{
+    if (_node == NULL)
+        return DOMNodeRef();
+    return DOMNodeRef(_document, _document->getFirstChild(_node));
+}
+
+inline DOMNodeRef
+DOMNodeRef::getNextSibling() const
+{
+    if (_node == NULL)
+        return DOMNodeRef();
+    return DOMNodeRef(_document, _document->getNextSibling(_node));
+}
+
+inline bool
+DOMNodeRef::isElement(const char* namespaceURI, const char* localName) const
+{
+    return _node != NULL
+        && _document->isElement(_node, namespaceURI, localName);
+}
+
+inline const char*
+DOMNodeRef::getText() const
+{
+    return _node != NULL ? _document->getText(_node) : "";
+}
+
+inline const char*
+DOMNodeRef::getAttributeNS(const char* namespaceURI,
+                           const char* localName) const
+{
+    return _node != NULL
+        ? _document->getAttributeNS(_node, namespaceURI, localName)
+        : "";
+}
+
 /** @} */
 
 }
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef WPS_SPI_INTERNED_SSID_H_
+#define WPS_SPI_INTERNED_SSID_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace WPS {
+namespace SPI {
+
+/**
+ * \ingroup nonreplaceable
+ *
+ * An SSID, along with whether it can be sent in XML and how it's
+ * escaped there, worked out once.
+ * \n
+ * The same SSIDs are reported by many access points and in every scan,
+ * so each distinct one is stored once and shared by all the instances.
+ * Once <code>MAX_INTERNED</code> of them are stored, those no instance
+ * refers to anymore are dropped to make room; if all are still in use,
+ * further SSIDs are copied with every instance.
+ *
+ * @author Skyhook Wireless
+ */
+class InternedSsid
+{
+public:
+
+    typedef std::vector<unsigned char> Bytes;
+
+    /**
+     * The number of distinct SSIDs stored at most.
+     */
+    static const std::size_t MAX_INTERNED = 1024;
+
+    /**
+     * Creates an empty SSID.
+     */
+    InternedSsid()
+        : _entry(NULL)
+        , _owned(false)
+    {}
+
+    /**
+     * Creates an SSID from its <code>bytes</code>,
+     * looking up or adding them to the process-wide table.
+     */
+    explicit InternedSsid(const Bytes& bytes);
+
+    InternedSsid(const InternedSsid& that);
+
+    InternedSsid& operator=(const InternedSsid& that);
+
+    ~InternedSsid();
+
+    bool empty() const
+    {
+        return _entry == NULL;
+    }
+
+    const Bytes& getBytes() const;
+
+    /**
+     * @return <code>true</code> if the SSID is valid UTF-8
+     *         made of characters allowed in XML.
+     */
+    bool isValidXml() const;
+
+    /**
+     * @return the SSID with XML special characters escaped,
+     *         empty if it isn't valid XML.
+     */
+    const std::string& getEscapedXml() const;
+
+    /**
+     * @return the number of distinct SSIDs currently stored.
+     */
+    static std::size_t getInternedCount();
+
+private:
+
+    struct Entry;
+    class Table;
+
+    static Table& table();
+
+    const Entry* _entry;
+    bool _owned;  // not interned, deleted with this instance
+};
+
+}
+}
+
+#endif
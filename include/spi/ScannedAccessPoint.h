@@ -22,6 +22,7 @@
 #include <string>
 #include <vector>
 
+#include "spi/InternedSsid.h"
 #include "spi/MAC.h"
 #include "spi/Time.h"
 #include "spi/Assert.h"
@@ -44,7 +45,7 @@ class ScannedAccessPoint
 {
 public:
 
-    typedef std::vector<unsigned char> SSID;
+    typedef InternedSsid::Bytes SSID;
 
     /**
      * Creates a new instance with a <code>mac</code> address,
@@ -68,6 +69,22 @@ public:
         assert(-255 <= _rssi && _rssi <= 0);
     }
 
+    /**
+     * Creates a new instance sharing an <code>ssid</code>
+     * already interned.
+     */
+    ScannedAccessPoint(const MAC& mac,
+                       short rssi,
+                       const Timer& timestamp,
+                       const InternedSsid& ssid)
+        : _mac(mac)
+        , _rssi(todBm(rssi))
+        , _timestamp(timestamp)
+        , _ssid(ssid)
+    {
+        assert(-255 <= _rssi && _rssi <= 0);
+    }
+
     ScannedAccessPoint(const ScannedAccessPoint& that)
         : _mac(that._mac)
         , _rssi(that._rssi)
@@ -119,6 +136,11 @@ public:
     }
 
     const SSID& getSsid() const
+    {
+        return _ssid.getBytes();
+    }
+
+    const InternedSsid& getInternedSsid() const
     {
         return _ssid;
     }
@@ -129,7 +151,7 @@ public:
     std::string toString() const
     {
         return _mac.toString()
-             + "," + toAsciiString(_ssid)
+             + "," + toAsciiString(_ssid.getBytes())
              + "," + itoa(_rssi)
              + "," + _timestamp.toString();
     }
@@ -214,7 +236,7 @@ private:
     short _rssi;
     Timer _timestamp;
 
-    SSID _ssid;
+    InternedSsid _ssid;
 };
 
 }
@@ -54,6 +54,67 @@ struct Thread
     static unsigned long id();
 };
 
+/**
+ * A thread of execution that can be waited for.
+ *
+ * @author Skyhook Wireless
+ */
+class JoinableThread
+{
+public:
+
+    /**
+     * The code to be executed by a \c JoinableThread.
+     */
+    class Runnable
+    {
+    public:
+
+        virtual void run() =0;
+
+        virtual ~Runnable()
+        {}
+    };
+
+    /**
+     * Start a new thread that executes <code>runnable->run()</code>.
+     *
+     * @param runnable the code to execute.
+     *                 \n
+     *                 Must remain valid until the thread has been joined.
+     *
+     * @return the new thread or <code>NULL</code> if it couldn't be started.
+     */
+    static JoinableThread* newInstance(Runnable* runnable);
+
+    /**
+     * Wait until the thread terminates.
+     *
+     * @note Must not be called from the thread itself.
+     */
+    virtual void join() =0;
+
+    /**
+     * @note Implementation should <code>join()</code> the thread
+     *       if it hasn't been joined yet.
+     */
+    virtual ~JoinableThread()
+    {}
+
+protected:
+
+    JoinableThread()
+    {}
+
+private:
+
+    /**
+     * JoinableThread instances themselves cannot be copied.
+     */
+    JoinableThread(const JoinableThread&);
+    JoinableThread& operator=(const JoinableThread&);
+};
+
 /** @} */
 
 }
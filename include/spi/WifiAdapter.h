@@ -153,6 +153,22 @@ public:
      */
     virtual void startScan() =0;
 
+    /**
+     * Allow <code>startScan()</code> to report the access points seen
+     * less than <code>maxAge</code> milliseconds ago, for instance by
+     * a scan requested by another application, instead of starting
+     * a new scan.
+     *
+     * @param maxAge the maximum age of the access points reported,
+     *               <code>0</code> to always start a new scan (the default).
+     *
+     * @note The default implementation does nothing.
+     */
+    virtual void setMaxScanAge(unsigned long maxAge)
+    {
+        (void) maxAge;
+    }
+
     /**
      * Retrieve the MAC of the associated access point.
      *
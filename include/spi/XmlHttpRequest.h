@@ -17,6 +17,7 @@
 #ifndef WPS_SPI_XML_HTTP_REQUEST_H_
 #define WPS_SPI_XML_HTTP_REQUEST_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -110,6 +111,48 @@ public:
         HTTP_VERSION_NOT_SUPPORTED          = 505
     };
 
+    /**
+     * \ingroup nonreplaceable
+     *
+     * Compression of the data passed to <code>send()</code>.
+     *
+     * @see <code>setContentEncoding()</code>
+     */
+    enum ContentEncoding
+    {
+        ENCODING_IDENTITY,
+        ENCODING_GZIP,
+        ENCODING_DEFLATE,
+        ENCODING_ZSTD
+    };
+
+    /**
+     * \ingroup nonreplaceable
+     *
+     * Receives the response body as it's downloaded.
+     *
+     * @see <code>setResponseHandler()</code>
+     */
+    class ResponseHandler
+    {
+    public:
+
+        virtual ~ResponseHandler()
+        {}
+
+        /**
+         * Called by <code>send()</code> before any data,
+         * for every request.
+         */
+        virtual void begin() =0;
+
+        /**
+         * Called by <code>send()</code> with each part of the body,
+         * in order and decompressed, as soon as it's received.
+         */
+        virtual void data(const char* data, std::size_t size) =0;
+    };
+
     /**
      * @return a new instance
      */
@@ -156,6 +199,75 @@ public:
      */
     virtual ErrorCode send(const std::string& data) =0;
 
+    /**
+     * Limit the time subsequent calls to <code>send()</code> may take.
+     *
+     * @param timeout the limit in milliseconds,
+     *                <code>0</code> for the implementation's default.
+     *
+     * @note The default implementation does nothing.
+     */
+    virtual void setTimeout(unsigned long timeout)
+    {
+        (void) timeout;
+    }
+
+    /**
+     * Cancel the <code>send()</code> in progress, or the next one
+     * if none is, which then returns an error as soon as possible.
+     *
+     * @note May be called from another thread than <code>send()</code>,
+     *       including while it is in progress.
+     * @note The instance may only be destroyed afterwards.
+     * @note The default implementation does nothing, in which case
+     *       <code>send()</code> completes normally.
+     */
+    virtual void abort()
+    {}
+
+    /**
+     * Compress the data passed to subsequent calls to <code>send()</code>,
+     * and set the <tt>Content-Encoding</tt> header accordingly.
+     * \n
+     * Compressed responses are accepted regardless.
+     *
+     * @param encoding the compression to use.
+     * @param dictionary compression dictionary, as trained by
+     *                   <tt>zstd --train</tt>, used with
+     *                   <code>ENCODING_ZSTD</code> only.
+     *                   The server must know it as well.
+     *
+     * @return <code>false</code> if <code>encoding</code> isn't supported,
+     *         in which case the data is sent as is.
+     *
+     * @note The default implementation only supports
+     *       <code>ENCODING_IDENTITY</code>.
+     */
+    virtual bool setContentEncoding(ContentEncoding encoding,
+                                    const std::string& dictionary = std::string())
+    {
+        (void) dictionary;
+        return encoding == ENCODING_IDENTITY;
+    }
+
+    /**
+     * Pass the response body of subsequent calls to <code>send()</code>
+     * to <code>handler</code> as it's received, rather than keeping it
+     * for <code>getResponseData()</code>.
+     *
+     * @param handler the handler, <code>NULL</code> to keep the body again.
+     *                It must outlive the calls to <code>send()</code>.
+     *
+     * @return <code>false</code> if streaming isn't supported,
+     *         in which case the body is kept as before.
+     *
+     * @note The default implementation doesn't support streaming.
+     */
+    virtual bool setResponseHandler(ResponseHandler* handler)
+    {
+        return handler == NULL;
+    }
+
     /**
      * @param header the name of the HTTP header to return
      *
@@ -167,7 +279,8 @@ public:
     /**
      * Retrieve the response text.
      *
-     * @return the response text string
+     * @return the response text string,
+     *         empty if a <code>ResponseHandler</code> received it.
      */
     virtual std::string getResponseData() const =0;
 
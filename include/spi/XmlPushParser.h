@@ -0,0 +1,134 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_SPI_XMLPUSHPARSER_H_
+#define WPS_SPI_XMLPUSHPARSER_H_
+
+#include <cstddef>
+
+namespace WPS {
+namespace SPI {
+
+/**
+ * \addtogroup replaceable
+ */
+/** @{ */
+
+/**
+ * \ingroup nonreplaceable
+ *
+ * An attribute of an element reported to an <code>XmlContentHandler</code>.
+ * The strings are only valid during the call.
+ */
+struct XmlAttribute
+{
+    const char* namespaceURI;   // "" if none
+    const char* localName;
+    const char* value;
+    std::size_t valueSize;
+};
+
+/**
+ * \ingroup nonreplaceable
+ *
+ * Receives the content of a document as <code>XmlPushParser</code>
+ * parses it. The strings passed are only valid during the call.
+ */
+class XmlContentHandler
+{
+public:
+
+    virtual ~XmlContentHandler()
+    {}
+
+    /**
+     * @param namespaceURI the element's namespace, "" if none
+     * @param localName the element's name without its prefix
+     * @param attributes the element's attributes, namespace declarations excluded
+     * @param size the number of <code>attributes</code>
+     */
+    virtual void startElement(const char* namespaceURI,
+                              const char* localName,
+                              const XmlAttribute* attributes,
+                              std::size_t size) =0;
+
+    virtual void endElement() =0;
+
+    /**
+     * Character data of the current element, possibly in several calls.
+     */
+    virtual void characters(const char* data, std::size_t size) =0;
+};
+
+/**
+ * Parses a document given in parts, as it's received,
+ * without building it in memory.
+ *
+ * @author Skyhook Wireless
+ */
+class XmlPushParser
+{
+public:
+
+    /**
+     * @param handler receives the content, must outlive the parser.
+     */
+    static XmlPushParser* newInstance(XmlContentHandler& handler);
+
+    virtual ~XmlPushParser()
+    {}
+
+    /**
+     * Start a new document.
+     */
+    virtual void reset() =0;
+
+    /**
+     * Parse the next part of the document.
+     *
+     * @return <code>false</code> if the document isn't well-formed,
+     *         in which case the rest is ignored until <code>reset()</code>.
+     */
+    virtual bool parse(const char* data, std::size_t size) =0;
+
+    /**
+     * Signal the end of the document.
+     *
+     * @return <code>true</code> if the whole document was well-formed.
+     */
+    virtual bool finish() =0;
+
+protected:
+
+    XmlPushParser()
+    {}
+
+private:
+
+    /**
+     * XmlPushParser instances themselves cannot be copied.
+     * Implementations may support copying.
+     */
+    XmlPushParser(const XmlPushParser&);
+    XmlPushParser& operator=(const XmlPushParser&);
+};
+
+/** @} */
+
+}
+}
+
+#endif
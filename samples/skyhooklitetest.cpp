@@ -20,6 +20,12 @@
 
 #include <skyhookliteclient.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_GETOPT_H
+#  include <getopt.h>
+#endif
 
 static void
 print_location(const SHLC_Location* location)
@@ -44,6 +50,32 @@ print_location(const SHLC_Location* location)
     }
 }
 
+static int
+set_dictionary(const void* handle, const char* path)
+{
+    char* data;
+    long size;
+    int rc = -1;
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+        return -1;
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data = (char*) malloc((size_t) size);
+    if (data != NULL && fread(data, 1, (size_t) size, f) == (size_t) size)
+    {
+        if (SHLC_set_compression_dictionary(handle, data, (unsigned long) size) == SHLC_OK)
+            rc = 0;
+    }
+
+    free(data);
+    fclose(f);
+    return rc;
+}
+
 /*********************************************************************/
 /*                                                                   */
 /* main                                                              */
@@ -61,7 +93,58 @@ main(int argc, char* argv[])
 
     SHLC_ReturnCode rc;
     SHLC_Location* location;
+    SHLC_Statistics statistics;
     const void* handle;
+    const char* url = NULL;
+    unsigned long hedge_percentile = 0;
+    unsigned long encoding = SHLC_ENCODING_IDENTITY;
+    const char* dictionary_path = NULL;
+    unsigned long codec = SHLC_CODEC_XML;
+    int count = 1;
+    int i;
+
+#ifdef HAVE_GETOPT_H
+    int c;
+    while ((c = getopt(argc, argv, "u:n:H:z:D:c:")) != -1)
+    {
+        switch (c)
+        {
+        case 'u':
+            url = optarg;
+            break;
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 'H':
+            hedge_percentile = strtoul(optarg, NULL, 10);
+            break;
+        case 'z':
+            if (strcmp(optarg, "gzip") == 0)
+                encoding = SHLC_ENCODING_GZIP;
+            else if (strcmp(optarg, "deflate") == 0)
+                encoding = SHLC_ENCODING_DEFLATE;
+            else if (strcmp(optarg, "zstd") == 0)
+                encoding = SHLC_ENCODING_ZSTD;
+            break;
+        case 'D':
+            dictionary_path = optarg;
+            break;
+        case 'c':
+            if (strcmp(optarg, "binary") == 0)
+                codec = SHLC_CODEC_BINARY;
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-u server_url] [-n count] [-H hedge_percentile]\n"
+                    "          [-z gzip|deflate|zstd] [-D zstd_dictionary] [-c xml|binary]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+#else
+    (void) argc;
+    (void) argv;
+#endif
 
     handle = SHLC_init();
     if (! handle)
@@ -70,15 +153,47 @@ main(int argc, char* argv[])
         return 1;
     }
 
-    rc = SHLC_location(handle, MY_API_KEY, &location);
-    if (rc != SHLC_OK)
+    if (url != NULL)
+        SHLC_set_server_url(handle, url);
+
+    if (hedge_percentile > 0)
+        SHLC_set_option(handle, SHLC_OPTION_HEDGE_PERCENTILE, hedge_percentile);
+
+    if (codec != SHLC_CODEC_XML)
+        SHLC_set_option(handle, SHLC_OPTION_CODEC, codec);
+
+    if (dictionary_path != NULL && set_dictionary(handle, dictionary_path) != 0)
     {
-        fprintf(stderr, "*** SHLC_location failed (%d)!\n\n", rc);
+        fprintf(stderr, "*** cannot load %s!\n\n", dictionary_path);
+        return 1;
     }
-    else
+
+    if (encoding != SHLC_ENCODING_IDENTITY
+            && SHLC_set_option(handle, SHLC_OPTION_REQUEST_ENCODING, encoding) != SHLC_OK)
+    {
+        fprintf(stderr, "*** compression not supported!\n\n");
+        return 1;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        rc = SHLC_location(handle, MY_API_KEY, &location);
+        if (rc != SHLC_OK)
+        {
+            fprintf(stderr, "*** SHLC_location failed (%d)!\n\n", rc);
+        }
+        else
+        {
+            print_location(location);
+            SHLC_free_location(handle, location);
+        }
+    }
+
+    if (hedge_percentile > 0 && SHLC_get_statistics(handle, &statistics) == SHLC_OK)
     {
-        print_location(location);
-        SHLC_free_location(handle, location);
+        printf("hedged %lu requests, %lu answered first\n",
+               statistics.hedged_requests,
+               statistics.hedge_wins);
     }
 
     SHLC_deinit(handle);
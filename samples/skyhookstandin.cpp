@@ -0,0 +1,657 @@
+/**
+ * \author Skyhook Wireless
+ *
+ * \section license LIMITED USE LICENSE
+ *
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * A stand-in for the location server, answering every request with
+ * the same location after an injected delay, to exercise the client
+ * against a local server:
+ *
+ *   skyhookstandin -p 8080 -d 20 -s 500 -r 5 &
+ *   skyhooklitetest -u http://127.0.0.1:8080/wps2/location
+ *
+ * Connections are kept alive, and each is served by a thread of its own.
+ *
+ * Compressed requests (gzip, deflate, and zstd if built with it) are
+ * decompressed and checked, and the response is gzipped for clients
+ * that accept it; -v prints the size of each request on the wire
+ * and decompressed.
+ *
+ * Requests in the binary encoding of SHLC_CODEC_BINARY (see
+ * src/api/BinaryCodec.h) are answered in kind, with the same location
+ * and as many access points as the request had.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#  include <zstd.h>
+#endif
+
+#ifdef HAVE_GETOPT_H
+#  include <getopt.h>
+#endif
+
+static const char* LOCATION_RS =
+    "<?xml version='1.0'?>"
+    "<LocationRS version='2.26' xmlns='http://skyhookwireless.com/wps/2005'>"
+    "<location nap='3' ncell='0' nsat='0' nlac='0'>"
+    "<latitude>42.3516</latitude>"
+    "<longitude>-71.0486</longitude>"
+    "<hpe>25</hpe>"
+    "</location>"
+    "</LocationRS>";
+
+static const char* BINARY_CONTENT_TYPE = "application/x-shlc-binary";
+static const unsigned char BINARY_MAGIC[] = { 'S', 'H', 'B', 1 };
+
+/* Injected delays, in milliseconds */
+static unsigned long base_delay = 0;
+static unsigned long slow_delay = 0;
+static unsigned int slow_percent = 0;
+
+static int verbose = 0;
+
+/* LOCATION_RS, gzipped */
+static unsigned char gzipped_rs[512];
+static size_t gzipped_rs_size = 0;
+
+#ifdef HAVE_ZSTD
+static ZSTD_DDict* zstd_dictionary = NULL;
+#endif
+
+static pthread_mutex_t random_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+sleep_ms(unsigned long ms)
+{
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+static unsigned long
+next_delay()
+{
+    int slow;
+
+    pthread_mutex_lock(&random_mutex);
+    slow = (unsigned int) (rand() % 100) < slow_percent;
+    pthread_mutex_unlock(&random_mutex);
+
+    return slow ? slow_delay : base_delay;
+}
+
+static int
+write_all(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        const ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n <= 0)
+            return -1;
+        data += n;
+        size -= (size_t) n;
+    }
+    return 0;
+}
+
+/*
+ * \return the value of header \c name in \c headers, NULL if absent.
+ */
+static const char*
+find_header(const char* headers, const char* name)
+{
+    const size_t len = strlen(name);
+    const char* line = strstr(headers, "\r\n");
+
+    while (line != NULL && line[2] != '\r')
+    {
+        line += 2;
+        if (strncasecmp(line, name, len) == 0 && line[len] == ':')
+        {
+            line += len + 1;
+            while (*line == ' ')
+                ++line;
+            return line;
+        }
+        line = strstr(line, "\r\n");
+    }
+
+    return NULL;
+}
+
+/*
+ * \return the value of header \c name in \c headers, -1 if absent.
+ */
+static long
+header_value(const char* headers, const char* name)
+{
+    const char* value = find_header(headers, name);
+    return value != NULL ? atol(value) : -1;
+}
+
+/*
+ * \return non-zero if header \c name in \c headers is \c value.
+ */
+static int
+header_is(const char* headers, const char* name, const char* value)
+{
+    const char* found = find_header(headers, name);
+    const size_t len = strlen(value);
+    return found != NULL
+        && strncasecmp(found, value, len) == 0
+        && (found[len] == '\r' || found[len] == ';' || found[len] == ' ');
+}
+
+static void
+gzip_response()
+{
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+
+    if (deflateInit2(&z, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+        return;
+
+    z.next_in = (Bytef*) LOCATION_RS;
+    z.avail_in = (uInt) strlen(LOCATION_RS);
+    z.next_out = gzipped_rs;
+    z.avail_out = sizeof(gzipped_rs);
+
+    if (deflate(&z, Z_FINISH) == Z_STREAM_END)
+        gzipped_rs_size = z.total_out;
+
+    deflateEnd(&z);
+}
+
+/*
+ * Decompress the request body into \c decoded, null-terminated.
+ *
+ * \return the size of the decompressed body, -1 if it isn't valid,
+ *         -2 if its encoding isn't supported.
+ */
+static long
+decode_body(const char* headers,
+            const char* body,
+            size_t size,
+            char* decoded,
+            size_t capacity)
+{
+    long decoded_size = -1;
+
+    /* Room for the terminating null */
+    --capacity;
+
+    if (find_header(headers, "Content-Encoding") == NULL
+            || header_is(headers, "Content-Encoding", "identity"))
+    {
+        if (size <= capacity)
+        {
+            memcpy(decoded, body, size);
+            decoded_size = (long) size;
+        }
+    }
+    else if (header_is(headers, "Content-Encoding", "gzip")
+            || header_is(headers, "Content-Encoding", "deflate"))
+    {
+        z_stream z;
+        memset(&z, 0, sizeof(z));
+
+        /* 32 more detects the gzip or zlib header */
+        if (inflateInit2(&z, 15 + 32) == Z_OK)
+        {
+            z.next_in = (Bytef*) body;
+            z.avail_in = (uInt) size;
+            z.next_out = (Bytef*) decoded;
+            z.avail_out = (uInt) capacity;
+
+            if (inflate(&z, Z_FINISH) == Z_STREAM_END)
+                decoded_size = (long) z.total_out;
+
+            inflateEnd(&z);
+        }
+    }
+#ifdef HAVE_ZSTD
+    else if (header_is(headers, "Content-Encoding", "zstd"))
+    {
+        ZSTD_DCtx* dctx = ZSTD_createDCtx();
+        const size_t n =
+            zstd_dictionary != NULL
+                ? ZSTD_decompress_usingDDict(dctx, decoded, capacity,
+                                             body, size, zstd_dictionary)
+                : ZSTD_decompressDCtx(dctx, decoded, capacity, body, size);
+
+        if (! ZSTD_isError(n))
+            decoded_size = (long) n;
+        else if (verbose)
+            printf("zstd: %s\n", ZSTD_getErrorName(n));
+
+        ZSTD_freeDCtx(dctx);
+    }
+#endif
+    else
+        decoded_size = -2;
+
+    if (decoded_size >= 0)
+        decoded[decoded_size] = '\0';
+
+    return decoded_size;
+}
+
+static unsigned long
+get16(const unsigned char* p)
+{
+    return ((unsigned long) p[0] << 8) | p[1];
+}
+
+static unsigned char*
+put16(unsigned char* p, unsigned long value)
+{
+    *p++ = (unsigned char) (value >> 8);
+    *p++ = (unsigned char) value;
+    return p;
+}
+
+static unsigned char*
+put32(unsigned char* p, unsigned long value)
+{
+    return put16(put16(p, value >> 16), value & 0xffff);
+}
+
+/*
+ * Check the start of a binary request, up to its access points.
+ *
+ * \return the number of access points, -1 if the request isn't valid.
+ */
+static long
+binary_ap_count(const unsigned char* rq, size_t size)
+{
+    const unsigned char* p = rq + sizeof(BINARY_MAGIC);
+    const unsigned char* end = rq + size;
+    unsigned long count;
+    unsigned long i;
+    int field;
+
+    if (size < sizeof(BINARY_MAGIC)
+            || memcmp(rq, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0)
+        return -1;
+
+    /* key, username */
+    for (field = 0; field < 2; ++field)
+    {
+        if (end - p < 2 || (unsigned long) (end - p - 2) < get16(p))
+            return -1;
+        p += 2 + get16(p);
+    }
+
+    if (end - p < 2)
+        return -1;
+    count = get16(p);
+    p += 2;
+
+    /* mac, rssi, age, ssid */
+    for (i = 0; i < count; ++i)
+    {
+        if (end - p < 12 || end - p - 12 < p[11])
+            return -1;
+        p += 12 + p[11];
+    }
+
+    return (long) count;
+}
+
+/*
+ * \return the size of the binary response written to \c out.
+ */
+static size_t
+binary_response(unsigned char* out, unsigned long nap)
+{
+    unsigned char* p = out;
+
+    memcpy(p, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    p += sizeof(BINARY_MAGIC);
+
+    *p++ = 0;   /* located */
+    *p++ = 1;   /* one location */
+
+    p = put32(p, 423516000UL);                       /* 42.3516 */
+    p = put32(p, (unsigned long) -710486000L);       /* -71.0486 */
+    p = put16(p, 25);                                /* hpe */
+    p = put16(p, nap);
+    p = put16(p, 0);                                 /* ncell */
+    p = put16(p, 0);                                 /* nsat */
+    p = put16(p, 0);                                 /* nlac */
+    p = put32(p, 0);                                 /* age */
+
+    return (size_t) (p - out);
+}
+
+#ifdef HAVE_ZSTD
+static int
+load_dictionary(const char* path)
+{
+    char* data;
+    long size;
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+        return -1;
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data = (char*) malloc((size_t) size);
+    if (data == NULL || fread(data, 1, (size_t) size, f) != (size_t) size)
+    {
+        free(data);
+        fclose(f);
+        return -1;
+    }
+
+    zstd_dictionary = ZSTD_createDDict(data, (size_t) size);
+
+    free(data);
+    fclose(f);
+    return zstd_dictionary != NULL ? 0 : -1;
+}
+#endif
+
+static void
+serve(int fd)
+{
+    char buf[16 * 1024];
+    char decoded[64 * 1024];
+    size_t used = 0;
+
+    for (;;)
+    {
+        char* end;
+        char response[512];
+        size_t header_size;
+        size_t body_size;
+        long content_length;
+        long decoded_size;
+        long nap = 0;
+        int binary;
+        int gzip;
+        int len;
+        unsigned char binary_rs[64];
+        const char* rs;
+        size_t rs_size;
+
+        /* Read the request line and headers */
+        buf[used] = '\0';
+        while ((end = strstr(buf, "\r\n\r\n")) == NULL)
+        {
+            ssize_t n;
+            if (used == sizeof(buf) - 1)
+                return;
+
+            n = recv(fd, buf + used, sizeof(buf) - 1 - used, 0);
+            if (n <= 0)
+                return;
+
+            used += (size_t) n;
+            buf[used] = '\0';
+        }
+
+        header_size = (size_t) (end + 4 - buf);
+        content_length = header_value(buf, "Content-Length");
+        body_size = content_length > 0 ? (size_t) content_length : 0;
+        if (header_size + body_size > sizeof(buf) - 1)
+            return;
+
+        /* Read the body, which doesn't matter */
+        while (used < header_size + body_size)
+        {
+            const ssize_t n = recv(fd, buf + used, sizeof(buf) - 1 - used, 0);
+            if (n <= 0)
+                return;
+            used += (size_t) n;
+        }
+
+        decoded_size = decode_body(buf,
+                                   buf + header_size,
+                                   body_size,
+                                   decoded,
+                                   sizeof(decoded));
+
+        binary = header_is(buf, "Content-Type", BINARY_CONTENT_TYPE);
+
+        if (decoded_size >= 0)
+        {
+            if (binary)
+                nap = binary_ap_count((const unsigned char*) decoded,
+                                      (size_t) decoded_size);
+            else if (strstr(decoded, "<LocationRQ") == NULL)
+                nap = -1;
+
+            if (nap < 0)
+                decoded_size = -1;
+        }
+
+        if (verbose)
+        {
+            printf("%lu bytes on the wire, %ld decoded\n",
+                   (unsigned long) body_size,
+                   decoded_size);
+            fflush(stdout);
+        }
+
+        sleep_ms(next_delay());
+
+        gzip = ! binary
+            && gzipped_rs_size > 0
+            && find_header(buf, "Accept-Encoding") != NULL
+            && strstr(find_header(buf, "Accept-Encoding"), "gzip") != NULL;
+
+        if (binary)
+        {
+            rs_size = binary_response(binary_rs, (unsigned long) nap);
+            rs = (const char*) binary_rs;
+        }
+        else if (gzip)
+        {
+            rs_size = gzipped_rs_size;
+            rs = (const char*) gzipped_rs;
+        }
+        else
+        {
+            rs_size = strlen(LOCATION_RS);
+            rs = LOCATION_RS;
+        }
+
+        if (decoded_size < 0)
+            len = snprintf(response,
+                           sizeof(response),
+                           "HTTP/1.1 %s\r\n"
+                           "Content-Length: 0\r\n"
+                           "\r\n",
+                           decoded_size == -2 ? "415 Unsupported Media Type"
+                                              : "400 Bad Request");
+        else
+            len = snprintf(response,
+                           sizeof(response),
+                           "HTTP/1.1 200 OK\r\n"
+                           "Content-Type: %s\r\n"
+                           "%s"
+                           "Content-Length: %lu\r\n"
+                           "\r\n",
+                           binary ? BINARY_CONTENT_TYPE : "text/xml",
+                           gzip ? "Content-Encoding: gzip\r\n" : "",
+                           (unsigned long) rs_size);
+
+        if (write_all(fd, response, (size_t) len) != 0)
+            return;
+        if (decoded_size >= 0 && write_all(fd, rs, rs_size) != 0)
+            return;
+
+        /* Keep whatever was pipelined after this request */
+        used -= header_size + body_size;
+        memmove(buf, buf + header_size + body_size, used);
+    }
+}
+
+static void*
+connection_thread(void* param)
+{
+    const int fd = (int) (long) param;
+    serve(fd);
+    close(fd);
+    return NULL;
+}
+
+static void
+usage(const char* argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-p port] [-d delay] [-s slow_delay] [-r slow_percent]\n"
+            "          [-D zstd_dictionary] [-v]\n"
+            "\n"
+            "  -p port          port to listen on (8080)\n"
+            "  -d delay         milliseconds before each answer (0)\n"
+            "  -s slow_delay    milliseconds before a slow answer (0)\n"
+            "  -r slow_percent  percentage of slow answers (0)\n"
+            "  -D dictionary    dictionary of zstd compressed requests\n"
+            "  -v               print the size of each request\n",
+            argv0);
+}
+
+/*********************************************************************/
+/*                                                                   */
+/* main                                                              */
+/*                                                                   */
+/*********************************************************************/
+
+int
+main(int argc, char* argv[])
+{
+    unsigned short port = 8080;
+    struct sockaddr_in address;
+    int server;
+    int on = 1;
+
+#ifdef HAVE_GETOPT_H
+    int c;
+    while ((c = getopt(argc, argv, "p:d:s:r:D:vh")) != -1)
+    {
+        switch (c)
+        {
+        case 'p':
+            port = (unsigned short) atoi(optarg);
+            break;
+        case 'd':
+            base_delay = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            slow_delay = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            slow_percent = (unsigned int) atoi(optarg);
+            break;
+        case 'D':
+#ifdef HAVE_ZSTD
+            if (load_dictionary(optarg) != 0)
+            {
+                fprintf(stderr, "cannot load dictionary %s\n", optarg);
+                return 1;
+            }
+#else
+            fprintf(stderr, "built without zstd\n");
+            return 1;
+#endif
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+#else
+    (void) argc;
+    (void) argv;
+    (void) usage;
+#endif
+
+    gzip_response();
+
+    server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    if (bind(server, (struct sockaddr*) &address, sizeof(address)) != 0
+            || listen(server, 64) != 0)
+    {
+        perror("bind");
+        return 1;
+    }
+
+    printf("listening on port %u\n", port);
+    fflush(stdout);
+
+    for (;;)
+    {
+        pthread_t thread;
+        const int fd = accept(server, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("accept");
+            return 1;
+        }
+
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        if (pthread_create(&thread, NULL, &connection_thread, (void*) (long) fd) != 0)
+        {
+            close(fd);
+            continue;
+        }
+
+        pthread_detach(thread);
+    }
+}
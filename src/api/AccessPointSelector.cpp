@@ -0,0 +1,134 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AccessPointSelector.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+
+namespace WPS {
+namespace API {
+
+using namespace WPS::SPI;
+
+/**
+ * Share of the selected access points, in percent, that a single OUI
+ * may take before the others have had their pick.
+ * \n
+ * Enterprise deployments advertise many BSSIDs from the same few
+ * radios, which tell little more than one of them does.
+ */
+static const unsigned long MAX_OUI_SHARE = 25;
+
+struct NewerReading
+    : std::binary_function<ScannedAccessPoint, ScannedAccessPoint, bool>
+{
+    bool operator()(const ScannedAccessPoint& lhs,
+                    const ScannedAccessPoint& rhs) const
+    {
+        return lhs.getTimestamp() > rhs.getTimestamp();
+    }
+};
+
+static bool
+isNotGloballyUnique(const ScannedAccessPoint& ap)
+{
+    return ! ap.getMAC().isGloballyUnique();
+}
+
+static unsigned long
+getOUI(const ScannedAccessPoint& ap)
+{
+    return static_cast<unsigned long>(ap.getMAC().toLong() >> 24);
+}
+
+AccessPointSelector::AccessPointSelector()
+    : _mutex(Mutex::newInstance())
+    , _maxAccessPoints(0)
+{}
+
+void
+AccessPointSelector::setMaxAccessPoints(unsigned long maxAccessPoints)
+{
+    Guard guard(_mutex.get());
+    _maxAccessPoints = maxAccessPoints;
+}
+
+bool
+AccessPointSelector::select(const std::vector<ScannedAccessPoint>& scanned,
+                            std::vector<ScannedAccessPoint>& selected) const
+{
+    unsigned long maxAccessPoints;
+    {
+        Guard guard(_mutex.get());
+        maxAccessPoints = _maxAccessPoints;
+    }
+
+    if (maxAccessPoints == 0)
+        return false;
+
+    std::vector<ScannedAccessPoint> aps(scanned);
+
+    // Newest reading first for each MAC, so that it's the one kept
+    std::stable_sort(aps.begin(), aps.end(), NewerReading());
+    std::stable_sort(aps.begin(), aps.end(), ScannedAccessPoint::MacLess());
+    aps.erase(std::unique(aps.begin(), aps.end(), ScannedAccessPoint::MacSame()),
+              aps.end());
+
+    aps.erase(std::remove_if(aps.begin(), aps.end(), isNotGloballyUnique),
+              aps.end());
+
+    if (aps.size() <= maxAccessPoints)
+    {
+        selected.swap(aps);
+        return true;
+    }
+
+    // Strongest first
+    std::stable_sort(aps.rbegin(), aps.rend(), ScannedAccessPoint::WeakerRssi());
+
+    const size_t maxPerOUI =
+        std::max<size_t>(1, maxAccessPoints * MAX_OUI_SHARE / 100);
+
+    selected.clear();
+    selected.reserve(maxAccessPoints);
+    std::vector<bool> taken(aps.size(), false);
+    std::map<unsigned long, size_t> perOUI;
+
+    for (size_t i = 0; i < aps.size() && selected.size() < maxAccessPoints; ++i)
+    {
+        size_t& count = perOUI[getOUI(aps[i])];
+        if (count < maxPerOUI)
+        {
+            ++count;
+            selected.push_back(aps[i]);
+            taken[i] = true;
+        }
+    }
+
+    // Fill whatever room is left with the strongest of the others
+    for (size_t i = 0; i < aps.size() && selected.size() < maxAccessPoints; ++i)
+    {
+        if (! taken[i])
+            selected.push_back(aps[i]);
+    }
+
+    return true;
+}
+
+}
+}
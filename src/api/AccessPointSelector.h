@@ -0,0 +1,76 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_ACCESSPOINTSELECTOR_H_
+#define WPS_API_ACCESSPOINTSELECTOR_H_
+
+#include "spi/Concurrent.h"
+#include "spi/ScannedAccessPoint.h"
+
+#include <memory>
+#include <vector>
+
+namespace WPS {
+namespace API {
+
+/**
+ * Bounds the number of access points sent to the server.
+ * \n
+ * Dense environments (stadiums, office towers) have hundreds of BSSIDs,
+ * most of which add to the size of the request and to the server's work
+ * without improving the location.
+ */
+class AccessPointSelector
+{
+public:
+
+    AccessPointSelector();
+
+    /**
+     * Set the maximum number of access points to send.
+     * \n
+     * \c 0 sends all of them as they were scanned (the default).
+     */
+    void setMaxAccessPoints(unsigned long maxAccessPoints);
+
+    /**
+     * Select the access points of \c aps worth sending:
+     * \li one reading per MAC, the newest
+     * \li no locally administered MACs (mobile hotspots and the like)
+     * \li the strongest ones, but no more than a share of them
+     *     per manufacturer (OUI) unless there's room left.
+     *
+     * @return \c false if the selection is disabled,
+     *         in which case \c selected is left alone.
+     */
+    bool select(const std::vector<SPI::ScannedAccessPoint>& aps,
+                std::vector<SPI::ScannedAccessPoint>& selected) const;
+
+private:
+
+    AccessPointSelector(const AccessPointSelector&);
+    AccessPointSelector& operator=(const AccessPointSelector&);
+
+private:
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    unsigned long _maxAccessPoints;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,565 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_ADAPTERS_H_
+#define WPS_API_ADAPTERS_H_
+
+#include "spi/WifiAdapter.h"
+#include "spi/CellAdapter.h"
+#include "spi/GPSAdapter.h"
+#include "spi/Concurrent.h"
+#include "spi/Thread.h"
+#include "spi/Time.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace WPS {
+namespace API {
+
+/**
+ * Long-lived owner of the Wi-Fi adapter.
+ *
+ * Turns the asynchronous \c WifiAdapter interface into a blocking
+ * \c scan() call.
+ * \n
+ * Concurrent callers share the scan in progress rather than each
+ * triggering one (which the driver would reject as busy).
+ */
+class WifiWrapper
+    : public SPI::WifiAdapter::Listener
+{
+public:
+
+    WifiWrapper()
+        : _mutex(SPI::Mutex::newInstance())
+        , _scanMutex(SPI::Mutex::newInstance())
+        , _event(SPI::Event::newInstance())
+        , _rc(SPI::SPI_ERROR_NOT_READY)
+        , _scanning(false)
+        , _requested(0)
+        , _completed(0)
+        , _reported(0)
+        , _maxScanAge(0)
+    {}
+
+    ~WifiWrapper()
+    {
+        close();
+    }
+
+    SPI::ErrorCode open()
+    {
+        SPI::Guard guard(_scanMutex.get());
+
+        if (_wifi.get() != NULL)
+            return SPI::SPI_OK;
+
+        std::auto_ptr<SPI::WifiAdapter> wifi(SPI::WifiAdapter::newInstance());
+        if (wifi.get() == NULL)
+            return SPI::SPI_ERROR;
+
+        wifi->setListener(this);
+        wifi->setMaxScanAge(_maxScanAge);
+
+        const SPI::ErrorCode rc = wifi->open();
+        if (rc != SPI::SPI_OK)
+            return rc;
+
+        _wifi = wifi;
+        return SPI::SPI_OK;
+    }
+
+    void close()
+    {
+        SPI::Guard guard(_scanMutex.get());
+        _wifi.reset();
+
+        // The scan in progress, if any, won't be reported anymore
+        bool scanning;
+        {
+            SPI::Guard guard(_mutex.get());
+            scanning = _scanning;
+        }
+
+        if (scanning)
+            onScanFailed(SPI::SPI_ERROR);
+    }
+
+    bool isOpen()
+    {
+        SPI::Guard guard(_scanMutex.get());
+        return _wifi.get() != NULL;
+    }
+
+    /**
+     * @see SPI::WifiAdapter::setMaxScanAge()
+     */
+    void setMaxScanAge(unsigned long maxAge)
+    {
+        SPI::Guard guard(_scanMutex.get());
+
+        _maxScanAge = maxAge;
+        if (_wifi.get() != NULL)
+            _wifi->setMaxScanAge(maxAge);
+    }
+
+    /**
+     * @param scanId set to what identifies the scan reported,
+     *               the same for callers that shared it.
+     */
+    SPI::ErrorCode scan(unsigned long timeout,
+                        std::vector<SPI::ScannedAccessPoint>& scannedAPs,
+                        unsigned long& scanId)
+    {
+        const SPI::Timer started;
+
+        unsigned long generation;
+        bool leader = false;
+        {
+            SPI::Guard guard(_mutex.get());
+
+            // Join the scan in progress, if any, even one whose caller
+            // gave up waiting: the driver would reject another as busy
+            if (! _scanning || _scanStarted.elapsed() >= MAX_SCAN_DURATION)
+            {
+                _scanning = true;
+                _scanStarted = SPI::Timer();
+                ++_requested;
+                _event->clear();
+                leader = true;
+            }
+
+            generation = _requested;
+        }
+
+        if (leader)
+        {
+            SPI::Guard guard(_scanMutex.get());
+
+            if (_wifi.get() != NULL)
+                _wifi->startScan();
+            else
+                onScanFailed(SPI::SPI_ERROR);
+        }
+
+        for (;;)
+        {
+            {
+                SPI::Guard guard(_mutex.get());
+
+                // Results of a later scan are just as good
+                if (_completed >= generation)
+                {
+                    if (_rc != SPI::SPI_OK)
+                        return _rc;
+
+                    scannedAPs = _scan;
+                    scanId = _reported;
+                    return SPI::SPI_OK;
+                }
+            }
+
+            // A failed wait is treated like a timeout rather than retried
+            const unsigned long elapsed = started.elapsed();
+            if (elapsed >= timeout || _event->wait(timeout - elapsed) != 0)
+            {
+                SPI::Guard guard(_mutex.get());
+
+                if (_completed >= generation)
+                    continue;
+
+                // The scan stays in progress until the adapter reports it
+                return SPI::SPI_ERROR;
+            }
+        }
+    }
+
+    /**
+     * Get the results of the last successful scan, for when
+     * there's no time to wait for a new one.
+     *
+     * @param maxAge age, in milliseconds, beyond which
+     *               access points are left out.
+     * @param scanId set as by \c scan().
+     */
+    void getLastScan(unsigned long maxAge,
+                     std::vector<SPI::ScannedAccessPoint>& scannedAPs,
+                     unsigned long& scanId)
+    {
+        SPI::Guard guard(_mutex.get());
+
+        scanId = _reported;
+
+        scannedAPs.clear();
+        for (std::vector<SPI::ScannedAccessPoint>::const_iterator it = _scan.begin();
+             it != _scan.end();
+             ++it)
+        {
+            if (it->getTimestamp().elapsed() <= maxAge)
+                scannedAPs.push_back(*it);
+        }
+    }
+
+    std::string getHardwareMAC()
+    {
+        SPI::Guard guard(_scanMutex.get());
+
+        if (_wifi.get() == NULL)
+            return "";
+
+        SPI::MAC mac;
+        if (_wifi->getHardwareMAC(mac) != SPI::SPI_OK)
+            return "";
+        if (mac.toLong() == 0)
+            return "";
+        return mac.toString();
+    }
+
+private:
+
+    void onScanCompleted(const std::vector<SPI::ScannedAccessPoint>& scannedAPs)
+    {
+        {
+            SPI::Guard guard(_mutex.get());
+            _rc = SPI::SPI_OK;
+            _scan = scannedAPs;
+            ++_reported;
+            _scanning = false;
+            _completed = _requested;
+        }
+        _event->signal();
+    }
+
+    void onScanFailed(SPI::ErrorCode code)
+    {
+        {
+            SPI::Guard guard(_mutex.get());
+            _rc = code;
+            // _scan is kept for getLastScan()
+            _scanning = false;
+            _completed = _requested;
+        }
+        _event->signal();
+    }
+
+private:
+
+    /**
+     * Beyond which a scan the adapter never reported is given up on.
+     */
+    static const unsigned long MAX_SCAN_DURATION = 30 * 1000;
+
+    std::auto_ptr<SPI::Mutex> _mutex;      // guards scan state and results
+    std::auto_ptr<SPI::Mutex> _scanMutex;  // serializes use of the adapter
+    std::auto_ptr<SPI::Event> _event;      // signaled when a scan completes
+    SPI::ErrorCode _rc;
+    std::vector<SPI::ScannedAccessPoint> _scan;   // of the last successful scan
+    bool _scanning;
+    SPI::Timer _scanStarted;    // of the scan in progress
+    unsigned long _requested;   // generation of the last scan started
+    unsigned long _completed;   // generation of the last scan completed
+    unsigned long _reported;    // successful scans reported, identifies _scan
+    unsigned long _maxScanAge;  // guarded by _scanMutex
+    std::auto_ptr<SPI::WifiAdapter> _wifi;
+};
+
+/**
+ * Long-lived owner of the GPS adapter.
+ *
+ * Keeps the most recent fixes so that a location request can include
+ * whatever the receiver has acquired since it was opened.
+ */
+class GpsWrapper
+    : public SPI::GPSAdapter::Listener
+{
+public:
+
+    GpsWrapper()
+        : _mutex(SPI::Mutex::newInstance())
+    {}
+
+    ~GpsWrapper()
+    {
+        close();
+    }
+
+    SPI::ErrorCode open()
+    {
+        if (isOpen())
+            return SPI::SPI_OK;
+
+        std::auto_ptr<SPI::GPSAdapter> gps(SPI::GPSAdapter::newInstance());
+        if (gps.get() == NULL)
+            return SPI::SPI_ERROR;
+
+        gps->setListener(this);
+
+        const SPI::ErrorCode rc = gps->open();
+        if (rc != SPI::SPI_OK)
+            return rc;
+
+        SPI::Guard guard(_mutex.get());
+        _gps = gps;
+        return SPI::SPI_OK;
+    }
+
+    void close()
+    {
+        std::auto_ptr<SPI::GPSAdapter> gps;
+        {
+            SPI::Guard guard(_mutex.get());
+            gps = _gps;
+        }
+
+        // Close outside of the lock since the adapter
+        // may report data while closing
+        gps.reset();
+
+        SPI::Guard guard(_mutex.get());
+        _fixes.clear();
+    }
+
+    bool isOpen()
+    {
+        SPI::Guard guard(_mutex.get());
+        return _gps.get() != NULL;
+    }
+
+    void getFixes(std::vector<SPI::GPSData::Fix>& fixes)
+    {
+        SPI::Guard guard(_mutex.get());
+        pruneFixes();
+        fixes = _fixes;
+    }
+
+private:
+
+    void onGpsData(const SPI::GPSData& gpsData)
+    {
+        SPI::Guard guard(_mutex.get());
+
+        if (gpsData.fix.get())
+        {
+            const SPI::GPSData::Fix newFix = *gpsData.fix;
+
+            if (_fixes.empty() || _fixes.back().gpsTime != newFix.gpsTime)
+                _fixes.push_back(newFix);
+
+            pruneFixes();
+        }
+    }
+
+    void onGpsError(SPI::ErrorCode)
+    {}
+
+    /**
+     * Drop fixes that are too old to be sent
+     * (the adapter stays open between requests).
+     */
+    void pruneFixes()
+    {
+        std::vector<SPI::GPSData::Fix>::iterator it = _fixes.begin();
+        while (it != _fixes.end() && it->localTime.elapsed() > MAX_FIX_AGE)
+            ++it;
+
+        _fixes.erase(_fixes.begin(), it);
+
+        if (_fixes.size() > MAX_FIXES)
+            _fixes.erase(_fixes.begin(), _fixes.end() - MAX_FIXES);
+    }
+
+private:
+
+    static const unsigned long MAX_FIX_AGE = 20 * 1000;
+    static const size_t MAX_FIXES = 20;
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    std::vector<SPI::GPSData::Fix> _fixes;
+    std::auto_ptr<SPI::GPSAdapter> _gps;
+};
+
+/**
+ * Long-lived owner of the cell adapter.
+ */
+class CellWrapper
+    : public SPI::CellAdapter::Listener
+{
+public:
+
+    CellWrapper()
+        : _mutex(SPI::Mutex::newInstance())
+    {}
+
+    ~CellWrapper()
+    {
+        close();
+    }
+
+    SPI::ErrorCode open()
+    {
+        if (isOpen())
+            return SPI::SPI_OK;
+
+        std::auto_ptr<SPI::CellAdapter> cellAdapter(SPI::CellAdapter::newInstance());
+        if (cellAdapter.get() == NULL)
+            return SPI::SPI_ERROR;
+
+        cellAdapter->setListener(this);
+
+        const SPI::ErrorCode rc = cellAdapter->open();
+        if (rc != SPI::SPI_OK)
+            return rc;
+
+        SPI::Guard guard(_mutex.get());
+        _cellAdapter = cellAdapter;
+        return SPI::SPI_OK;
+    }
+
+    void close()
+    {
+        std::auto_ptr<SPI::CellAdapter> cellAdapter;
+        {
+            SPI::Guard guard(_mutex.get());
+            cellAdapter = _cellAdapter;
+        }
+
+        // Close outside of the lock since the adapter
+        // may report its last cell change while closing
+        cellAdapter.reset();
+
+        SPI::Guard guard(_mutex.get());
+        _scannedCells.clear();
+    }
+
+    bool isOpen()
+    {
+        SPI::Guard guard(_mutex.get());
+        return _cellAdapter.get() != NULL;
+    }
+
+    void getScannedCells(std::vector<SPI::ScannedCellTower>& scannedCells)
+    {
+        SPI::Guard guard(_mutex.get());
+        scannedCells = _scannedCells;
+    }
+
+    std::string getIMEI()
+    {
+        SPI::Guard guard(_mutex.get());
+        if (_cellAdapter.get() == NULL)
+            return "";
+        std::string imei;
+        if (_cellAdapter->getIMEI(imei) != SPI::SPI_OK)
+            return "";
+        return imei;
+    }
+
+private:
+
+    void onCellChanged(const std::vector<SPI::ScannedCellTower>& scannedCells)
+    {
+        SPI::Guard guard(_mutex.get());
+        _scannedCells = scannedCells;
+    }
+
+    void onCellError(SPI::ErrorCode)
+    {}
+
+private:
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    std::vector<SPI::ScannedCellTower> _scannedCells;
+    std::auto_ptr<SPI::CellAdapter> _cellAdapter;
+};
+
+/**
+ * Opens an adapter wrapper on a thread of its own,
+ * so that slow adapters don't hold up the others.
+ */
+template <class Wrapper>
+class AdapterOpener
+    : private SPI::JoinableThread::Runnable
+{
+public:
+
+    explicit AdapterOpener(Wrapper& wrapper)
+        : _wrapper(wrapper)
+        , _done(SPI::Event::newSignaledInstance())
+    {}
+
+    ~AdapterOpener()
+    {
+        join();
+    }
+
+    /**
+     * Start opening the adapter unless that's already in progress.
+     *
+     * @note Calls must be serialized by the caller.
+     */
+    void start()
+    {
+        if (_thread.get() != NULL && _done->wait(0) != 0)
+            return;
+
+        _thread.reset();
+        _done->clear();
+
+        _thread.reset(SPI::JoinableThread::newInstance(this));
+        if (_thread.get() == NULL)
+            run();
+    }
+
+    /**
+     * Wait up to \c timeout milliseconds for the adapter to be opened
+     * (or to fail to).
+     */
+    void wait(unsigned long timeout)
+    {
+        _done->wait(timeout);
+    }
+
+    void join()
+    {
+        _thread.reset();
+    }
+
+private:
+
+    void run()
+    {
+        _wrapper.open();
+        _done->signal();
+    }
+
+private:
+
+    AdapterOpener(const AdapterOpener&);
+    AdapterOpener& operator=(const AdapterOpener&);
+
+private:
+
+    Wrapper& _wrapper;
+    std::auto_ptr<SPI::Event> _done;
+    std::auto_ptr<SPI::JoinableThread> _thread;
+};
+
+}
+}
+
+#endif
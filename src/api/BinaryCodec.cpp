@@ -0,0 +1,320 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BinaryCodec.h"
+
+#include "spi/Time.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+namespace WPS {
+namespace API {
+
+using namespace WPS::SPI;
+
+static const char MAGIC[] = { 'S', 'H', 'B', 1 };
+
+enum Status
+{
+    STATUS_LOCATED = 0,
+    STATUS_NOT_LOCATED = 1
+};
+
+enum GpsFields
+{
+    GPS_HPE = 0x01,
+    GPS_ALTITUDE = 0x02,
+    GPS_HEIGHT = 0x04,
+    GPS_SPEED = 0x08,
+    GPS_BEARING = 0x10
+};
+
+/**********************************************************************/
+/*                                                                    */
+/* Writing                                                            */
+/*                                                                    */
+/**********************************************************************/
+
+static inline void
+put8(std::string& out, unsigned long value)
+{
+    out += static_cast<char>(value & 0xff);
+}
+
+static inline void
+put16(std::string& out, unsigned long value)
+{
+    put8(out, value >> 8);
+    put8(out, value);
+}
+
+static inline void
+put32(std::string& out, unsigned long value)
+{
+    put16(out, value >> 16);
+    put16(out, value);
+}
+
+static inline void
+putString16(std::string& out, const char* s, size_t size)
+{
+    size = std::min<size_t>(size, 0xffff);
+    put16(out, size);
+    out.append(s, size);
+}
+
+/**
+ * @return \c value scaled to an integer, saturated to 32 bits.
+ */
+static inline long
+fixed(double value, double scale)
+{
+    const double scaled = floor(value * scale + 0.5);
+    if (scaled > 2147483647.)
+        return 2147483647L;
+    if (scaled < -2147483648.)
+        return -2147483647L - 1;
+    return static_cast<long>(scaled);
+}
+
+static inline unsigned long
+age(const Timer& now, const Timer& timestamp)
+{
+    const long delta = now.delta(timestamp);
+    return delta > 0 ? static_cast<unsigned long>(delta) : 0;
+}
+
+/**
+ * @return the number of elements of \c v that fit in a count field.
+ */
+template <class T>
+static inline size_t
+count16(const std::vector<T>& v)
+{
+    return std::min<size_t>(v.size(), 0xffff);
+}
+
+/**********************************************************************/
+/*                                                                    */
+/* Reading                                                            */
+/*                                                                    */
+/**********************************************************************/
+
+/**
+ * Reads integers off a response, failing past its end.
+ */
+class Reader
+{
+public:
+
+    Reader(const char* data, size_t size)
+        : _p(reinterpret_cast<const unsigned char*>(data))
+        , _end(_p + size)
+        , _ok(true)
+    {}
+
+    bool ok() const
+    {
+        return _ok;
+    }
+
+    unsigned long get8()
+    {
+        if (_p == _end)
+        {
+            _ok = false;
+            return 0;
+        }
+        return *_p++;
+    }
+
+    unsigned long get16()
+    {
+        const unsigned long hi = get8();
+        return (hi << 8) | get8();
+    }
+
+    unsigned long get32()
+    {
+        const unsigned long hi = get16();
+        return (hi << 16) | get16();
+    }
+
+    long getSigned32()
+    {
+        const unsigned long value = get32();
+        return value & 0x80000000UL
+            ? -static_cast<long>(0xffffffffUL - value) - 1
+            : static_cast<long>(value);
+    }
+
+private:
+
+    const unsigned char* _p;
+    const unsigned char* const _end;
+    bool _ok;
+};
+
+/**********************************************************************/
+/*                                                                    */
+/* BinaryCodec                                                        */
+/*                                                                    */
+/**********************************************************************/
+
+const char*
+BinaryCodec::getContentType() const
+{
+    return "application/x-shlc-binary";
+}
+
+void
+BinaryCodec::authentication(const char* key,
+                            const char* username,
+                            std::string& out) const
+{
+    out.clear();
+    putString16(out, key, strlen(key));
+    putString16(out, username, strlen(username));
+}
+
+void
+BinaryCodec::locationRQ(const std::string& authentication,
+                        const Scan& scan,
+                        std::string& out) const
+{
+    const Timer now;
+
+    out.clear();
+    out.reserve(sizeof(MAGIC)
+                + authentication.size()
+                + 6
+                + scan.aps.size() * (12 + 32)
+                + scan.cells.size() * 22
+                + scan.gps.size() * 33);
+
+    out.append(MAGIC, sizeof(MAGIC));
+    out.append(authentication);
+
+    const size_t naps = count16(scan.aps);
+    put16(out, naps);
+    for (size_t i = 0; i < naps; ++i)
+    {
+        const ScannedAccessPoint& ap = scan.aps[i];
+
+        // Stored least significant byte first, sent as printed
+        const MAC::raw_type& mac = ap.getMAC().getData();
+        for (size_t b = sizeof(mac); b > 0; --b)
+            put8(out, mac[b - 1]);
+
+        put8(out, static_cast<unsigned long>(ap.getRSSI()));
+        put32(out, age(now, ap.getTimestamp()));
+
+        const std::vector<unsigned char>& ssid = ap.getSsid();
+        const size_t ssidSize = std::min<size_t>(ssid.size(), 0xff);
+        put8(out, ssidSize);
+        if (ssidSize > 0)
+            out.append(reinterpret_cast<const char*>(&ssid[0]), ssidSize);
+    }
+
+    const size_t ncells = count16(scan.cells);
+    put16(out, ncells);
+    for (size_t i = 0; i < ncells; ++i)
+    {
+        const ScannedCellTower& scanned = scan.cells[i];
+        const CellTower& cell = scanned.getCell();
+
+        put8(out, cell.getType());
+        put16(out, cell.getMcc());
+        put16(out, cell.getMnc());
+        put32(out, static_cast<unsigned long>(cell.getLac()));
+        put32(out, static_cast<unsigned long>(cell.getCi()));
+        put16(out, static_cast<unsigned long>(scanned.getRssi()));
+        put16(out, static_cast<unsigned long>(scanned.getTimingAdvance()));
+        put32(out, age(now, scanned.getTimestamp()));
+    }
+
+    const size_t nfixes = count16(scan.gps);
+    put16(out, nfixes);
+    for (size_t i = 0; i < nfixes; ++i)
+    {
+        const GPSData::Fix& fix = scan.gps[i];
+
+        put8(out, fix.quality);
+        put8(out, fix.svInFix);
+        put32(out, static_cast<unsigned long>(fixed(fix.latitude, 1e7)));
+        put32(out, static_cast<unsigned long>(fixed(fix.longitude, 1e7)));
+        put32(out, age(now, fix.localTime));
+
+        const unsigned long fields = (fix.hasHpe() ? GPS_HPE : 0)
+                                   | (fix.hasAltitude() ? GPS_ALTITUDE : 0)
+                                   | (fix.hasHeight() ? GPS_HEIGHT : 0)
+                                   | (fix.hasSpeed() ? GPS_SPEED : 0)
+                                   | (fix.hasBearing() ? GPS_BEARING : 0);
+        put8(out, fields);
+
+        if (fix.hasHpe())
+            put16(out, std::min(static_cast<unsigned long>(fix.hpe), 0xffffUL));
+        if (fix.hasAltitude())
+            put32(out, static_cast<unsigned long>(fixed(fix.altitude, 100)));
+        if (fix.hasHeight())
+            put32(out, static_cast<unsigned long>(fixed(fix.height, 100)));
+        if (fix.hasSpeed())
+            put16(out, std::min(static_cast<unsigned long>(fixed(fix.speed, 100)),
+                                0xffffUL));
+        if (fix.hasBearing())
+            put16(out, static_cast<unsigned long>(
+                           fixed(fmod(fix.bearing + 360., 360.), 100)) % 36000);
+    }
+}
+
+bool
+BinaryCodec::parseLocationRS(const std::string& rs,
+                             std::vector<LiteLocation>& locations) const
+{
+    if (rs.size() < sizeof(MAGIC)
+            || rs.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+
+    Reader reader(rs.data() + sizeof(MAGIC), rs.size() - sizeof(MAGIC));
+
+    if (reader.get8() != STATUS_LOCATED)
+        return false;
+
+    const unsigned long count = reader.get8();
+    for (unsigned long i = 0; i < count && reader.ok(); ++i)
+    {
+        LiteLocation location;
+
+        location.latitude = reader.getSigned32() / 1e7;
+        location.longitude = reader.getSigned32() / 1e7;
+        location.hpe = reader.get16();
+        location.nap = static_cast<unsigned short>(reader.get16());
+        location.ncell = static_cast<unsigned short>(reader.get16());
+        location.nsat = static_cast<unsigned short>(reader.get16());
+        location.nlac = static_cast<unsigned short>(reader.get16());
+        location.time.reset(reader.get32());
+
+        if (reader.ok())
+            locations.push_back(location);
+    }
+
+    return reader.ok() && ! locations.empty();
+}
+
+}
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_BINARYCODEC_H_
+#define WPS_API_BINARYCODEC_H_
+
+#include "Codec.h"
+
+namespace WPS {
+namespace API {
+
+/**
+ * A compact binary encoding of location requests and responses,
+ * for proxies and servers of one's own rather than Skyhook's.
+ * \n
+ * Integers are big-endian, \c sN signed. Strings are a length
+ * followed by as many bytes, not null-terminated. Ages are in
+ * milliseconds, coordinates in 1e-7 degrees.
+ *
+ * A request (<tt>Content-Type: application/x-shlc-binary</tt>):
+ * \code
+ * "SHB" u8 version (1)
+ * u16 key length, key
+ * u16 username length, username
+ * u16 access point count
+ *     u8[6] mac, s8 rssi, u32 age, u8 ssid length, ssid
+ * u16 cell tower count
+ *     u8 type (1 GSM, 2 UMTS, 3 LTE), u16 mcc, u16 mnc,
+ *     u32 lac (or tac), u32 ci (or eucid), s16 rssi,
+ *     u16 timing advance, u32 age
+ * u16 gps fix count
+ *     u8 quality, u8 satellites, s32 latitude, s32 longitude,
+ *     u32 age, u8 fields, followed by those present:
+ *     u16 hpe (m, 0x01), s32 altitude (cm, 0x02), s32 height (cm, 0x04),
+ *     u16 speed (cm/s, 0x08), u16 bearing (1/100 degree, 0x10)
+ * \endcode
+ *
+ * A response:
+ * \code
+ * "SHB" u8 version (1)
+ * u8 status (0 located, 1 location cannot be determined)
+ * u8 location count
+ *     s32 latitude, s32 longitude, u16 hpe (m),
+ *     u16 nap, u16 ncell, u16 nsat, u16 nlac, u32 age
+ * \endcode
+ */
+class BinaryCodec
+    : public Codec
+{
+public:
+
+    BinaryCodec()
+    {}
+
+    const char* getContentType() const;
+
+    void authentication(const char* key,
+                        const char* username,
+                        std::string& out) const;
+
+    void locationRQ(const std::string& authentication,
+                    const Scan& scan,
+                    std::string& out) const;
+
+    bool parseLocationRS(const std::string& rs,
+                         std::vector<LiteLocation>& locations) const;
+};
+
+}
+}
+
+#endif
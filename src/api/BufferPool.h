@@ -0,0 +1,137 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_BUFFERPOOL_H_
+#define WPS_API_BUFFERPOOL_H_
+
+#include "spi/Concurrent.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace WPS {
+namespace API {
+
+/**
+ * Serialization buffers kept between calls, so that requests
+ * are written into memory already grown to their size.
+ */
+class BufferPool
+{
+public:
+
+    explicit BufferPool(size_t maxIdle)
+        : _mutex(SPI::Mutex::newInstance())
+        , _maxIdle(maxIdle)
+    {}
+
+    ~BufferPool()
+    {
+        for (std::vector<std::string*>::iterator it = _idle.begin();
+             it != _idle.end();
+             ++it)
+        {
+            delete *it;
+        }
+    }
+
+    /**
+     * @return an idle buffer, or a new one if there is none.
+     */
+    std::string* acquire()
+    {
+        {
+            SPI::Guard guard(_mutex.get());
+
+            if (! _idle.empty())
+            {
+                std::string* buffer = _idle.back();
+                _idle.pop_back();
+                return buffer;
+            }
+        }
+
+        return new std::string;
+    }
+
+    /**
+     * Return a buffer to the pool, which takes ownership of it.
+     */
+    void release(std::string* buffer)
+    {
+        {
+            SPI::Guard guard(_mutex.get());
+
+            if (_idle.size() < _maxIdle)
+            {
+                _idle.push_back(buffer);
+                return;
+            }
+        }
+
+        delete buffer;
+    }
+
+private:
+
+    BufferPool(const BufferPool&);
+    BufferPool& operator=(const BufferPool&);
+
+private:
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    const size_t _maxIdle;
+    std::vector<std::string*> _idle;
+};
+
+/**
+ * A buffer borrowed from a \c BufferPool for the duration of a call.
+ */
+class PooledBuffer
+{
+public:
+
+    explicit PooledBuffer(BufferPool& pool)
+        : _pool(pool)
+        , _buffer(pool.acquire())
+    {}
+
+    ~PooledBuffer()
+    {
+        _pool.release(_buffer);
+    }
+
+    std::string& operator*() const
+    {
+        return *_buffer;
+    }
+
+private:
+
+    PooledBuffer(const PooledBuffer&);
+    PooledBuffer& operator=(const PooledBuffer&);
+
+private:
+
+    BufferPool& _pool;
+    std::string* const _buffer;
+};
+
+}
+}
+
+#endif
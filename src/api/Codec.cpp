@@ -0,0 +1,98 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Codec.h"
+#include "BinaryCodec.h"
+#include "LocationRSDecoder.h"
+#include "Protocol.h"
+
+#include "spi/DOM.h"
+#include "spi/XmlParser.h"
+
+#include <memory>
+
+namespace WPS {
+namespace API {
+
+using namespace WPS::SPI;
+
+/**
+ * \c Protocol, parsing responses as they're downloaded,
+ * or into a DOM once received.
+ */
+class XmlCodec
+    : public Codec
+{
+public:
+
+    XmlCodec()
+    {}
+
+    const char* getContentType() const
+    {
+        return "text/xml";
+    }
+
+    void authentication(const char* key,
+                        const char* username,
+                        std::string& out) const
+    {
+        Protocol::authentication(key, username, out);
+    }
+
+    void locationRQ(const std::string& authentication,
+                    const Scan& scan,
+                    std::string& out) const
+    {
+        Protocol::locationRQ(authentication, scan, out);
+    }
+
+    bool parseLocationRS(const std::string& rs,
+                         std::vector<LiteLocation>& locations) const
+    {
+        std::auto_ptr<XmlParser> parser(XmlParser::newInstance());
+        std::auto_ptr<DOMDocument> doc(parser->parse(rs.data(), rs.size()));
+        if (! doc.get())
+            return false;
+
+        return Protocol::parseLocationRS(doc.get(), 0, locations);
+    }
+
+    ResponseDecoder* newResponseDecoder() const
+    {
+        return new LocationRSDecoder;
+    }
+};
+
+// Constructed before any handle can be
+static const XmlCodec xmlCodec;
+static const BinaryCodec binaryCodec;
+
+/*static*/ const Codec&
+Codec::getInstance(Type type)
+{
+    switch (type)
+    {
+        case BINARY:
+            return binaryCodec;
+        case XML:
+        default:
+            return xmlCodec;
+    }
+}
+
+}
+}
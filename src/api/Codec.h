@@ -0,0 +1,119 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_CODEC_H_
+#define WPS_API_CODEC_H_
+
+#include "Wrappers.h"
+
+#include "spi/XmlHttpRequest.h"
+
+#include <string>
+#include <vector>
+
+namespace WPS {
+namespace API {
+
+/**
+ * Decodes a response while it's downloaded, as the handler of the request.
+ * \n
+ * Decoders are reused, \c begin() starts a new response.
+ */
+class ResponseDecoder
+    : public SPI::XmlHttpRequest::ResponseHandler
+{
+public:
+
+    /**
+     * @return \c false if the response received isn't complete,
+     *         or doesn't include any location.
+     */
+    virtual bool getLocations(std::vector<LiteLocation>& locations) =0;
+};
+
+/**
+ * Encodes location requests and decodes the server's responses.
+ * \n
+ * Codecs are stateless, a single instance of each is shared
+ * by all handles and threads.
+ */
+class Codec
+{
+public:
+
+    enum Type
+    {
+        /**
+         * The XML protocol of Skyhook's servers, see \c Protocol.
+         */
+        XML,
+
+        /**
+         * A compact binary encoding, see \c BinaryCodec.h.
+         */
+        BINARY
+    };
+
+    /**
+     * @return the codec of type \c type.
+     */
+    static const Codec& getInstance(Type type);
+
+    virtual ~Codec()
+    {}
+
+    /**
+     * @return the value of the \c Content-Type header of requests.
+     */
+    virtual const char* getContentType() const =0;
+
+    /**
+     * Serialize the credentials of a request,
+     * so that they can be reused across requests.
+     */
+    virtual void authentication(const char* key,
+                                const char* username,
+                                std::string& out) const =0;
+
+    /**
+     * @param authentication as serialized by \c authentication()
+     */
+    virtual void locationRQ(const std::string& authentication,
+                            const Scan& scan,
+                            std::string& out) const =0;
+
+    /**
+     * @return \c false if \c rs isn't a response,
+     *         or doesn't include any location.
+     */
+    virtual bool parseLocationRS(const std::string& rs,
+                                 std::vector<LiteLocation>& locations) const =0;
+
+    /**
+     * @return a new decoder of responses, owned by the caller,
+     *         or \c NULL if they can only be parsed once received,
+     *         by \c parseLocationRS().
+     */
+    virtual ResponseDecoder* newResponseDecoder() const
+    {
+        return NULL;
+    }
+};
+
+}
+}
+
+#endif
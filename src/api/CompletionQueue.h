@@ -0,0 +1,115 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_COMPLETIONQUEUE_H_
+#define WPS_API_COMPLETIONQUEUE_H_
+
+#include "api/skyhookliteclient.h"
+
+#include "Wrappers.h"
+
+#include "spi/Concurrent.h"
+
+#include <memory>
+#include <deque>
+
+namespace WPS {
+namespace API {
+
+/**
+ * Results of queued location requests waiting to be picked up
+ * by \c SHLC_next_completion().
+ */
+class CompletionQueue
+{
+public:
+
+    struct Completion
+    {
+        void* userData;
+        SHLC_ReturnCode rc;
+        LiteLocation location;
+
+        Completion()
+            : userData(NULL)
+            , rc(SHLC_ERROR)
+        {}
+    };
+
+public:
+
+    CompletionQueue()
+        : _mutex(SPI::Mutex::newInstance())
+        , _event(SPI::Event::newInstance())
+    {}
+
+    void push(const Completion& completion)
+    {
+        SPI::Guard guard(_mutex.get());
+        _completions.push_back(completion);
+        _event->signal();
+    }
+
+    /**
+     * Wait up to \c timeout milliseconds for a completion.
+     *
+     * @return \c true if \c completion was set.
+     */
+    bool pop(unsigned long timeout, Completion& completion)
+    {
+        SPI::Timer timer;
+
+        for (;;)
+        {
+            {
+                SPI::Guard guard(_mutex.get());
+
+                if (! _completions.empty())
+                {
+                    completion = _completions.front();
+                    _completions.pop_front();
+                    return true;
+                }
+
+                // Cleared under the lock so a concurrent push() can't be missed
+                _event->clear();
+            }
+
+            const unsigned long elapsed = timer.elapsed();
+            if (elapsed >= timeout)
+                return false;
+
+            // Another consumer may take the completion first, hence the loop
+            _event->wait(timeout - elapsed);
+        }
+    }
+
+private:
+
+    CompletionQueue(const CompletionQueue&);
+    CompletionQueue& operator=(const CompletionQueue&);
+
+private:
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    std::auto_ptr<SPI::Event> _event;   // signaled when completions are queued
+    std::deque<Completion> _completions;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,1176 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Context.h"
+
+#include "spi/XmlHttpRequest.h"
+#include "spi/Logger.h"
+#include "spi/SystemInformation.h"
+
+#include "version.h"
+
+#include <md4.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace WPS {
+namespace API {
+
+using namespace WPS::SPI;
+
+static const unsigned TIMEOUT = 20 * 1000;
+
+/**
+ * Maximum number of asynchronous requests processed concurrently.
+ * \n
+ * Scans are serialized on the adapter anyway, so this mostly bounds
+ * the number of outstanding HTTP requests.
+ */
+static const size_t MAX_WORKERS = 4;
+
+/**
+ * Maximum number of requests kept ready between calls.
+ */
+static const size_t MAX_IDLE_REQUESTS = 4;
+
+/**
+ * Maximum number of request buffers kept between calls.
+ */
+static const size_t MAX_IDLE_BUFFERS = 4;
+
+/**
+ * Maximum number of serialized authentication elements kept.
+ */
+static const size_t MAX_AUTHENTICATIONS = 64;
+
+/**
+ * Share of the deadline of a request, in percent, that the scan may use.
+ * \n
+ * The server request gets the rest, including whatever the scan
+ * didn't use.
+ */
+static const unsigned long SCAN_BUDGET_PERCENT = 60;
+
+/**
+ * Age beyond which the access points of a previous scan are not sent
+ * when a new scan doesn't complete before the deadline of a request.
+ */
+static const unsigned long MAX_STALE_SCAN_AGE = 60 * 1000;
+
+static const char* DEFAULT_SERVER_URL = "https://api.skyhookwireless.com/wps2/location";
+
+/**
+ * Minimum interval between attempts to reopen
+ * a cell or GPS adapter that failed to open.
+ */
+static const unsigned long REOPEN_INTERVAL = 60 * 1000;
+
+static std::string
+md4(const std::string& input)
+{
+    unsigned char digest[16];
+
+    WPS_MD4_CTX ctx;
+    WPS_MD4Init(&ctx);
+    WPS_MD4Update(&ctx, (unsigned char*) input.c_str(), (unsigned int) input.length());
+    WPS_MD4Final(digest, &ctx);
+
+    char buf[64];
+    WPS::SPI::snprintf(buf,
+                       sizeof(buf),
+                       "%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x",
+                       digest[0],
+                       digest[1],
+                       digest[2],
+                       digest[3],
+                       digest[4],
+                       digest[5],
+                       digest[6],
+                       digest[7],
+                       digest[8],
+                       digest[9],
+                       digest[10],
+                       digest[11],
+                       digest[12],
+                       digest[13],
+                       digest[14],
+                       digest[15]);
+    return buf;
+}
+
+inline bool
+isNotValidForMeta(char c)
+{
+    // ASCII non-printable characters or semicolon
+    // (since it acts as a delimiter).
+    return c < 32 || c > 126 || c == ';';
+}
+
+inline bool
+isValidForMeta(const std::string& s)
+{
+    return std::find_if(s.begin(), s.end(), isNotValidForMeta) == s.end();
+}
+
+inline std::string
+validateForMeta(const std::string& s)
+{
+    return isValidForMeta(s) ? s : "";
+}
+
+static std::string
+getMetaString()
+{
+    std::string meta;
+    meta.reserve(64);
+
+    SystemInformation::OSInfo osInfo;
+    SystemInformation::DeviceInfo deviceInfo;
+
+    std::auto_ptr<SystemInformation> sysInfo(SystemInformation::newInstance());
+    if (sysInfo.get())
+    {
+        sysInfo->getOSInfo(osInfo);
+        sysInfo->getDeviceInfo(deviceInfo);
+    }
+
+    meta.append("1;shlc;")
+        .append(SHLC_VERSION)
+        .append(";")
+        .append(validateForMeta(osInfo.type))
+        .append(";")
+        .append(validateForMeta(osInfo.version))
+        .append(";")
+        .append(validateForMeta(deviceInfo.manufacturer))
+        .append(";")
+        .append(validateForMeta(deviceInfo.model));
+
+    return meta;
+}
+
+/**
+ * @return the time left out of \c budget milliseconds since \c started.
+ */
+static unsigned long
+remaining(const Timer& started, unsigned long budget)
+{
+    const unsigned long elapsed = started.elapsed();
+    return elapsed < budget ? budget - elapsed : 0;
+}
+
+static XmlHttpRequest*
+newLocationRequest(const std::string& url, const std::string& meta)
+{
+    XmlHttpRequest* xhr = XmlHttpRequest::newInstance();
+
+    xhr->open(XmlHttpRequest::HTTP_POST, url);
+    xhr->setRequestHeader("Skyhook-Meta", meta);
+
+    return xhr;
+}
+
+/**
+ * Decodes the response of a request while it's downloaded,
+ * if the codec and the request support it.
+ */
+class StreamedResponse
+{
+public:
+
+    StreamedResponse(PooledRequest& xhr, const Codec& codec)
+        : _xhr(xhr)
+        , _decoder(codec.newResponseDecoder())
+    {
+        if (_decoder.get() != NULL && ! _xhr->setResponseHandler(_decoder.get()))
+            _decoder.reset();
+    }
+
+    ~StreamedResponse()
+    {
+        // Unless the hedger discarded the request
+        if (_decoder.get() != NULL && _xhr.get() != NULL)
+            _xhr->setResponseHandler(NULL);
+    }
+
+    /**
+     * @return \c NULL if the response is kept by the request instead.
+     */
+    ResponseDecoder* getDecoder() const
+    {
+        return _decoder.get();
+    }
+
+private:
+
+    StreamedResponse(const StreamedResponse&);
+    StreamedResponse& operator=(const StreamedResponse&);
+
+private:
+
+    PooledRequest& _xhr;
+    std::auto_ptr<ResponseDecoder> _decoder;
+};
+
+/**
+ * @param decoder decoded the response while it was downloaded,
+ *                \c NULL if it's parsed from the request's data.
+ */
+static SHLC_ReturnCode
+parseLocation(const XmlHttpRequest* xhr,
+              const Codec& codec,
+              ResponseDecoder* decoder,
+              LiteLocation& location)
+{
+    switch (xhr->getStatusCode())
+    {
+        case XmlHttpRequest::OK:
+            break;
+        case XmlHttpRequest::UNAUTHORIZED:
+            return SHLC_ERROR_UNAUTHORIZED;
+        default:
+            return SHLC_ERROR_SERVER_UNAVAILABLE;
+    }
+
+    std::vector<LiteLocation> locations;
+    if (decoder != NULL)
+    {
+        if (! decoder->getLocations(locations))
+            return SHLC_ERROR_LOCATION_CANNOT_BE_DETERMINED;
+    }
+    else if (! codec.parseLocationRS(xhr->getResponseData(), locations))
+        return SHLC_ERROR_LOCATION_CANNOT_BE_DETERMINED;
+
+    if (locations.empty())
+        return SHLC_ERROR_LOCATION_CANNOT_BE_DETERMINED;
+
+    location = locations.front();
+    return SHLC_OK;
+}
+
+/**********************************************************************/
+/*                                                                    */
+/* LocationTask                                                       */
+/*                                                                    */
+/**********************************************************************/
+
+/**
+ * An asynchronous location request.
+ */
+class LocationTask
+    : public WorkQueue::Task
+{
+public:
+
+    LocationTask(Context& context, const char* key)
+        : _context(context)
+        , _key(key) // copied since the caller's string may not outlive the request
+    {}
+
+    void run()
+    {
+        LiteLocation location;
+        const SHLC_ReturnCode rc = _context.location(_key.c_str(), location);
+        complete(rc, location);
+    }
+
+    void cancel()
+    {
+        complete(SHLC_ERROR, LiteLocation());
+    }
+
+protected:
+
+    virtual void complete(SHLC_ReturnCode rc, const LiteLocation& location) =0;
+
+private:
+
+    Context& _context;
+    const std::string _key;
+};
+
+class CallbackLocationTask
+    : public LocationTask
+{
+public:
+
+    CallbackLocationTask(Context& context,
+                         const char* key,
+                         SHLC_LocationCallback callback,
+                         void* userData)
+        : LocationTask(context, key)
+        , _callback(callback)
+        , _userData(userData)
+    {}
+
+private:
+
+    void complete(SHLC_ReturnCode rc, const LiteLocation& location)
+    {
+        _callback(rc, rc == SHLC_OK ? (SHLC_Location*) location : NULL, _userData);
+    }
+
+private:
+
+    SHLC_LocationCallback _callback;
+    void* _userData;
+};
+
+class QueuedLocationTask
+    : public LocationTask
+{
+public:
+
+    QueuedLocationTask(Context& context,
+                       const char* key,
+                       CompletionQueue& completions,
+                       void* userData)
+        : LocationTask(context, key)
+        , _completions(completions)
+        , _userData(userData)
+    {}
+
+private:
+
+    void complete(SHLC_ReturnCode rc, const LiteLocation& location)
+    {
+        CompletionQueue::Completion completion;
+        completion.userData = _userData;
+        completion.rc = rc;
+        completion.location = location;
+        _completions.push(completion);
+    }
+
+private:
+
+    CompletionQueue& _completions;
+    void* _userData;
+};
+
+/**********************************************************************/
+/*                                                                    */
+/* Batch                                                              */
+/*                                                                    */
+/**********************************************************************/
+
+/**
+ * Scans of a \c SHLC_location_batch() call,
+ * processed by the caller and by helper tasks.
+ * \n
+ * Reference counted since helpers may start only after
+ * the caller has returned. The caller's arrays are only
+ * written to while it waits, see \c abandon().
+ */
+class Batch
+{
+public:
+
+    Batch(Context& context,
+          const char* key,
+          const SHLC_Scan* scans,
+          size_t count,
+          SHLC_ReturnCode* rcs,
+          SHLC_Location** locations)
+        : _context(context)
+        , _key(key)
+        , _scans(scans)
+        , _count(count)
+        , _rcs(rcs)
+        , _locations(locations)
+        , _mutex(Mutex::newInstance())
+        , _done(Event::newInstance())
+        , _next(0)
+        , _completed(0)
+        , _refs(1)
+        , _abandoned(false)
+    {
+        // Until processed
+        for (size_t i = 0; i < _count; ++i)
+        {
+            _rcs[i] = SHLC_ERROR;
+            _locations[i] = NULL;
+        }
+
+        if (_count == 0)
+            _done->signal();
+    }
+
+    void addRef()
+    {
+        Guard guard(_mutex.get());
+        ++_refs;
+    }
+
+    void release()
+    {
+        bool last;
+        {
+            Guard guard(_mutex.get());
+            last = --_refs == 0;
+        }
+
+        if (last)
+            delete this;
+    }
+
+    /**
+     * Process scans until none are left.
+     */
+    void process()
+    {
+        size_t i;
+        Scan scan;
+        std::string username;
+        bool hasUsername;
+        while (claim(i, scan, username, hasUsername))
+        {
+            LiteLocation location;
+            const SHLC_ReturnCode rc =
+                _context.locationFromScan(_key.c_str(),
+                                          scan,
+                                          hasUsername ? username.c_str() : NULL,
+                                          location);
+
+            complete(i, rc, rc == SHLC_OK ? (SHLC_Location*) location : NULL);
+        }
+    }
+
+    /**
+     * Wait until all scans were processed.
+     *
+     * @return \c false if waiting failed, in which case the batch
+     *         is abandoned and scans not processed yet keep \c SHLC_ERROR.
+     */
+    bool wait()
+    {
+        int rc;
+        while ((rc = _done->wait(TIMEOUT)) > 0)
+            ;
+
+        if (rc < 0)
+        {
+            abandon();
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+
+    /**
+     * Copies the next scan, the caller's may be gone once abandoned.
+     */
+    bool claim(size_t& i, Scan& scan, std::string& username, bool& hasUsername)
+    {
+        Guard guard(_mutex.get());
+        if (_next == _count)
+            return false;
+        i = _next++;
+
+        scan = Scan(_scans[i]);
+        hasUsername = _scans[i].username != NULL;
+        username = hasUsername ? _scans[i].username : "";
+        return true;
+    }
+
+    void complete(size_t i, SHLC_ReturnCode rc, SHLC_Location* location)
+    {
+        Guard guard(_mutex.get());
+
+        // The caller has returned, the result has nowhere to go
+        if (_abandoned)
+        {
+            LiteLocation::free_location(location);
+            return;
+        }
+
+        _rcs[i] = rc;
+        _locations[i] = location;
+
+        if (++_completed == _count)
+            _done->signal();
+    }
+
+    /**
+     * Stops helpers from claiming scans or writing results,
+     * so that the caller can return without all of them.
+     */
+    void abandon()
+    {
+        Guard guard(_mutex.get());
+        _abandoned = true;
+        _next = _count;
+    }
+
+private:
+
+    Context& _context;
+    const std::string _key;
+    const SHLC_Scan* _scans;
+    const size_t _count;
+    SHLC_ReturnCode* _rcs;
+    SHLC_Location** _locations;
+
+    std::auto_ptr<Mutex> _mutex;
+    std::auto_ptr<Event> _done;
+    size_t _next;
+    size_t _completed;
+    size_t _refs;
+    bool _abandoned;
+};
+
+class BatchTask
+    : public WorkQueue::Task
+{
+public:
+
+    explicit BatchTask(Batch* batch)
+        : _batch(batch)
+    {
+        _batch->addRef();
+    }
+
+    ~BatchTask()
+    {
+        _batch->release();
+    }
+
+    void run()
+    {
+        _batch->process();
+    }
+
+private:
+
+    Batch* _batch;
+};
+
+/**********************************************************************/
+/*                                                                    */
+/* Context                                                            */
+/*                                                                    */
+/**********************************************************************/
+
+Context::Context()
+    : _mutex(Mutex::newInstance())
+    , _openAttempted(false)
+    , _metaInitialized(false)
+    , _serverUrl(DEFAULT_SERVER_URL)
+    , _encoding(XmlHttpRequest::ENCODING_IDENTITY)
+    , _codec(&Codec::getInstance(Codec::XML))
+    , _requests(MAX_IDLE_REQUESTS)
+    , _buffers(MAX_IDLE_BUFFERS)
+    , _cellOpener(_cell)
+    , _gpsOpener(_gps)
+    , _trackerMutex(Mutex::newInstance())
+    , _workQueue(MAX_WORKERS)
+{}
+
+Context::~Context()
+{
+    stopTracking();
+
+    // Outstanding requests need the adapters
+    _workQueue.shutdown();
+
+    _cellOpener.join();
+    _gpsOpener.join();
+
+    _wifi.close();
+    _cell.close();
+    _gps.close();
+}
+
+SHLC_ReturnCode
+Context::open()
+{
+    {
+        Guard guard(_mutex.get());
+
+        if ((! _gps.isOpen() || ! _cell.isOpen())
+                && (! _openAttempted || _lastOpenAttempt.elapsed() >= REOPEN_INTERVAL))
+        {
+            _openAttempted = true;
+            _lastOpenAttempt.reset();
+
+            // Neither is needed to start the Wi-Fi scan, so don't wait
+            // for the serial port or D-Bus setup
+            if (! _gps.isOpen())
+                _gpsOpener.start();
+            if (! _cell.isOpen())
+                _cellOpener.start();
+        }
+    }
+
+    if (_wifi.open() != SPI_OK)
+        return SHLC_ERROR_RADIO_NOT_AVAILABLE;
+
+    return SHLC_OK;
+}
+
+class Context::LocateCall
+{
+public:
+
+    LocateCall(Context& context, const char* key)
+        : _context(context)
+        , _key(key)
+    {}
+
+    LocationResult operator()()
+    {
+        LocationResult result;
+        result.rc = _context.locate(_key, 0, result.location);
+        return result;
+    }
+
+private:
+
+    Context& _context;
+    const char* _key;
+};
+
+SHLC_ReturnCode
+Context::location(const char* key, LiteLocation& location)
+{
+    LocateCall call(*this, key);
+    const LocationResult result = _flights.call(key, call);
+
+    if (result.rc == SHLC_OK)
+        location = result.location;
+
+    return result.rc;
+}
+
+SHLC_ReturnCode
+Context::locationWithDeadline(const char* key,
+                              unsigned long deadline,
+                              LiteLocation& location)
+{
+    // Not coalesced with location() since the leading caller
+    // may have a later deadline, or none
+    return locate(key, deadline, location);
+}
+
+SHLC_ReturnCode
+Context::locate(const char* key, unsigned long deadline, LiteLocation& location)
+{
+    const Timer started;
+
+    // Divided first, so that long deadlines don't overflow
+    const unsigned long scanBudget =
+        deadline > 0 ? deadline / 100 * SCAN_BUDGET_PERCENT
+                       + deadline % 100 * SCAN_BUDGET_PERCENT / 100
+                     : TIMEOUT;
+
+    const SHLC_ReturnCode rc = open();
+    if (rc != SHLC_OK)
+        return rc;
+
+    const std::string username = getDeviceUsername(remaining(started, scanBudget));
+    if (username.empty())
+        return SHLC_ERROR_UNAUTHORIZED;
+
+    Scan scan;
+    unsigned long scanId;
+    if (_wifi.scan(remaining(started, scanBudget), scan.aps, scanId) != SPI_OK)
+    {
+        if (deadline == 0)
+            return SHLC_ERROR_RADIO_NOT_AVAILABLE;
+
+        // Out of time, make do with what was seen before
+        _wifi.getLastScan(MAX_STALE_SCAN_AGE, scan.aps, scanId);
+    }
+
+    /*
+     * Wi-Fi scan completed
+     */
+    // The adapters have had the whole scan to open
+    _gpsOpener.wait(remaining(started, scanBudget));
+    _cellOpener.wait(remaining(started, scanBudget));
+
+    _gps.getFixes(scan.gps);
+    _cell.getScannedCells(scan.cells);
+
+    // Fill in what this scan missed with what the previous ones saw
+    _aggregator.aggregate(scan, scanId);
+
+    unsigned long timeout = 0;
+    if (deadline > 0)
+    {
+        timeout = remaining(started, deadline);
+        if (timeout == 0)
+            return SHLC_ERROR_TIMEOUT;
+    }
+
+    PooledRequest xhr(_requests, acquireRequest());
+    return resolve(key, username, scan, location, &xhr, timeout);
+}
+
+SHLC_ReturnCode
+Context::locationFromScan(const char* key,
+                          const Scan& scan,
+                          const char* username,
+                          LiteLocation& location)
+{
+    // Doesn't open() the adapters, the device may not have any
+    const std::string user =
+        username != NULL ? username : getDeviceUsername(TIMEOUT);
+    if (user.empty())
+        return SHLC_ERROR_UNAUTHORIZED;
+
+    return resolve(key, user, scan, location, NULL, 0);
+}
+
+std::string
+Context::getDeviceUsername(unsigned long timeout)
+{
+    {
+        Guard guard(_mutex.get());
+        if (! _username.empty())
+            return _username;
+    }
+
+    // Computed outside of the lock since it may wait for the cell adapter
+    std::string username;
+
+    const std::string mac = _wifi.getHardwareMAC();
+    if (! mac.empty())
+        username = md4(mac);
+    else
+    {
+        // Only wait for the cell adapter when there's no Wi-Fi MAC
+        _cellOpener.wait(timeout);
+
+        const std::string imei = _cell.getIMEI();
+        if (! imei.empty())
+            username = md4(imei);
+    }
+
+    // Not cached if it couldn't be determined, the adapters
+    // may be available on the next call
+    if (! username.empty())
+    {
+        Guard guard(_mutex.get());
+        _username = username;
+    }
+
+    return username;
+}
+
+std::string
+Context::getMeta()
+{
+    Guard guard(_mutex.get());
+
+    if (! _metaInitialized)
+    {
+        _meta = getMetaString();
+        _metaInitialized = true;
+    }
+
+    return _meta;
+}
+
+const Codec&
+Context::getCodec()
+{
+    Guard guard(_mutex.get());
+    return *_codec;
+}
+
+void
+Context::getAuthentication(const Codec& codec,
+                           const char* key,
+                           const std::string& username,
+                           std::string& authentication)
+{
+    // Each codec serializes it differently
+    const std::string id = std::string(codec.getContentType()) + '\n'
+                         + key + '\n'
+                         + username;
+
+    Guard guard(_mutex.get());
+
+    Authentications::const_iterator it = _authentications.find(id);
+    if (it != _authentications.end())
+    {
+        authentication = it->second;
+        return;
+    }
+
+    codec.authentication(key, username.c_str(), authentication);
+
+    if (_authentications.size() >= MAX_AUTHENTICATIONS)
+        _authentications.clear();
+    _authentications[id] = authentication;
+}
+
+void
+Context::setServerUrl(const char* url)
+{
+    Guard guard(_mutex.get());
+    _serverUrl = url;
+}
+
+void
+Context::setCompressionDictionary(const std::string& dictionary)
+{
+    Guard guard(_mutex.get());
+    _dictionary = dictionary;
+}
+
+SHLC_ReturnCode
+Context::setEncoding(unsigned long value)
+{
+    XmlHttpRequest::ContentEncoding encoding;
+    switch (value)
+    {
+        case SHLC_ENCODING_IDENTITY:
+            encoding = XmlHttpRequest::ENCODING_IDENTITY;
+            break;
+        case SHLC_ENCODING_GZIP:
+            encoding = XmlHttpRequest::ENCODING_GZIP;
+            break;
+        case SHLC_ENCODING_DEFLATE:
+            encoding = XmlHttpRequest::ENCODING_DEFLATE;
+            break;
+        case SHLC_ENCODING_ZSTD:
+            encoding = XmlHttpRequest::ENCODING_ZSTD;
+            break;
+        default:
+            return SHLC_ERROR;
+    }
+
+    // Depends on how the library was built
+    std::auto_ptr<XmlHttpRequest> probe(XmlHttpRequest::newInstance());
+    if (! probe->setContentEncoding(encoding))
+        return SHLC_ERROR;
+
+    Guard guard(_mutex.get());
+    _encoding = encoding;
+    return SHLC_OK;
+}
+
+SHLC_ReturnCode
+Context::setCodec(unsigned long value)
+{
+    Codec::Type type;
+    switch (value)
+    {
+        case SHLC_CODEC_XML:
+            type = Codec::XML;
+            break;
+        case SHLC_CODEC_BINARY:
+            type = Codec::BINARY;
+            break;
+        default:
+            return SHLC_ERROR;
+    }
+
+    Guard guard(_mutex.get());
+    _codec = &Codec::getInstance(type);
+    return SHLC_OK;
+}
+
+XmlHttpRequest*
+Context::acquireRequest()
+{
+    std::string url;
+    {
+        Guard guard(_mutex.get());
+        url = _serverUrl;
+    }
+
+    XmlHttpRequest* xhr = _requests.acquire();
+    if (xhr == NULL)
+        xhr = newLocationRequest(url, getMeta());
+    else
+        // In case the url changed since the request was pooled
+        xhr->open(XmlHttpRequest::HTTP_POST, url);
+
+    // Likewise for the encoding, set under the lock
+    // so that the dictionary isn't copied
+    Guard guard(_mutex.get());
+    xhr->setContentEncoding(_encoding, _dictionary);
+    return xhr;
+}
+
+/**
+ * The duplicate of a location request, only taken from the pool
+ * and prepared if the hedger sends it.
+ */
+class Context::HedgeRequest
+    : public Hedger::Duplicate
+{
+public:
+
+    HedgeRequest(Context& context, const Codec& codec)
+        : _context(context)
+        , _codec(codec)
+    {}
+
+    PooledRequest* prepare()
+    {
+        _xhr.reset(new PooledRequest(_context._requests,
+                                     _context.acquireRequest()));
+        (*_xhr)->setRequestHeader("Content-Type", _codec.getContentType());
+        _response.reset(new StreamedResponse(*_xhr, _codec));
+        return _xhr.get();
+    }
+
+    /**
+     * @return \c NULL if the response is kept by the request instead.
+     */
+    ResponseDecoder* getDecoder() const
+    {
+        return _response->getDecoder();
+    }
+
+private:
+
+    Context& _context;
+    const Codec& _codec;
+
+    // Detached from its decoder before being pooled
+    std::auto_ptr<PooledRequest> _xhr;
+    std::auto_ptr<StreamedResponse> _response;
+};
+
+SHLC_ReturnCode
+Context::getLocation(PooledRequest& xhr,
+                     const Codec& codec,
+                     const std::string& authentication,
+                     const Scan& scan,
+                     unsigned long timeout,
+                     LiteLocation& location)
+{
+    // Grown by earlier requests, so serializing doesn't allocate
+    PooledBuffer buffer(_buffers);
+    std::string& rq = *buffer;
+
+    Scan selected;
+    if (_apSelector.select(scan.aps, selected.aps))
+    {
+        selected.cells = scan.cells;
+        selected.gps = scan.gps;
+        codec.locationRQ(authentication, selected, rq);
+    }
+    else
+        codec.locationRQ(authentication, scan, rq);
+
+    HedgeRequest hedge(*this, codec);
+
+    // Pooled requests keep it, in which case this does nothing
+    xhr->setRequestHeader("Content-Type", codec.getContentType());
+    StreamedResponse response(xhr, codec);
+
+    PooledRequest* answered;
+    const ErrorCode code = _hedger.send(xhr, &hedge, rq, timeout, answered);
+    if (code == SPI_ERROR_TIMED_OUT && timeout > 0)
+        return SHLC_ERROR_TIMEOUT;
+    if (code != SPI_OK)
+        return SHLC_ERROR_SERVER_UNAVAILABLE;
+
+    ResponseDecoder* decoder = answered == &xhr
+        ? response.getDecoder()
+        : hedge.getDecoder();
+
+    return parseLocation(answered->get(), codec, decoder, location);
+}
+
+SHLC_ReturnCode
+Context::resolve(const char* key,
+                 const std::string& username,
+                 const Scan& scan,
+                 LiteLocation& location,
+                 PooledRequest* xhr,
+                 unsigned long timeout)
+{
+    if (scan.aps.empty() && scan.cells.empty() && scan.gps.empty())
+        return SHLC_ERROR_NO_BEACONS_IN_RANGE;
+
+    if (_cache.lookup(key, scan, location))
+        return SHLC_OK;
+
+    if (_fingerprints.lookup(key, scan, location))
+        return SHLC_OK;
+
+    /*
+     * Determine location remotely
+     */
+    const Codec& codec = getCodec();
+
+    std::string authentication;
+    getAuthentication(codec, key, username, authentication);
+
+    SHLC_ReturnCode rc;
+    if (xhr != NULL)
+        rc = getLocation(*xhr, codec, authentication, scan, timeout, location);
+    else
+    {
+        PooledRequest pooled(_requests, acquireRequest());
+        rc = getLocation(pooled, codec, authentication, scan, timeout, location);
+    }
+
+    if (rc == SHLC_OK)
+    {
+        _cache.store(key, scan, location);
+        _fingerprints.store(key, scan, location);
+    }
+
+    return rc;
+}
+
+void
+Context::locationBatch(const char* key,
+                       const SHLC_Scan* scans,
+                       unsigned int count,
+                       SHLC_ReturnCode* rcs,
+                       SHLC_Location** locations)
+{
+    Batch* batch = new Batch(*this, key, scans, count, rcs, locations);
+
+    // Helpers that start after the caller is done find nothing left to do
+    for (size_t i = 1; i < std::min<size_t>(count, MAX_WORKERS + 1); ++i)
+    {
+        std::auto_ptr<WorkQueue::Task> task(new BatchTask(batch));
+        if (_workQueue.post(task.get()))
+            task.release();
+    }
+
+    batch->process();
+    batch->wait();
+    batch->release();
+}
+
+SHLC_ReturnCode
+Context::locationAsync(const char* key,
+                       SHLC_LocationCallback callback,
+                       void* userData)
+{
+    std::auto_ptr<WorkQueue::Task> task(
+        new CallbackLocationTask(*this, key, callback, userData));
+
+    if (! _workQueue.post(task.get()))
+        return SHLC_ERROR;
+
+    task.release();
+    return SHLC_OK;
+}
+
+SHLC_ReturnCode
+Context::locationQueued(const char* key, void* userData)
+{
+    std::auto_ptr<WorkQueue::Task> task(
+        new QueuedLocationTask(*this, key, _completions, userData));
+
+    if (! _workQueue.post(task.get()))
+        return SHLC_ERROR;
+
+    task.release();
+    return SHLC_OK;
+}
+
+bool
+Context::nextCompletion(unsigned long timeout,
+                        CompletionQueue::Completion& completion)
+{
+    return _completions.pop(timeout, completion);
+}
+
+SHLC_ReturnCode
+Context::startTracking(const char* key,
+                       unsigned long period,
+                       SHLC_LocationCallback callback,
+                       void* userData)
+{
+    Guard guard(_trackerMutex.get());
+
+    _tracker.reset();
+
+    std::auto_ptr<Tracker> tracker(
+        new Tracker(*this, key, period, callback, userData));
+    if (! tracker->start())
+        return SHLC_ERROR;
+
+    _tracker = tracker;
+    return SHLC_OK;
+}
+
+void
+Context::stopTracking()
+{
+    Guard guard(_trackerMutex.get());
+    _tracker.reset();
+}
+
+SHLC_ReturnCode
+Context::setOption(SHLC_Option option, unsigned long value)
+{
+    switch (option)
+    {
+        case SHLC_OPTION_CACHE_TTL:
+            _cache.setTtl(value);
+            return SHLC_OK;
+        case SHLC_OPTION_FINGERPRINT_THRESHOLD:
+            if (value > 100)
+                return SHLC_ERROR;
+            _fingerprints.setThreshold(value);
+            return SHLC_OK;
+        case SHLC_OPTION_FINGERPRINT_TTL:
+            _fingerprints.setTtl(value);
+            return SHLC_OK;
+        case SHLC_OPTION_HEDGE_PERCENTILE:
+            if (value > 100)
+                return SHLC_ERROR;
+            _hedger.setPercentile(value);
+            return SHLC_OK;
+        case SHLC_OPTION_MAX_SCAN_AGE:
+            _wifi.setMaxScanAge(value);
+            return SHLC_OK;
+        case SHLC_OPTION_MAX_ACCESS_POINTS:
+            _apSelector.setMaxAccessPoints(value);
+            return SHLC_OK;
+        case SHLC_OPTION_AGGREGATE_SCANS:
+            _aggregator.setScans(value);
+            return SHLC_OK;
+        case SHLC_OPTION_AGGREGATE_MAX_AGE:
+            _aggregator.setMaxAge(value);
+            return SHLC_OK;
+        case SHLC_OPTION_REQUEST_ENCODING:
+            return setEncoding(value);
+        case SHLC_OPTION_CODEC:
+            return setCodec(value);
+        default:
+            return SHLC_ERROR;
+    }
+}
+
+void
+Context::getStatistics(SHLC_Statistics& statistics)
+{
+    statistics.cache_hits = _cache.getHits();
+    statistics.cache_misses = _cache.getMisses();
+    statistics.fingerprint_hits = _fingerprints.getHits();
+    statistics.hedged_requests = _hedger.getHedged();
+    statistics.hedge_wins = _hedger.getWins();
+}
+
+}
+}
@@ -0,0 +1,320 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_CONTEXT_H_
+#define WPS_API_CONTEXT_H_
+
+#include "api/skyhookliteclient.h"
+
+#include "AccessPointSelector.h"
+#include "Adapters.h"
+#include "BufferPool.h"
+#include "Codec.h"
+#include "CompletionQueue.h"
+#include "FingerprintIndex.h"
+#include "Hedger.h"
+#include "RequestPool.h"
+#include "ScanAggregator.h"
+#include "ScanCache.h"
+#include "SingleFlight.h"
+#include "Tracker.h"
+#include "WorkQueue.h"
+#include "Wrappers.h"
+
+#include "spi/Concurrent.h"
+#include "spi/Time.h"
+#include "spi/XmlHttpRequest.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace WPS {
+namespace API {
+
+/**
+ * State behind a handle returned by \c SHLC_init().
+ *
+ * Owns the radio adapters for the lifetime of the handle so that
+ * consecutive location requests don't pay for opening and closing
+ * them (and so that GPS gets a chance to acquire a fix).
+ */
+class Context
+{
+public:
+
+    Context();
+    ~Context();
+
+    /**
+     * Cast a handle returned by \c SHLC_init() back to its context.
+     */
+    static Context* fromHandle(const void* handle)
+    {
+        return const_cast<Context*>(static_cast<const Context*>(handle));
+    }
+
+    /**
+     * Open the adapters that aren't open yet.
+     *
+     * @return \c SHLC_OK if the Wi-Fi adapter is open.
+     */
+    SHLC_ReturnCode open();
+
+    /**
+     * Scan and determine location remotely.
+     * \n
+     * Concurrent calls with the same key share one scan
+     * and one server request, and get the same result.
+     */
+    SHLC_ReturnCode location(const char* key, LiteLocation& location);
+
+    /**
+     * @see SHLC_location_with_deadline()
+     */
+    SHLC_ReturnCode locationWithDeadline(const char* key,
+                                         unsigned long deadline,
+                                         LiteLocation& location);
+
+    /**
+     * Determine location remotely for a scan supplied by the caller.
+     *
+     * @param username identifies the device the scan was collected on,
+     *                 or \c NULL to use this device's identity.
+     */
+    SHLC_ReturnCode locationFromScan(const char* key,
+                                     const Scan& scan,
+                                     const char* username,
+                                     LiteLocation& location);
+
+    /**
+     * Call \c locationFromScan() for each of \c scans,
+     * on the calling thread and on the work queue in parallel.
+     * \n
+     * Scans not processed, should waiting for the helpers fail,
+     * get \c SHLC_ERROR.
+     */
+    void locationBatch(const char* key,
+                       const SHLC_Scan* scans,
+                       unsigned int count,
+                       SHLC_ReturnCode* rcs,
+                       SHLC_Location** locations);
+
+    /**
+     * Run \c location() on a library-owned thread
+     * and report the result to \c callback.
+     */
+    SHLC_ReturnCode locationAsync(const char* key,
+                                  SHLC_LocationCallback callback,
+                                  void* userData);
+
+    /**
+     * Run \c location() on a library-owned thread
+     * and queue the result for \c nextCompletion().
+     */
+    SHLC_ReturnCode locationQueued(const char* key, void* userData);
+
+    /**
+     * Wait up to \c timeout milliseconds for the result
+     * of a request made with \c locationQueued().
+     *
+     * @return \c true if \c completion was set.
+     */
+    bool nextCompletion(unsigned long timeout,
+                        CompletionQueue::Completion& completion);
+
+    /**
+     * Start reporting location to \c callback every \c period milliseconds,
+     * replacing the current tracking session if there is one.
+     */
+    SHLC_ReturnCode startTracking(const char* key,
+                                  unsigned long period,
+                                  SHLC_LocationCallback callback,
+                                  void* userData);
+
+    void stopTracking();
+
+    /**
+     * @see SHLC_set_option()
+     */
+    SHLC_ReturnCode setOption(SHLC_Option option, unsigned long value);
+
+    /**
+     * @see SHLC_get_statistics()
+     */
+    void getStatistics(SHLC_Statistics& statistics);
+
+    /**
+     * @see SHLC_set_server_url()
+     */
+    void setServerUrl(const char* url);
+
+    /**
+     * @see SHLC_set_compression_dictionary()
+     */
+    void setCompressionDictionary(const std::string& dictionary);
+
+private:
+
+    struct LocationResult
+    {
+        SHLC_ReturnCode rc;
+        LiteLocation location;
+
+        LocationResult()
+            : rc(SHLC_ERROR)
+        {}
+    };
+
+    class LocateCall;
+    class HedgeRequest;
+
+    /**
+     * Implementation of \c location() for the caller
+     * leading the flight, and of \c locationWithDeadline().
+     *
+     * @param deadline milliseconds within which to return,
+     *                 \c 0 for no deadline.
+     */
+    SHLC_ReturnCode locate(const char* key,
+                           unsigned long deadline,
+                           LiteLocation& location);
+
+    /**
+     * @param timeout milliseconds to wait for the cell adapter to open
+     *                if there's no Wi-Fi MAC address.
+     *
+     * @return the username identifying this device,
+     *         empty if it couldn't be determined.
+     */
+    std::string getDeviceUsername(unsigned long timeout);
+
+    /**
+     * @return the value of the \c Skyhook-Meta header.
+     */
+    std::string getMeta();
+
+    /**
+     * @return the codec set by \c SHLC_OPTION_CODEC.
+     */
+    const Codec& getCodec();
+
+    /**
+     * Serialize the \c authentication element of a request,
+     * reusing the one from previous requests if possible.
+     */
+    void getAuthentication(const Codec& codec,
+                           const char* key,
+                           const std::string& username,
+                           std::string& authentication);
+
+    /**
+     * Handle \c SHLC_OPTION_REQUEST_ENCODING.
+     */
+    SHLC_ReturnCode setEncoding(unsigned long value);
+
+    /**
+     * Handle \c SHLC_OPTION_CODEC.
+     */
+    SHLC_ReturnCode setCodec(unsigned long value);
+
+    /**
+     * @return a request ready to be sent, to be returned to \c _requests.
+     */
+    SPI::XmlHttpRequest* acquireRequest();
+
+    /**
+     * Determine location remotely, hedging the request
+     * if it is slow to be answered.
+     */
+    SHLC_ReturnCode getLocation(PooledRequest& xhr,
+                                const Codec& codec,
+                                const std::string& authentication,
+                                const Scan& scan,
+                                unsigned long timeout,
+                                LiteLocation& location);
+
+    /**
+     * Determine location for a scan, locally if possible.
+     *
+     * @param xhr the request to send to the server,
+     *            or \c NULL to create one.
+     * @param timeout milliseconds within which the server must answer,
+     *                \c 0 for the default.
+     */
+    SHLC_ReturnCode resolve(const char* key,
+                            const std::string& username,
+                            const Scan& scan,
+                            LiteLocation& location,
+                            PooledRequest* xhr,
+                            unsigned long timeout);
+
+private:
+
+    Context(const Context&);
+    Context& operator=(const Context&);
+
+private:
+
+    typedef std::map<std::string, std::string> Authentications;
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    bool _openAttempted;
+    SPI::Timer _lastOpenAttempt;
+
+    // Computed once, guarded by _mutex
+    std::string _username;
+    std::string _meta;
+    bool _metaInitialized;
+    Authentications _authentications;
+    std::string _serverUrl;
+    SPI::XmlHttpRequest::ContentEncoding _encoding;
+    std::string _dictionary;
+    const Codec* _codec;
+
+    RequestPool _requests;
+    BufferPool _buffers;
+    Hedger _hedger;
+    SingleFlight<LocationResult> _flights;
+
+    WifiWrapper _wifi;
+    CellWrapper _cell;
+    GpsWrapper _gps;
+
+    AdapterOpener<CellWrapper> _cellOpener;
+    AdapterOpener<GpsWrapper> _gpsOpener;
+
+    ScanCache _cache;
+    FingerprintIndex _fingerprints;
+    AccessPointSelector _apSelector;
+    ScanAggregator _aggregator;
+
+    CompletionQueue _completions;
+
+    // Separate from _mutex since stopping the tracker waits
+    // for a location request that may need _mutex
+    std::auto_ptr<SPI::Mutex> _trackerMutex;
+    std::auto_ptr<Tracker> _tracker;
+
+    // Declared last so that its threads are stopped
+    // before anything they use is destroyed
+    WorkQueue _workQueue;
+};
+
+}
+}
+
+#endif
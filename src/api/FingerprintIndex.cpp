@@ -0,0 +1,282 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FingerprintIndex.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace WPS {
+namespace API {
+
+using namespace WPS::SPI;
+
+/**
+ * Maximum number of fingerprints kept,
+ * the oldest one is replaced when full.
+ */
+static const size_t MAX_FINGERPRINTS = 4096;
+
+/**
+ * Scans with fewer access points are too ambiguous to be matched.
+ */
+static const size_t MIN_APS = 3;
+
+static const unsigned long DEFAULT_TTL = 10 * 60 * 1000;
+
+/**
+ * splitmix64 finalizer
+ */
+static inline unsigned long long
+mix(unsigned long long x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+FingerprintIndex::FingerprintIndex()
+    : _mutex(Mutex::newInstance())
+    , _threshold(0)
+    , _ttl(DEFAULT_TTL)
+    , _next(0)
+    , _hits(0)
+{}
+
+void
+FingerprintIndex::setThreshold(unsigned long threshold)
+{
+    Guard guard(_mutex.get());
+    _threshold = std::min(threshold, 100UL);
+    if (_threshold == 0)
+    {
+        _fingerprints.clear();
+        _buckets.clear();
+        _next = 0;
+    }
+}
+
+void
+FingerprintIndex::setTtl(unsigned long ttl)
+{
+    Guard guard(_mutex.get());
+    _ttl = ttl;
+}
+
+bool
+FingerprintIndex::isUsable(const Scan& scan) const
+{
+    // GPS fixes make for a better location than a past one
+    return _threshold != 0 && scan.gps.empty() && scan.aps.size() >= MIN_APS;
+}
+
+bool
+FingerprintIndex::lookup(const char* key, const Scan& scan, LiteLocation& location)
+{
+    Guard guard(_mutex.get());
+
+    if (! isUsable(scan))
+        return false;
+
+    MacSet macs;
+    getMacs(scan, macs);
+    if (macs.size() < MIN_APS)
+        return false;
+
+    unsigned long long bandKeys[BANDS];
+    getBandKeys(macs, bandKeys);
+
+    const unsigned long long keyHash = hashKey(key);
+
+    const Fingerprint* best = NULL;
+    double bestSimilarity = _threshold / 100.0;
+
+    for (size_t band = 0; band < BANDS; ++band)
+    {
+        Buckets::const_iterator bucket = _buckets.find(bandKeys[band]);
+        if (bucket == _buckets.end())
+            continue;
+
+        for (std::vector<size_t>::const_iterator it = bucket->second.begin();
+             it != bucket->second.end();
+             ++it)
+        {
+            const Fingerprint& fingerprint = _fingerprints[*it];
+
+            if (fingerprint.key != keyHash
+                    || fingerprint.stored.elapsed() >= _ttl
+                    || &fingerprint == best)
+                continue;
+
+            const double similarity = jaccard(macs, fingerprint.macs);
+            if (similarity >= bestSimilarity)
+            {
+                best = &fingerprint;
+                bestSimilarity = similarity;
+            }
+        }
+    }
+
+    if (best == NULL)
+        return false;
+
+    location = best->location;
+    ++_hits;
+    return true;
+}
+
+void
+FingerprintIndex::store(const char* key, const Scan& scan, const LiteLocation& location)
+{
+    Guard guard(_mutex.get());
+
+    if (! isUsable(scan))
+        return;
+
+    MacSet macs;
+    getMacs(scan, macs);
+    if (macs.size() < MIN_APS)
+        return;
+
+    if (_fingerprints.empty())
+        _fingerprints.resize(MAX_FINGERPRINTS);
+
+    const size_t slot = _next;
+    _next = (_next + 1) % _fingerprints.size();
+
+    unlink(slot);
+
+    Fingerprint& fingerprint = _fingerprints[slot];
+    fingerprint.macs.swap(macs);
+    fingerprint.used = true;
+    fingerprint.key = hashKey(key);
+    fingerprint.location = location;
+    fingerprint.stored.reset();
+    getBandKeys(fingerprint.macs, fingerprint.bandKeys);
+
+    for (size_t band = 0; band < BANDS; ++band)
+        _buckets[fingerprint.bandKeys[band]].push_back(slot);
+}
+
+void
+FingerprintIndex::unlink(size_t slot)
+{
+    Fingerprint& fingerprint = _fingerprints[slot];
+    if (! fingerprint.used)
+        return;
+
+    for (size_t band = 0; band < BANDS; ++band)
+    {
+        Buckets::iterator bucket = _buckets.find(fingerprint.bandKeys[band]);
+        if (bucket == _buckets.end())
+            continue;
+
+        std::vector<size_t>& slots = bucket->second;
+        slots.erase(std::remove(slots.begin(), slots.end(), slot), slots.end());
+        if (slots.empty())
+            _buckets.erase(bucket);
+    }
+
+    fingerprint.used = false;
+    fingerprint.macs.clear();
+}
+
+void
+FingerprintIndex::getMacs(const Scan& scan, MacSet& macs)
+{
+    macs.clear();
+    macs.reserve(scan.aps.size());
+    for (std::vector<ScannedAccessPoint>::const_iterator it = scan.aps.begin();
+         it != scan.aps.end();
+         ++it)
+    {
+        macs.push_back(it->getMAC().toLong());
+    }
+
+    std::sort(macs.begin(), macs.end());
+    macs.erase(std::unique(macs.begin(), macs.end()), macs.end());
+}
+
+void
+FingerprintIndex::getBandKeys(const MacSet& macs, unsigned long long bandKeys[BANDS])
+{
+    Signature signature;
+    std::fill(signature, signature + NUM_HASHES, ~0ULL);
+
+    for (MacSet::const_iterator it = macs.begin(); it != macs.end(); ++it)
+    {
+        // Each hash function is the mixer seeded differently
+        const unsigned long long h = mix(*it);
+        for (size_t i = 0; i < NUM_HASHES; ++i)
+        {
+            const unsigned long long hi = mix(h + (i + 1) * 0x9e3779b97f4a7c15ULL);
+            if (hi < signature[i])
+                signature[i] = hi;
+        }
+    }
+
+    for (size_t band = 0; band < BANDS; ++band)
+    {
+        // Include the band so that equal rows in different bands
+        // don't end up in the same bucket
+        unsigned long long bandKey = mix(band + 1);
+        for (size_t row = 0; row < ROWS; ++row)
+            bandKey = mix(bandKey ^ signature[band * ROWS + row]);
+        bandKeys[band] = bandKey;
+    }
+}
+
+unsigned long long
+FingerprintIndex::hashKey(const char* key)
+{
+    unsigned long long h = 0;
+    for (size_t i = 0, n = strlen(key); i < n; ++i)
+        h = mix(h ^ (unsigned char) key[i]);
+    return h;
+}
+
+double
+FingerprintIndex::jaccard(const MacSet& lhs, const MacSet& rhs)
+{
+    size_t common = 0;
+
+    // Both sets are sorted
+    MacSet::const_iterator l = lhs.begin();
+    MacSet::const_iterator r = rhs.begin();
+    while (l != lhs.end() && r != rhs.end())
+    {
+        if (*l < *r)
+            ++l;
+        else if (*r < *l)
+            ++r;
+        else
+        {
+            ++common;
+            ++l;
+            ++r;
+        }
+    }
+
+    const size_t total = lhs.size() + rhs.size() - common;
+    return total == 0 ? 0 : (double) common / total;
+}
+
+}
+}
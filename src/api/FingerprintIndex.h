@@ -0,0 +1,131 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_FINGERPRINTINDEX_H_
+#define WPS_API_FINGERPRINTINDEX_H_
+
+#include "Wrappers.h"
+
+#include "spi/Concurrent.h"
+#include "spi/Time.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace WPS {
+namespace API {
+
+/**
+ * Recent (access point set, location) pairs, searchable by similarity.
+ * \n
+ * Indoor devices rarely see the exact same set of access points twice,
+ * but a scan whose MAC set is close enough (Jaccard similarity) to one
+ * that was already located can reuse its location.
+ * \n
+ * Candidates are found through a MinHash / locality-sensitive hashing
+ * index, so a lookup only compares the scan with the few fingerprints
+ * that share a band of their MinHash signature.
+ */
+class FingerprintIndex
+{
+public:
+
+    FingerprintIndex();
+
+    /**
+     * Set the minimum Jaccard similarity, in percent, for a match.
+     * \n
+     * \c 0 disables the index (the default).
+     */
+    void setThreshold(unsigned long threshold);
+
+    /**
+     * Set how long a fingerprint stays usable, in milliseconds.
+     */
+    void setTtl(unsigned long ttl);
+
+    /**
+     * @return \c true if a similar scan was found
+     *         and its location set in \c location.
+     */
+    bool lookup(const char* key, const Scan& scan, LiteLocation& location);
+
+    void store(const char* key, const Scan& scan, const LiteLocation& location);
+
+    unsigned long getHits() const
+    {
+        SPI::Guard guard(_mutex.get());
+        return _hits;
+    }
+
+private:
+
+    static const size_t NUM_HASHES = 32;
+    static const size_t ROWS = 4;
+    static const size_t BANDS = NUM_HASHES / ROWS;
+
+    typedef std::vector<unsigned long long> MacSet;
+    typedef unsigned long long Signature[NUM_HASHES];
+
+    struct Fingerprint
+    {
+        bool used;
+        unsigned long long key;
+        MacSet macs;
+        unsigned long long bandKeys[BANDS];
+        LiteLocation location;
+        SPI::Timer stored;
+
+        Fingerprint()
+            : used(false)
+            , key(0)
+        {}
+    };
+
+    typedef std::map<unsigned long long, std::vector<size_t> > Buckets;
+
+    bool isUsable(const Scan& scan) const;
+
+    static void getMacs(const Scan& scan, MacSet& macs);
+    static void getBandKeys(const MacSet& macs, unsigned long long bandKeys[BANDS]);
+    static unsigned long long hashKey(const char* key);
+    static double jaccard(const MacSet& lhs, const MacSet& rhs);
+
+    void unlink(size_t slot);
+
+private:
+
+    FingerprintIndex(const FingerprintIndex&);
+    FingerprintIndex& operator=(const FingerprintIndex&);
+
+private:
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    unsigned long _threshold;
+    unsigned long _ttl;
+
+    std::vector<Fingerprint> _fingerprints;   // ring buffer
+    size_t _next;
+    Buckets _buckets;
+
+    unsigned long _hits;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,352 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Hedger.h"
+
+#include "spi/Thread.h"
+#include "spi/Time.h"
+
+#include <algorithm>
+
+namespace WPS {
+namespace API {
+
+using namespace WPS::SPI;
+
+/**
+ * Number of response times the percentile is computed over.
+ */
+static const size_t MAX_SAMPLES = 64;
+
+/**
+ * Number of response times needed before hedging,
+ * fewer don't tell what "slower than usual" is.
+ */
+static const size_t MIN_SAMPLES = 16;
+
+/**
+ * Minimum delay before duplicating a request, in milliseconds,
+ * so that a fast server isn't sent every other request twice.
+ */
+static const unsigned long MIN_DELAY = 50;
+
+/**********************************************************************/
+/*                                                                    */
+/* Hedger::Race                                                       */
+/*                                                                    */
+/**********************************************************************/
+
+/**
+ * A request sent on the caller's thread, and its duplicate
+ * prepared and sent on a thread of its own after a delay.
+ */
+class Hedger::Race
+    : public JoinableThread::Runnable
+{
+public:
+
+    enum Winner
+    {
+        NONE,
+        PRIMARY,
+        SECONDARY
+    };
+
+    Race(XmlHttpRequest& primary,
+         Duplicate& duplicate,
+         const std::string& data,
+         unsigned long delay,
+         unsigned long timeout)
+        : _primary(primary)
+        , _duplicate(duplicate)
+        , _data(data)
+        , _delay(delay)
+        , _timeout(timeout)
+        , _mutex(Mutex::newInstance())
+        , _cancel(Event::newInstance())
+        , _winner(NONE)
+        , _secondary(NULL)
+        , _primaryDone(false)
+        , _secondaryStarted(false)
+        , _secondaryDone(false)
+        , _secondaryAborted(false)
+        , _secondaryCode(SPI_ERROR)
+        , _secondaryLatency(0)
+    {}
+
+    /**
+     * Prepare and send the duplicate unless the primary request
+     * is done by the end of the delay.
+     */
+    void run()
+    {
+        if (_cancel->wait(_delay) <= 0)
+            return;
+
+        {
+            Guard guard(_mutex.get());
+            if (_primaryDone)
+                return;
+        }
+
+        // Outside the lock, it may have to create the request
+        PooledRequest* secondary = _duplicate.prepare();
+        if (secondary == NULL)
+            return;
+
+        {
+            Guard guard(_mutex.get());
+            if (_primaryDone)
+                return;
+            _secondary = secondary;
+            _secondaryStarted = true;
+        }
+
+        // Due at the same time as the primary request
+        (*secondary)->setTimeout(_timeout > 0 ? _timeout - _delay : 0);
+
+        const Timer started;
+        const ErrorCode code = (*secondary)->send(_data);
+
+        Guard guard(_mutex.get());
+
+        _secondaryDone = true;
+        _secondaryCode = code;
+        _secondaryLatency = started.elapsed();
+
+        if (code == SPI_OK && _winner == NONE)
+        {
+            _winner = SECONDARY;
+            _primary.abort();
+        }
+    }
+
+    /**
+     * Called on the caller's thread once the primary request is done.
+     */
+    void finishPrimary(ErrorCode code)
+    {
+        {
+            Guard guard(_mutex.get());
+
+            _primaryDone = true;
+
+            if (code == SPI_OK && _winner == NONE)
+            {
+                _winner = PRIMARY;
+
+                if (_secondaryStarted && ! _secondaryDone)
+                {
+                    (*_secondary)->abort();
+                    _secondaryAborted = true;
+                }
+            }
+        }
+
+        // If the primary request failed, a duplicate in progress
+        // may still succeed, but one not sent yet isn't worth sending
+        _cancel->signal();
+    }
+
+    // The following are only called once the thread has been joined
+
+    Winner getWinner() const
+    {
+        return _winner;
+    }
+
+    PooledRequest* getSecondary() const
+    {
+        return _secondary;
+    }
+
+    bool isSecondaryStarted() const
+    {
+        return _secondaryStarted;
+    }
+
+    bool isSecondaryAborted() const
+    {
+        return _secondaryAborted;
+    }
+
+    ErrorCode getSecondaryCode() const
+    {
+        return _secondaryCode;
+    }
+
+    unsigned long getSecondaryLatency() const
+    {
+        return _secondaryLatency;
+    }
+
+private:
+
+    XmlHttpRequest& _primary;
+    Duplicate& _duplicate;
+    const std::string& _data;
+    const unsigned long _delay;
+    const unsigned long _timeout;
+
+    std::auto_ptr<Mutex> _mutex;
+    std::auto_ptr<Event> _cancel;   // signaled once the primary request is done
+    Winner _winner;
+    PooledRequest* _secondary;      // set once the duplicate is started
+    bool _primaryDone;
+    bool _secondaryStarted;
+    bool _secondaryDone;
+    bool _secondaryAborted;
+    ErrorCode _secondaryCode;
+    unsigned long _secondaryLatency;
+};
+
+/**********************************************************************/
+/*                                                                    */
+/* Hedger                                                             */
+/*                                                                    */
+/**********************************************************************/
+
+Hedger::Hedger()
+    : _mutex(Mutex::newInstance())
+    , _percentile(0)
+    , _nextSample(0)
+    , _hedged(0)
+    , _wins(0)
+{}
+
+void
+Hedger::setPercentile(unsigned long percentile)
+{
+    Guard guard(_mutex.get());
+    _percentile = percentile;
+}
+
+bool
+Hedger::isEnabled()
+{
+    Guard guard(_mutex.get());
+    return _percentile > 0 && _samples.size() >= MIN_SAMPLES;
+}
+
+unsigned long
+Hedger::getDelay()
+{
+    std::vector<unsigned long> samples;
+    unsigned long percentile;
+    {
+        Guard guard(_mutex.get());
+
+        if (_percentile == 0 || _samples.size() < MIN_SAMPLES)
+            return 0;
+
+        samples = _samples;
+        percentile = _percentile;
+    }
+
+    const std::vector<unsigned long>::iterator nth =
+        samples.begin() + (samples.size() - 1) * percentile / 100;
+    std::nth_element(samples.begin(), nth, samples.end());
+
+    return std::max(*nth, MIN_DELAY);
+}
+
+void
+Hedger::addSample(unsigned long latency)
+{
+    Guard guard(_mutex.get());
+
+    if (_samples.size() < MAX_SAMPLES)
+        _samples.push_back(latency);
+    else
+        _samples[_nextSample] = latency;
+
+    _nextSample = (_nextSample + 1) % MAX_SAMPLES;
+}
+
+ErrorCode
+Hedger::send(PooledRequest& primary,
+             Duplicate* duplicate,
+             const std::string& data,
+             unsigned long timeout,
+             PooledRequest*& answered)
+{
+    answered = &primary;
+
+    primary->setTimeout(timeout);
+
+    unsigned long delay = duplicate != NULL ? getDelay() : 0;
+
+    // Not worth it if the duplicate wouldn't have time to be answered
+    if (timeout > 0 && delay >= timeout)
+        delay = 0;
+
+    std::auto_ptr<Race> race;
+    std::auto_ptr<JoinableThread> thread;
+    if (delay > 0)
+    {
+        race.reset(new Race(*primary, *duplicate, data, delay, timeout));
+        thread.reset(JoinableThread::newInstance(race.get()));
+    }
+
+    const Timer started;
+    const ErrorCode code = primary->send(data);
+    const unsigned long latency = started.elapsed();
+
+    if (thread.get() == NULL)
+    {
+        if (code == SPI_OK)
+            addSample(latency);
+        return code;
+    }
+
+    race->finishPrimary(code);
+    thread.reset();
+
+    {
+        Guard guard(_mutex.get());
+        if (race->isSecondaryStarted())
+            ++_hedged;
+        if (race->getWinner() == Race::SECONDARY)
+            ++_wins;
+    }
+
+    switch (race->getWinner())
+    {
+        case Race::PRIMARY:
+            if (race->isSecondaryAborted())
+                race->getSecondary()->discard();
+
+            addSample(latency);
+            return code;
+
+        case Race::SECONDARY:
+            primary.discard();
+
+            // The primary request would have taken at least that long,
+            // leaving it out would make the percentile drift down
+            addSample(latency);
+            addSample(race->getSecondaryLatency());
+
+            answered = race->getSecondary();
+            return race->getSecondaryCode();
+
+        default:
+            return code;
+    }
+}
+
+}
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_HEDGER_H_
+#define WPS_API_HEDGER_H_
+
+#include "RequestPool.h"
+
+#include "spi/Concurrent.h"
+#include "spi/ErrorCodes.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace WPS {
+namespace API {
+
+/**
+ * Sends server requests, duplicating those that are slower than usual.
+ * \n
+ * When a request hasn't been answered after a given percentile of the
+ * recent response times, the same request is sent on a second connection
+ * and whichever is answered first is used, the other one being aborted.
+ * This trades a few extra requests for a shorter tail latency.
+ */
+class Hedger
+{
+public:
+
+    /**
+     * Prepares the duplicate of a request, only once it is to be sent.
+     */
+    class Duplicate
+    {
+    public:
+
+        virtual ~Duplicate() {}
+
+        /**
+         * Called on the hedging thread once the delay has expired.
+         *
+         * @return the request to send the duplicate on, owned by
+         *         the \c Duplicate, or \c NULL to not hedge.
+         */
+        virtual PooledRequest* prepare() = 0;
+    };
+
+    Hedger();
+
+    /**
+     * Set the percentile of the recent response times
+     * after which a request is duplicated.
+     * \n
+     * \c 0 disables hedging (the default).
+     */
+    void setPercentile(unsigned long percentile);
+
+    /**
+     * @return \c true if enough response times were recorded for
+     *         \c send() to duplicate requests.
+     */
+    bool isEnabled();
+
+    /**
+     * Send \c data on \c primary, and on a duplicate as well
+     * if \c primary is too slow to answer.
+     *
+     * @param duplicate prepares the request used for the duplicate,
+     *                  or \c NULL to not hedge.
+     * @param timeout milliseconds within which to be answered,
+     *                \c 0 for the requests' default.
+     * @param answered receives the request whose response is to be used.
+     *
+     * @return the result of sending \c answered.
+     *
+     * @note Aborted requests are discarded rather than returned to their pool.
+     */
+    SPI::ErrorCode send(PooledRequest& primary,
+                        Duplicate* duplicate,
+                        const std::string& data,
+                        unsigned long timeout,
+                        PooledRequest*& answered);
+
+    /**
+     * @return the number of requests that were duplicated.
+     */
+    unsigned long getHedged() const
+    {
+        SPI::Guard guard(_mutex.get());
+        return _hedged;
+    }
+
+    /**
+     * @return the number of duplicates answered first.
+     */
+    unsigned long getWins() const
+    {
+        SPI::Guard guard(_mutex.get());
+        return _wins;
+    }
+
+private:
+
+    class Race;
+
+    /**
+     * @return the delay after which to duplicate a request,
+     *         \c 0 if it shouldn't be.
+     */
+    unsigned long getDelay();
+
+    void addSample(unsigned long latency);
+
+private:
+
+    Hedger(const Hedger&);
+    Hedger& operator=(const Hedger&);
+
+private:
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    unsigned long _percentile;
+    std::vector<unsigned long> _samples;  // ring buffer of response times
+    size_t _nextSample;
+    unsigned long _hedged;
+    unsigned long _wins;
+};
+
+}
+}
+
+#endif
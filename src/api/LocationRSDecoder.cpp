@@ -0,0 +1,204 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LocationRSDecoder.h"
+#include "Protocol.h"
+
+#include "spi/StdLibC.h"
+#include "spi/Time.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace WPS {
+namespace API {
+
+using SPI::Time;
+using SPI::XmlAttribute;
+using SPI::XmlPushParser;
+
+LocationRSDecoder::LocationRSDecoder()
+    : _wellFormed(false)
+    , _complete(false)
+    , _depth(DOCUMENT)
+    , _timeDelta(0)
+    , _inLocation(false)
+    , _fieldsRead(NONE)
+    , _field(NONE)
+{
+    _parser.reset(XmlPushParser::newInstance(*this));
+}
+
+void
+LocationRSDecoder::begin()
+{
+    _parser->reset();
+
+    _wellFormed = true;
+    _complete = false;
+    _depth = DOCUMENT;
+    _timeDelta = 0;
+    _inLocation = false;
+    _field = NONE;
+    _locations.clear();
+}
+
+void
+LocationRSDecoder::data(const char* data, std::size_t size)
+{
+    if (_wellFormed)
+        _wellFormed = _parser->parse(data, size);
+}
+
+bool
+LocationRSDecoder::getLocations(std::vector<LiteLocation>& locations)
+{
+    // Also catches what follows the root element
+    if (_wellFormed)
+        _wellFormed = _parser->finish();
+
+    if (! _wellFormed || ! _complete || _locations.empty())
+        return false;
+
+    locations.insert(locations.end(), _locations.begin(), _locations.end());
+    return true;
+}
+
+void
+LocationRSDecoder::startElement(const char* namespaceURI,
+                                const char* localName,
+                                const XmlAttribute* attributes,
+                                std::size_t size)
+{
+    ++_depth;
+
+    if (_depth == LOCATION)
+    {
+        _inLocation = strcmp(namespaceURI, Protocol::NAMESPACE_URI) == 0
+                   && strcmp(localName, "location") == 0;
+        if (_inLocation)
+            startLocation(attributes, size);
+    }
+    else if (_depth == FIELD
+                && _inLocation
+                && strcmp(namespaceURI, Protocol::NAMESPACE_URI) == 0)
+    {
+        Field field = NONE;
+        if (strcmp(localName, "hpe") == 0)
+            field = HPE;
+        else if (strcmp(localName, "latitude") == 0)
+            field = LATITUDE;
+        else if (strcmp(localName, "longitude") == 0)
+            field = LONGITUDE;
+
+        if (field != NONE && (_fieldsRead & field) == 0)
+        {
+            _fieldsRead |= field;
+            _field = field;
+            _text.clear();
+        }
+    }
+}
+
+void
+LocationRSDecoder::endElement()
+{
+    if (_depth == FIELD && _field != NONE)
+    {
+        const double value = SPI::atof(_text);
+        switch (_field)
+        {
+        case HPE:
+            _location.hpe = value;
+            break;
+        case LATITUDE:
+            _location.latitude = value;
+            break;
+        case LONGITUDE:
+            _location.longitude = value;
+            break;
+        case NONE:
+            break;
+        }
+
+        _field = NONE;
+    }
+    else if (_depth == LOCATION && _inLocation)
+    {
+        _locations.push_back(_location);
+        _inLocation = false;
+    }
+    else if (_depth == ROOT)
+        _complete = true;
+
+    --_depth;
+}
+
+void
+LocationRSDecoder::characters(const char* data, std::size_t size)
+{
+    // The value of the field, not of the elements it may contain
+    if (_depth == FIELD && _field != NONE)
+        _text.append(data, size);
+}
+
+void
+LocationRSDecoder::startLocation(const XmlAttribute* attributes,
+                                 std::size_t size)
+{
+    _location = LiteLocation();
+    _fieldsRead = NONE;
+
+    _location.nap = SPI::atoi(getAttribute(attributes, size, "nap"));
+    _location.nsat = SPI::atoi(getAttribute(attributes, size, "nsat"));
+    _location.ncell = SPI::atoi(getAttribute(attributes, size, "ncell"));
+    _location.nlac = SPI::atoi(getAttribute(attributes, size, "nlac"));
+
+    const unsigned long age = SPI::atoi(getAttribute(attributes, size, "age"));
+
+    const long rqtime = SPI::atoi(getAttribute(attributes, size, "rqtime"));
+    if (rqtime > 0)
+    {
+        // See Protocol::parseLocationRS()
+        const long now = Time::now().sec();
+        _timeDelta = std::max(now - rqtime, 0L) * 1000;
+    }
+
+    _location.time.reset(age + _timeDelta);
+}
+
+const std::string&
+LocationRSDecoder::getAttribute(const XmlAttribute* attributes,
+                                std::size_t size,
+                                const char* localName)
+{
+    _text.clear();
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if (*attributes[i].namespaceURI == '\0'
+                && strcmp(attributes[i].localName, localName) == 0)
+        {
+            _text.assign(attributes[i].value, attributes[i].valueSize);
+            break;
+        }
+    }
+
+    return _text;
+}
+
+}
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_LOCATIONRSDECODER_H_
+#define WPS_API_LOCATIONRSDECODER_H_
+
+#include "Codec.h"
+
+#include "spi/XmlPushParser.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace WPS {
+namespace API {
+
+/**
+ * Decodes the \c LocationRS of \c Protocol as it's downloaded,
+ * into the same locations as \c Protocol::parseLocationRS()
+ * but without building the document.
+ */
+class LocationRSDecoder
+    : public ResponseDecoder
+    , private SPI::XmlContentHandler
+{
+public:
+
+    LocationRSDecoder();
+
+    void begin();
+    void data(const char* data, std::size_t size);
+
+    bool getLocations(std::vector<LiteLocation>& locations);
+
+private:
+
+    void startElement(const char* namespaceURI,
+                      const char* localName,
+                      const SPI::XmlAttribute* attributes,
+                      std::size_t size);
+    void endElement();
+    void characters(const char* data, std::size_t size);
+
+    void startLocation(const SPI::XmlAttribute* attributes, std::size_t size);
+
+    /**
+     * @return the value of the attribute \c localName without namespace,
+     *         as \c getAttributeNS("", localName) would.
+     */
+    const std::string& getAttribute(const SPI::XmlAttribute* attributes,
+                                    std::size_t size,
+                                    const char* localName);
+
+private:
+
+    LocationRSDecoder(const LocationRSDecoder&);
+    LocationRSDecoder& operator=(const LocationRSDecoder&);
+
+private:
+
+    /**
+     * The children of \c location read, the first of each name only.
+     */
+    enum Field
+    {
+        NONE        = 0,
+        HPE         = 1 << 0,
+        LATITUDE    = 1 << 1,
+        LONGITUDE   = 1 << 2
+    };
+
+    enum Depth
+    {
+        DOCUMENT,
+        ROOT,
+        LOCATION,
+        FIELD
+    };
+
+    std::auto_ptr<SPI::XmlPushParser> _parser;
+    bool _wellFormed;
+    bool _complete;             // the root element is closed
+
+    unsigned long _depth;
+    unsigned long _timeDelta;   // sticks to the following locations
+    bool _inLocation;
+    int _fieldsRead;
+    Field _field;               // the field whose text is read, if any
+
+    std::string _text;          // reused for every value
+    LiteLocation _location;
+    std::vector<LiteLocation> _locations;
+};
+
+}
+}
+
+#endif
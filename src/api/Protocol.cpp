@@ -22,7 +22,7 @@
 #include "spi/XmlParser.h"
 #include "spi/StdLibC.h"
 
-#include <memory>
+#include <algorithm>
 #include <cmath>
 #include <string.h>
 
@@ -32,65 +32,6 @@ namespace {
 
 static const char* VERSION = "2.23";
 
-static const size_t AUTH_STR_SIZE = 128 + 32;
-static const size_t ADDR_LOOKUP_STR_SIZE = 64;
-
-static const size_t AP_STR_SIZE = 128;
-static const size_t SSID_STR_SIZE = 45;
-static const size_t CELL_STR_SIZE = 128;  // about 83 for gsm-tower and 106 for cdma-tower in worst case
-static const size_t GPS_STR_SIZE = 256;
-
-static inline size_t
-sizeNumSsids(size_t size)
-{
-    return size * SSID_STR_SIZE;
-}
-
-static inline size_t
-sizeNumAPs(size_t size, bool includeSsid)
-{
-    return size * AP_STR_SIZE
-    + (includeSsid ? sizeNumSsids(size) : 0);
-}
-
-static inline size_t
-sizeNumCells(size_t size)
-{
-    return size * CELL_STR_SIZE;
-}
-
-static inline size_t
-sizeNumGps(size_t size)
-{
-    return size * GPS_STR_SIZE;
-}
-
-static inline size_t
-size(const std::vector<WPS::SPI::ScannedAccessPoint>& aps, bool includeSsid)
-{
-    return sizeNumAPs(aps.size(), includeSsid);
-}
-
-static inline size_t
-size(const std::vector<WPS::SPI::ScannedCellTower>& cells)
-{
-    return sizeNumCells(cells.size());
-}
-
-static inline size_t
-size(const std::vector<WPS::SPI::GPSData::Fix>& fixes)
-{
-    return sizeNumGps(fixes.size());
-}
-
-static inline size_t
-size(const WPS::API::Scan& scan, bool includeSsid)
-{
-    return size(scan.aps, includeSsid)
-         + size(scan.cells)
-         + size(scan.gps);
-}
-
 }  // anonymous namespace
 
 
@@ -98,17 +39,19 @@ namespace WPS {
 namespace API {
 
 using SPI::XmlParser;
-using SPI::DOMNode;
-using SPI::DOMNodeList;
+using SPI::DOMNodeRef;
 using SPI::DOMDocument;
 using SPI::GPSData;
+using SPI::MAC;
 using SPI::ScannedAccessPoint;
+using SPI::InternedSsid;
 using SPI::CellTower;
 using SPI::ScannedCellTower;
 using SPI::Timer;
 using SPI::Time;
 
-static const char* namespaceURI = "http://skyhookwireless.com/wps/2005";
+/*static*/ const char* const Protocol::NAMESPACE_URI =
+    "http://skyhookwireless.com/wps/2005";
 
 /**********************************************************************/
 /*                                                                    */
@@ -116,362 +59,581 @@ static const char* namespaceURI = "http://skyhookwireless.com/wps/2005";
 /*                                                                    */
 /**********************************************************************/
 
-inline void
-reserve(std::string& xml, size_t n)
+/*
+ * Requests are serialized in two passes over the same template:
+ * the first one with a Sizer, which only adds up the size of the
+ * output, the second one with a Writer, which copies it into a buffer
+ * of that size. Numbers, MACs and escaped strings are formatted by hand
+ * rather than through snprintf() and temporary strings.
+ */
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * Large enough for any integer or fixed-point number written,
+ * up to -DBL_MAX with six decimals.
+ */
+static const size_t NUMBER_SIZE = 320;
+
+/**
+ * Format \c value backwards, ending at \c end.
+ *
+ * @return the first character.
+ */
+static inline char*
+formatUnsigned(unsigned long long value, char* end)
 {
-    size_t free = xml.capacity() - xml.size();
-    if (free < n)
+    char* p = end;
+    while (value >= 100)
     {
-        // Force the capacity back to zero since some string implementations
-        // will reserve more than asked for (double the old capacity).
-        if (xml.size() == 0)
-            std::string().swap(xml);
+        const unsigned i = static_cast<unsigned>(value % 100) * 2;
+        value /= 100;
+        *--p = DIGIT_PAIRS[i + 1];
+        *--p = DIGIT_PAIRS[i];
+    }
 
-        xml.reserve(xml.size() + n);
+    if (value >= 10)
+    {
+        const unsigned i = static_cast<unsigned>(value) * 2;
+        *--p = DIGIT_PAIRS[i + 1];
+        *--p = DIGIT_PAIRS[i];
     }
-}
+    else
+        *--p = static_cast<char>('0' + value);
 
-template <size_t size>
-inline std::string&
-operator<<(std::string& xml, const char (&rhs)[size])
-{
-    return xml.append(rhs, size - 1);
+    return p;
 }
 
-inline std::string&
-operator<<(std::string& xml, const char* rhs)
+/**
+ * Format \c value backwards, ending at \c end.
+ *
+ * @return the first character.
+ */
+static inline char*
+formatInteger(long value, char* end)
 {
-    return xml.append(rhs);
-}
+    if (value >= 0)
+        return formatUnsigned(static_cast<unsigned long>(value), end);
 
-inline std::string&
-operator<<(std::string& xml, const std::string& rhs)
-{
-    return xml.append(rhs);
+    char* p = formatUnsigned(0UL - static_cast<unsigned long>(value), end);
+    *--p = '-';
+    return p;
 }
 
-inline std::string&
-operator<<(std::string& xml, int i)
+static inline size_t
+integerSize(long value)
 {
-    // save string memory allocation by not using itoa
-    char s[32];
-    int n = SPI::snprintf(s, sizeof s, "%d", i);
-    return xml.append(s, n);
+    unsigned long u = value >= 0 ? static_cast<unsigned long>(value)
+                                 : 0UL - static_cast<unsigned long>(value);
+    size_t n = value >= 0 ? 1 : 2;
+    while (u >= 10)
+    {
+        u /= 10;
+        ++n;
+    }
+    return n;
 }
 
-inline std::string&
-operator<<(std::string& xml, long l)
+/**
+ * Format \c value like <code>printf("%.6f")</code>, ending at \c end.
+ *
+ * @return the first character.
+ */
+static char*
+formatFixed(double value, char* end)
 {
-    // save string memory allocation by not using ltoa
-    char s[32];
-    int n = SPI::snprintf(s, sizeof s, "%ld", l);
-    return xml.append(s, n);
-}
+    const double magnitude = fabs(value);
+    const double scaled = magnitude * 1e6;
+    const double fraction = scaled - floor(scaled);
+
+    // Leave printf() the values it may round differently: those off
+    // the range of coordinates, altitudes and speeds, and those too
+    // close to a tie for the product above to tell.
+    if (! (magnitude < 1e7) || fabs(fraction - .5) < 1e-3)
+    {
+        char s[NUMBER_SIZE];
+        const int n = SPI::snprintf(s, sizeof(s), "%.6f", value);
+        return std::copy_backward(s, s + n, end);
+    }
 
-inline std::string&
-operator<<(std::string& xml, unsigned long l)
-{
-    // save string memory allocation by not using ltoa
-    char s[32];
-    int n = SPI::snprintf(s, sizeof s, "%lu", l);
-    return xml.append(s, n);
-}
+    const unsigned long long rounded =
+        static_cast<unsigned long long>(scaled + .5);
 
-inline std::string&
-operator<<(std::string& xml, double d)
-{
-    char s[32];
-    int n = SPI::snprintf(s, sizeof s, "%.6f", d);
-    return xml.append(s, n);
+    char* p = end;
+    unsigned long decimals = static_cast<unsigned long>(rounded % 1000000);
+    for (int i = 0; i < 6; ++i)
+    {
+        *--p = static_cast<char>('0' + decimals % 10);
+        decimals /= 10;
+    }
+    *--p = '.';
+
+    p = formatUnsigned(rounded / 1000000, p);
+
+    // -0.0 and values rounded to it are printed with their sign too
+    if (value < 0 || (value == 0 && 1 / value < 0))
+        *--p = '-';
+    return p;
 }
 
-inline std::string&
-operator<<(std::string& xml, bool b)
+/**
+ * @return the XML entity for \c c, \c NULL if it's written as is.
+ */
+static inline const char*
+xmlEntity(unsigned char c, size_t& size)
 {
-    return xml.append(b ? "true" : "false");
+    switch (c)
+    {
+    case '&':
+        size = 5;
+        return "&amp;";
+    case '<':
+        size = 4;
+        return "&lt;";
+    case '>':
+        size = 4;
+        return "&gt;";
+    case '"':
+        size = 6;
+        return "&quot;";
+    case '\'':
+        size = 6;
+        return "&apos;";
+    default:
+        return NULL;
+    }
 }
 
-struct xVersion
+/**
+ * Sizing pass.
+ */
+class Sizer
 {
-    xVersion(const char* version = VERSION)
-        : version(version)
+public:
+
+    Sizer()
+        : _size(0)
     {}
 
-    friend std::string&
-    operator<<(std::string& xml, const xVersion& rhs)
+    size_t getSize() const
     {
-        return xml << "xmlns='"
-                   << namespaceURI
-                   << "' version='"
-                   << rhs.version
-                   << "'";
+        return _size;
     }
 
-    const char* version;
-};
+    template <size_t N>
+    void literal(const char (&)[N])
+    {
+        _size += N - 1;
+    }
 
-struct xAuthentication
-{
-    xAuthentication(const char* key, const char* username)
-        : key(key)
-        , username(username)
-    {}
+    void string(const char* s, size_t size)
+    {
+        (void) s;
+        _size += size;
+    }
 
-    friend std::string&
-    operator<<(std::string& xml, const xAuthentication& rhs)
+    void integer(long value)
     {
-        reserve(xml, 128 + strlen(rhs.key));
-        return xml << "<authentication version='2.2'><key key='"
-                   << rhs.key
-                   << "' username='"
-                   << rhs.username
-                   << "'/></authentication>";
+        _size += integerSize(value);
     }
 
-    const char* key;
-    const char* username;
+    void fixed(double value)
+    {
+        char s[NUMBER_SIZE];
+        _size += s + sizeof(s) - formatFixed(value, s + sizeof(s));
+    }
+
+    void mac(const MAC&)
+    {
+        _size += 2 * sizeof(MAC::raw_type);
+    }
+
+    void escaped(const unsigned char* s, size_t size)
+    {
+        _size += size;
+        for (;;)
+        {
+            const size_t run = xmlUnescapedSpan(s, size);
+            if (run == size)
+                break;
+
+            size_t entitySize;
+            xmlEntity(s[run], entitySize);
+            _size += entitySize - 1;
+            s += run + 1;
+            size -= run + 1;
+        }
+    }
+
+private:
+
+    size_t _size;
 };
 
-struct xAccessPoints
+/**
+ * Writing pass, into a buffer sized by a \c Sizer.
+ */
+class Writer
 {
-    xAccessPoints(const Timer& now,
-                  const std::vector<ScannedAccessPoint>& scannedAPs,
-                  bool includeSsid)
-        : now(now)
-        , scannedAPs(scannedAPs)
-        , includeSsid(includeSsid)
+public:
+
+    explicit Writer(char* buffer)
+        : _p(buffer)
     {}
 
-    friend std::string&
-    operator<<(std::string& xml, const xAccessPoints& rhs)
+    const char* getEnd() const
     {
-        // NOTE: rhs.scannedAPs shouldn't have duplicates
+        return _p;
+    }
 
-        reserve(xml, size(rhs.scannedAPs, rhs.includeSsid));
+    template <size_t N>
+    void literal(const char (&s)[N])
+    {
+        memcpy(_p, s, N - 1);
+        _p += N - 1;
+    }
 
-        for (std::vector<ScannedAccessPoint>::const_iterator i = rhs.scannedAPs.begin();
-             i != rhs.scannedAPs.end();
-             ++i)
-        {
-            xml << "<access-point><mac>"
-                << i->getMAC().toString()
-                << "</mac>";
-
-            // NOTE: SSID attribute must be 1-32 characters. For now we do not
-            //       send SSID for hidden APs.
-            const std::vector<unsigned char>& ssid = i->getSsid();
-            if (rhs.includeSsid && ! ssid.empty() && xmlUtf8Test(ssid))
-                xml << "<ssid>"
-                    << xmlEscape(std::string(ssid.begin(), ssid.end()))
-                    << "</ssid>";
-
-            xml << "<signal-strength>"
-                << i->getRSSI()
-                << "</signal-strength>";
-
-            const long age = rhs.now.delta(i->getTimestamp());
-            if (age > 0)
-            {
-                xml << "<age>"
-                    << age
-                    << "</age>";
-            }
+    void string(const char* s, size_t size)
+    {
+        memcpy(_p, s, size);
+        _p += size;
+    }
+
+    void integer(long value)
+    {
+        char s[NUMBER_SIZE];
+        const char* begin = formatInteger(value, s + sizeof(s));
+        string(begin, s + sizeof(s) - begin);
+    }
+
+    void fixed(double value)
+    {
+        char s[NUMBER_SIZE];
+        const char* begin = formatFixed(value, s + sizeof(s));
+        string(begin, s + sizeof(s) - begin);
+    }
 
-            xml << "</access-point>";
+    void mac(const MAC& mac)
+    {
+        // Most significant byte last
+        MAC::const_raw_ref raw = mac.getData();
+        for (size_t i = sizeof(MAC::raw_type); i > 0; --i)
+        {
+            *_p++ = HEX_DIGITS[raw[i - 1] >> 4];
+            *_p++ = HEX_DIGITS[raw[i - 1] & 0x0f];
         }
+    }
 
-        return xml;
+    void escaped(const unsigned char* s, size_t size)
+    {
+        for (;;)
+        {
+            const size_t run = xmlUnescapedSpan(s, size);
+            string(reinterpret_cast<const char*>(s), run);
+            if (run == size)
+                break;
+
+            size_t entitySize;
+            const char* entity = xmlEntity(s[run], entitySize);
+            string(entity, entitySize);
+            s += run + 1;
+            size -= run + 1;
+        }
     }
 
-    const Timer& now;
-    const std::vector<ScannedAccessPoint>& scannedAPs;
-    const bool includeSsid;
+private:
+
+    char* _p;
 };
 
-struct xCellTowers
+template <class Output>
+static void
+writeAuthentication(Output& out, const char* key, const char* username)
 {
-    xCellTowers(const Timer& now,
-                const std::vector<ScannedCellTower>& scannedCells)
-        : now(now), scannedCells(scannedCells)
-    {}
+    out.literal("<authentication version='2.2'><key key='");
+    out.string(key, strlen(key));
+    out.literal("' username='");
+    // may be supplied by the caller
+    out.escaped(reinterpret_cast<const unsigned char*>(username), strlen(username));
+    out.literal("'/></authentication>");
+}
+
+template <class Output>
+static void
+writeAccessPoints(Output& out,
+                  const Timer& now,
+                  const std::vector<ScannedAccessPoint>& aps,
+                  bool includeSsid)
+{
+    // NOTE: aps shouldn't have duplicates,
+    //       AccessPointSelector removes them if enabled
 
-    friend std::string&
-    operator<<(std::string& xml, const xCellTowers& rhs)
+    for (std::vector<ScannedAccessPoint>::const_iterator i = aps.begin();
+         i != aps.end();
+         ++i)
     {
-        // TODO: we should assert that rhs.scannedCells doesn't have duplicates
+        out.literal("<access-point><mac>");
+        out.mac(i->getMAC());
+        out.literal("</mac>");
+
+        // NOTE: SSID attribute must be 1-32 characters. For now we do not
+        //       send SSID for hidden APs.
+        const InternedSsid& ssid = i->getInternedSsid();
+        if (includeSsid && ! ssid.empty() && ssid.isValidXml())
+        {
+            const std::string& escaped = ssid.getEscapedXml();
+            out.literal("<ssid>");
+            out.string(escaped.data(), escaped.size());
+            out.literal("</ssid>");
+        }
 
-        reserve(xml, size(rhs.scannedCells));
+        out.literal("<signal-strength>");
+        out.integer(i->getRSSI());
+        out.literal("</signal-strength>");
 
-        for (std::vector<ScannedCellTower>::const_iterator i = rhs.scannedCells.begin();
-             i != rhs.scannedCells.end();
-             ++i)
+        const long age = now.delta(i->getTimestamp());
+        if (age > 0)
         {
-            CellTower::CellTowerType type = i->getCell().getType();
-            if (type == CellTower::GSM || type == CellTower::UMTS)
-            {
-                xml << (type == CellTower::GSM
-                            ? "<gsm-tower>"
-                            : "<umts-tower>");
-                xml << "<mcc>"
-                    << i->getCell().getMcc()
-                    << "</mcc><mnc>"
-                    << i->getCell().getMnc()
-                    << "</mnc>"
-                    << "<lac>"
-                    << i->getCell().getLac()
-                    << "</lac><ci>"
-                    << i->getCell().getCi()
-                    << "</ci>";
-            }
-            else
-            {
-                assert(type == CellTower::LTE);
-                xml << "<lte-tower><mcc>"
-                    << i->getCell().getMcc()
-                    << "</mcc><mnc>"
-                    << i->getCell().getMnc()
-                    << "</mnc><eucid>"
-                    << i->getCell().getCi()
-                    << "</eucid>";
-            }
+            out.literal("<age>");
+            out.integer(age);
+            out.literal("</age>");
+        }
 
-            xml << "<rssi>"
-                << i->getRssi()
-                << "</rssi>";
+        out.literal("</access-point>");
+    }
+}
 
-            if (i->getTimingAdvance() != 0)
-            {
-                xml << "<timing-advance>"
-                    << i->getTimingAdvance()
-                    << "</timing-advance>";
-            }
+template <class Output>
+static void
+writeCellTowers(Output& out,
+                const Timer& now,
+                const std::vector<ScannedCellTower>& cells)
+{
+    // TODO: we should assert that cells doesn't have duplicates
 
-            const long age = rhs.now.delta(i->getTimestamp());
-            if (age > 0)
-            {
-                xml << "<age>"
-                    << age
-                    << "</age>";
-            }
+    for (std::vector<ScannedCellTower>::const_iterator i = cells.begin();
+         i != cells.end();
+         ++i)
+    {
+        const CellTower& cell = i->getCell();
+        const CellTower::CellTowerType type = cell.getType();
 
+        if (type == CellTower::GSM || type == CellTower::UMTS)
+        {
             if (type == CellTower::GSM)
-                xml << "</gsm-tower>";
-            else if (type == CellTower::UMTS)
-                xml << "</umts-tower>";
+                out.literal("<gsm-tower>");
             else
-                xml << "</lte-tower>";
+                out.literal("<umts-tower>");
+
+            out.literal("<mcc>");
+            out.integer(cell.getMcc());
+            out.literal("</mcc><mnc>");
+            out.integer(cell.getMnc());
+            out.literal("</mnc><lac>");
+            out.integer(cell.getLac());
+            out.literal("</lac><ci>");
+            out.integer(cell.getCi());
+            out.literal("</ci>");
+        }
+        else
+        {
+            assert(type == CellTower::LTE);
+            out.literal("<lte-tower><mcc>");
+            out.integer(cell.getMcc());
+            out.literal("</mcc><mnc>");
+            out.integer(cell.getMnc());
+            out.literal("</mnc><eucid>");
+            out.integer(cell.getCi());
+            out.literal("</eucid>");
         }
 
-        return xml;
-    }
+        out.literal("<rssi>");
+        out.integer(i->getRssi());
+        out.literal("</rssi>");
 
-    const Timer& now;
-    const std::vector<ScannedCellTower>& scannedCells;
-};
+        if (i->getTimingAdvance() != 0)
+        {
+            out.literal("<timing-advance>");
+            out.integer(i->getTimingAdvance());
+            out.literal("</timing-advance>");
+        }
 
-struct xGPSLocations
-{
-    xGPSLocations(const Timer& now,
+        const long age = now.delta(i->getTimestamp());
+        if (age > 0)
+        {
+            out.literal("<age>");
+            out.integer(age);
+            out.literal("</age>");
+        }
+
+        if (type == CellTower::GSM)
+            out.literal("</gsm-tower>");
+        else if (type == CellTower::UMTS)
+            out.literal("</umts-tower>");
+        else
+            out.literal("</lte-tower>");
+    }
+}
+
+template <class Output>
+static void
+writeGPSLocations(Output& out,
+                  const Timer& now,
                   const std::vector<GPSData::Fix>& fixes)
-        : now(now), fixes(fixes)
-    {}
+{
+    // TODO: we should assert that fixes doesn't have duplicates
 
-    friend std::string&
-    operator<<(std::string& xml, const xGPSLocations& rhs)
+    for (std::vector<GPSData::Fix>::const_iterator fix = fixes.begin();
+         fix != fixes.end();
+         ++fix)
     {
-        // TODO: we should assert that rhs.fixes doesn't have duplicates
+        out.literal("<gps-location fix='");
+        out.integer(fix->quality);
+        out.literal("' nsat='");
+        out.integer(fix->svInFix);
+        out.literal("'><latitude>");
+        out.fixed(fix->latitude);
+        out.literal("</latitude><longitude>");
+        out.fixed(fix->longitude);
+        out.literal("</longitude>");
+
+        if (fix->hasHpe())
+        {
+            out.literal("<hpe>");
+            out.integer(static_cast<int>(fix->hpe));
+            out.literal("</hpe>");
+        }
 
-        reserve(xml, size(rhs.fixes));
+        if (fix->hasAltitude())
+        {
+            out.literal("<altitude>");
+            out.fixed(fix->altitude);
+            out.literal("</altitude>");
+        }
 
-        for (std::vector<GPSData::Fix>::const_iterator fix = rhs.fixes.begin();
-             fix != rhs.fixes.end();
-             ++fix)
+        if (fix->hasHeight())
         {
-            xml << "<gps-location fix='"
-                << fix->quality
-                << "' nsat='"
-                << static_cast<int>(fix->svInFix)
-                << "'><latitude>"
-                << fix->latitude
-                << "</latitude><longitude>"
-                << fix->longitude
-                << "</longitude>";
-
-            if (fix->hasHpe())
-            {
-                xml << "<hpe>"
-                    << static_cast<int>(fix->hpe)
-                    << "</hpe>";
-            }
+            out.literal("<height>");
+            out.fixed(fix->height);
+            out.literal("</height>");
+        }
 
-            if (fix->hasAltitude())
-            {
-                xml << "<altitude>"
-                    << fix->altitude
-                    << "</altitude>";
-            }
+        if (fix->hasSpeed())
+        {
+            out.literal("<speed>");
+            out.fixed(fix->speed);
+            out.literal("</speed>");
+        }
 
-            if (fix->hasHeight())
-            {
-                xml << "<height>"
-                    << fix->height
-                    << "</height>";
-            }
+        if (fix->hasBearing())
+        {
+            out.literal("<bearing>");
+            out.fixed(fix->bearing);
+            out.literal("</bearing>");
+        }
 
-            if (fix->hasSpeed())
-            {
-                xml << "<speed>"
-                    << fix->speed
-                    << "</speed>";
-            }
+        const long age = now.delta(fix->localTime);
+        if (age >= 0)
+        {
+            out.literal("<age>");
+            out.integer(age);
+            out.literal("</age>");
+        }
 
-            if (fix->hasBearing())
-            {
-                xml << "<bearing>"
-                    << fix->bearing
-                    << "</bearing>";
-            }
+        out.literal("</gps-location>");
+    }
+}
 
-            const long age = rhs.now.delta(fix->localTime);
-            if (age >= 0)
-                xml << "<age>"
-                    << age
-                    << "</age>";
+template <class Output>
+static void
+writeLocationRQ(Output& out,
+                const Timer& now,
+                const std::string& authentication,
+                const Scan& scan,
+                bool includeSsid)
+{
+    out.literal("<LocationRQ xmlns='");
+    out.string(Protocol::NAMESPACE_URI, strlen(Protocol::NAMESPACE_URI));
+    out.literal("' version='");
+    out.string(VERSION, strlen(VERSION));
+    out.literal("'>");
+
+    out.string(authentication.data(), authentication.size());
+    writeAccessPoints(out, now, scan.aps, includeSsid);
+    writeCellTowers(out, now, scan.cells);
+    writeGPSLocations(out, now, scan.gps);
+
+    out.literal("</LocationRQ>");
+}
 
-            xml << "</gps-location>";
-        }
+/**
+ * Size \c out exactly, reusing its capacity, and write into it.
+ */
+template <class Request>
+static void
+write(const Request& request, std::string& out)
+{
+    Sizer sizer;
+    request(sizer);
+
+    out.resize(sizer.getSize());
+    if (out.empty())
+        return;
+
+    Writer writer(&out[0]);
+    request(writer);
+
+    assert(writer.getEnd() == out.data() + out.size());
+}
 
-        return xml;
+struct AuthenticationRequest
+{
+    AuthenticationRequest(const char* key, const char* username)
+        : key(key)
+        , username(username)
+    {}
+
+    template <class Output>
+    void operator()(Output& out) const
+    {
+        writeAuthentication(out, key, username);
     }
 
-    const Timer& now;
-    const std::vector<GPSData::Fix>& fixes;
+    const char* key;
+    const char* username;
 };
 
-struct xLocationCommon
+struct LocationRequest
 {
-    xLocationCommon(const char* key,
-                    const char* username,
+    LocationRequest(const std::string& authentication,
                     const Scan& scan,
-                    const bool includeSsid)
-        : key(key)
-        , username(username)
+                    bool includeSsid)
+        : authentication(authentication)
         , scan(scan)
         , includeSsid(includeSsid)
     {}
 
-    friend std::string&
-    operator<<(std::string& xml, const xLocationCommon& rhs)
+    template <class Output>
+    void operator()(Output& out) const
     {
-        Timer now;
-        return xml << xAuthentication(rhs.key, rhs.username)
-                   << xAccessPoints(now, rhs.scan.aps, rhs.includeSsid)
-                   << xCellTowers(now, rhs.scan.cells)
-                   << xGPSLocations(now, rhs.scan.gps);
+        // Both passes must compute the same ages
+        writeLocationRQ(out, now, authentication, scan, includeSsid);
     }
 
-    const char* const key;
-    const char* const username;
+    const Timer now;
+    const std::string& authentication;
     const Scan& scan;
     const bool includeSsid;
 };
@@ -488,14 +650,28 @@ Protocol::locationRQ(const char* key,
                      std::string& out,
                      bool includeSsid)
 {
-    out.clear();
-    reserve(out, 256 + ADDR_LOOKUP_STR_SIZE + AUTH_STR_SIZE + size(scan, includeSsid));
-    out << "<LocationRQ "
-        << xVersion();
-
-    out << ">"
-        << xLocationCommon(key, username, scan, includeSsid)
-        << "</LocationRQ>";
+    std::string auth;
+    authentication(key, username, auth);
+    locationRQ(auth, scan, out, includeSsid);
+}
+
+/*static*/
+void
+Protocol::authentication(const char* key,
+                         const char* username,
+                         std::string& out)
+{
+    write(AuthenticationRequest(key, username), out);
+}
+
+/*static*/
+void
+Protocol::locationRQ(const std::string& authentication,
+                     const Scan& scan,
+                     std::string& out,
+                     bool includeSsid)
+{
+    write(LocationRequest(authentication, scan, includeSsid), out);
 }
 
 /**********************************************************************/
@@ -504,34 +680,31 @@ Protocol::locationRQ(const char* key,
 /*                                                                    */
 /**********************************************************************/
 
-static DOMNode*
-selectSingleNode(const DOMNode* parent, const std::string& localName)
+static DOMNodeRef
+selectSingleNode(const DOMNodeRef& parent, const char* localName)
 {
-    std::auto_ptr<DOMNodeList> nodes(parent->getChildNodes());
-    for (unsigned long i = 0; i < nodes->getLength(); ++i)
+    for (DOMNodeRef node = parent.getFirstChild();
+         ! node.isNull();
+         node = node.getNextSibling())
     {
-        DOMNode* node = nodes->getItem(i);
-        if (node->getNamespaceURI() == namespaceURI
-                && node->getLocalName() == localName)
+        if (node.isElement(Protocol::NAMESPACE_URI, localName))
             return node;
-
-        delete node;
     }
 
-    return NULL;
+    return DOMNodeRef();
 }
 
 static double
-parseDouble(const DOMNode* parent, const std::string& localName)
+parseDouble(const DOMNodeRef& parent, const char* localName)
 {
-    std::auto_ptr<DOMNode> node(selectSingleNode(parent, localName));
-    if (! node.get())
+    const DOMNodeRef node = selectSingleNode(parent, localName);
+    if (node.isNull())
         return 0.;
-    return SPI::atof(node->getNodeValue());
+    return SPI::atof(node.getText());
 }
 
 static void
-parseLatLon(const DOMNode* parent, double& latitude, double& longitude)
+parseLatLon(const DOMNodeRef& parent, double& latitude, double& longitude)
 {
     latitude = parseDouble(parent, "latitude");
     longitude = parseDouble(parent, "longitude");
@@ -545,16 +718,12 @@ parseLatLon(const DOMNode* parent, double& latitude, double& longitude)
 Protocol::parseErrorRS(const DOMDocument* doc,
                        std::string& error)
 {
-    std::auto_ptr<DOMNode> docElement(doc->getDocumentElement());
-    if (docElement.get() == NULL)
-        return false;
-
-    std::auto_ptr<DOMNode> errorElement(selectSingleNode(docElement.get(),
-                                                         "error"));
-    if (errorElement.get() == NULL)
+    const DOMNodeRef errorElement =
+        selectSingleNode(doc->getDocumentElementRef(), "error");
+    if (errorElement.isNull())
         return false;
 
-    error = errorElement->getNodeValue();
+    error = errorElement.getText();
     return true;
 }
 
@@ -570,32 +739,31 @@ Protocol::parseLocationRS(const DOMDocument* doc,
     if (doc == NULL)
         return false;
 
-    std::auto_ptr<DOMNode> docElement(doc->getDocumentElement());
-    if (docElement.get() == NULL)
+    const DOMNodeRef docElement = doc->getDocumentElementRef();
+    if (docElement.isNull())
     {
         // don't check for hasErrorNode()
         // it's redundant
         return false;
     }
 
-    std::auto_ptr<DOMNodeList> nodes(docElement.get()->getChildNodes());
-    for (unsigned long i = 0; i < nodes->getLength(); ++i)
+    for (DOMNodeRef node = docElement.getFirstChild();
+         ! node.isNull();
+         node = node.getNextSibling())
     {
-        std::auto_ptr<DOMNode> node(nodes->getItem(i));
-        if (node->getNamespaceURI() == namespaceURI
-                && node->getLocalName() == "location")
+        if (node.isElement(NAMESPACE_URI, "location"))
         {
             LiteLocation location;
 
-            location.hpe = parseDouble(node.get(), "hpe");
-            location.nap = SPI::atoi(node->getAttributeNS("", "nap"));
-            location.nsat = SPI::atoi(node->getAttributeNS("", "nsat"));
-            location.ncell = SPI::atoi(node->getAttributeNS("", "ncell"));
-            location.nlac = SPI::atoi(node->getAttributeNS("", "nlac"));
+            location.hpe = parseDouble(node, "hpe");
+            location.nap = SPI::atoi(node.getAttributeNS("", "nap"));
+            location.nsat = SPI::atoi(node.getAttributeNS("", "nsat"));
+            location.ncell = SPI::atoi(node.getAttributeNS("", "ncell"));
+            location.nlac = SPI::atoi(node.getAttributeNS("", "nlac"));
 
-            const unsigned long age = SPI::atoi(node->getAttributeNS("", "age"));
+            const unsigned long age = SPI::atoi(node.getAttributeNS("", "age"));
 
-            const long rqtime = SPI::atoi(node->getAttributeNS("", "rqtime"));
+            const long rqtime = SPI::atoi(node.getAttributeNS("", "rqtime"));
             if (rqtime > 0)
             {
                 // Note that if the time on the device where the token is
@@ -609,7 +777,7 @@ Protocol::parseLocationRS(const DOMDocument* doc,
 
             location.time.reset(age + timeDelta);
 
-            parseLatLon(node.get(), location.latitude, location.longitude);
+            parseLatLon(node, location.latitude, location.longitude);
 
             locations.push_back(location);
         }
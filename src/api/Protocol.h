@@ -31,6 +31,11 @@ namespace API {
 
 struct Protocol
 {
+    /**
+     * The namespace of requests and responses.
+     */
+    static const char* const NAMESPACE_URI;
+
     /**********************************************************************/
     /* Requests                                                           */
     /**********************************************************************/
@@ -41,6 +46,22 @@ struct Protocol
                            std::string& out,
                            bool includeSsid = true);
 
+    /**
+     * Serialize the <code>authentication</code> element of a request,
+     * so that it can be reused across requests.
+     */
+    static void authentication(const char* key,
+                               const char* username,
+                               std::string& out);
+
+    /**
+     * @param authentication as serialized by <code>authentication()</code>
+     */
+    static void locationRQ(const std::string& authentication,
+                           const Scan& scan,
+                           std::string& out,
+                           bool includeSsid = true);
+
     /**********************************************************************/
     /* Responses                                                          */
     /**********************************************************************/
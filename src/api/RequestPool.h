@@ -0,0 +1,155 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_REQUESTPOOL_H_
+#define WPS_API_REQUESTPOOL_H_
+
+#include "spi/Concurrent.h"
+#include "spi/XmlHttpRequest.h"
+
+#include <memory>
+#include <vector>
+
+namespace WPS {
+namespace API {
+
+/**
+ * Location requests kept between calls, already opened and
+ * with their headers set, so that they keep their connection
+ * and don't have to be set up again.
+ */
+class RequestPool
+{
+public:
+
+    explicit RequestPool(size_t maxIdle)
+        : _mutex(SPI::Mutex::newInstance())
+        , _maxIdle(maxIdle)
+    {}
+
+    ~RequestPool()
+    {
+        for (std::vector<SPI::XmlHttpRequest*>::iterator it = _idle.begin();
+             it != _idle.end();
+             ++it)
+        {
+            delete *it;
+        }
+    }
+
+    /**
+     * @return an idle request, or \c NULL if there is none.
+     */
+    SPI::XmlHttpRequest* acquire()
+    {
+        SPI::Guard guard(_mutex.get());
+
+        if (_idle.empty())
+            return NULL;
+
+        SPI::XmlHttpRequest* xhr = _idle.back();
+        _idle.pop_back();
+        return xhr;
+    }
+
+    /**
+     * Return a request to the pool, which takes ownership of it.
+     */
+    void release(SPI::XmlHttpRequest* xhr)
+    {
+        {
+            SPI::Guard guard(_mutex.get());
+
+            if (_idle.size() < _maxIdle)
+            {
+                _idle.push_back(xhr);
+                return;
+            }
+        }
+
+        delete xhr;
+    }
+
+private:
+
+    RequestPool(const RequestPool&);
+    RequestPool& operator=(const RequestPool&);
+
+private:
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    const size_t _maxIdle;
+    std::vector<SPI::XmlHttpRequest*> _idle;
+};
+
+/**
+ * A request borrowed from a \c RequestPool for the duration of a call.
+ */
+class PooledRequest
+{
+public:
+
+    PooledRequest(RequestPool& pool, SPI::XmlHttpRequest* xhr)
+        : _pool(pool)
+        , _xhr(xhr)
+    {}
+
+    ~PooledRequest()
+    {
+        if (_xhr != NULL)
+            _pool.release(_xhr);
+    }
+
+    /**
+     * Destroy the request instead of returning it to the pool,
+     * which is required once it has been aborted.
+     */
+    void discard()
+    {
+        delete _xhr;
+        _xhr = NULL;
+    }
+
+    SPI::XmlHttpRequest* get() const
+    {
+        return _xhr;
+    }
+
+    SPI::XmlHttpRequest* operator->() const
+    {
+        return _xhr;
+    }
+
+    SPI::XmlHttpRequest& operator*() const
+    {
+        return *_xhr;
+    }
+
+private:
+
+    PooledRequest(const PooledRequest&);
+    PooledRequest& operator=(const PooledRequest&);
+
+private:
+
+    RequestPool& _pool;
+    SPI::XmlHttpRequest* _xhr;
+};
+
+}
+}
+
+#endif
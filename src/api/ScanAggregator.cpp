@@ -0,0 +1,172 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ScanAggregator.h"
+
+#include <algorithm>
+
+namespace WPS {
+namespace API {
+
+using namespace WPS::SPI;
+
+static const unsigned long DEFAULT_MAX_AGE = 30 * 1000;
+
+ScanAggregator::ScanAggregator()
+    : _mutex(Mutex::newInstance())
+    , _scans(0)
+    , _maxAge(DEFAULT_MAX_AGE)
+    , _generation(0)
+    , _scanId(0)
+{}
+
+void
+ScanAggregator::setScans(unsigned long scans)
+{
+    Guard guard(_mutex.get());
+
+    _scans = scans;
+    if (_scans <= 1)
+    {
+        _aps.clear();
+        _cells.clear();
+    }
+}
+
+void
+ScanAggregator::setMaxAge(unsigned long maxAge)
+{
+    Guard guard(_mutex.get());
+    _maxAge = maxAge;
+}
+
+template <class Entry>
+bool
+ScanAggregator::isExpired(const Entry& entry) const
+{
+    return _generation - entry.generation >= _scans
+        || entry.getTimestamp().elapsed() > _maxAge;
+}
+
+/**
+ * Merge \c latest into \c window, which is sorted, keeping the newest
+ * observation of each access point or cell and dropping expired ones.
+ */
+template <class Entry>
+void
+ScanAggregator::merge(std::vector<Entry>& window,
+                      std::vector<Entry>& latest) const
+{
+    // The only sort, the window is sorted already
+    std::sort(latest.begin(), latest.end());
+
+    std::vector<Entry> merged;
+    merged.reserve(window.size() + latest.size());
+
+    typename std::vector<Entry>::const_iterator w = window.begin();
+    typename std::vector<Entry>::const_iterator l = latest.begin();
+
+    while (w != window.end() || l != latest.end())
+    {
+        const Entry* entry;
+        if (l == latest.end() || (w != window.end() && *w < *l))
+            entry = &*w++;
+        else
+            entry = &*l++;
+
+        if (isExpired(*entry))
+            continue;
+
+        // Same access point or cell, in both or twice in the latest scan
+        if (! merged.empty() && ! (merged.back() < *entry))
+        {
+            const unsigned long generation =
+                std::max(merged.back().generation, entry->generation);
+
+            if (entry->getTimestamp() > merged.back().getTimestamp())
+                merged.back() = *entry;
+
+            merged.back().generation = generation;
+            continue;
+        }
+
+        merged.push_back(*entry);
+    }
+
+    window.swap(merged);
+}
+
+void
+ScanAggregator::aggregate(Scan& scan, unsigned long scanId)
+{
+    Guard guard(_mutex.get());
+
+    if (_scans <= 1)
+        return;
+
+    // Concurrent requests share a scan, it only counts once
+    if (_generation == 0 || scanId != _scanId)
+    {
+        ++_generation;
+        _scanId = scanId;
+    }
+
+    std::vector<ApEntry> aps;
+    aps.reserve(scan.aps.size());
+    for (std::vector<ScannedAccessPoint>::const_iterator it = scan.aps.begin();
+         it != scan.aps.end();
+         ++it)
+    {
+        const ApEntry entry = { it->getMAC().toLong(), _generation, *it };
+        aps.push_back(entry);
+    }
+
+    std::vector<CellEntry> cells;
+    cells.reserve(scan.cells.size());
+    for (std::vector<ScannedCellTower>::const_iterator it = scan.cells.begin();
+         it != scan.cells.end();
+         ++it)
+    {
+        const CellEntry entry = { _generation, *it };
+        cells.push_back(entry);
+    }
+
+    merge(_aps, aps);
+    merge(_cells, cells);
+
+    // Each keeps the timestamp of when it was last seen,
+    // which the request reports as its age
+    scan.aps.clear();
+    scan.aps.reserve(_aps.size());
+    for (std::vector<ApEntry>::const_iterator it = _aps.begin();
+         it != _aps.end();
+         ++it)
+    {
+        scan.aps.push_back(it->ap);
+    }
+
+    scan.cells.clear();
+    scan.cells.reserve(_cells.size());
+    for (std::vector<CellEntry>::const_iterator it = _cells.begin();
+         it != _cells.end();
+         ++it)
+    {
+        scan.cells.push_back(it->cell);
+    }
+}
+
+}
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_SCANAGGREGATOR_H_
+#define WPS_API_SCANAGGREGATOR_H_
+
+#include "Wrappers.h"
+
+#include "spi/Concurrent.h"
+#include "spi/ScannedAccessPoint.h"
+#include "spi/ScannedCellTower.h"
+
+#include <memory>
+#include <vector>
+
+namespace WPS {
+namespace API {
+
+/**
+ * Merges the access points and cell towers of the last few scans.
+ * \n
+ * A single scan, especially on the move, misses some of the access
+ * points in range; those seen by the previous scans are sent along,
+ * with their age.
+ * \n
+ * The window is kept sorted so that adding a scan is a single merge
+ * pass over it, plus sorting the new scan.
+ */
+class ScanAggregator
+{
+public:
+
+    ScanAggregator();
+
+    /**
+     * Set the number of scans merged.
+     * \n
+     * \c 0 or \c 1 disables aggregation (the default).
+     */
+    void setScans(unsigned long scans);
+
+    /**
+     * Set the age, in milliseconds, beyond which
+     * an observation is no longer merged.
+     */
+    void setMaxAge(unsigned long maxAge);
+
+    /**
+     * Add the access points and cell towers of \c scan to the window,
+     * and replace them with those of the window.
+     *
+     * @param scanId identifies the Wi-Fi scan of \c scan: calls made
+     *               with the same one take a single place in the window.
+     */
+    void aggregate(Scan& scan, unsigned long scanId);
+
+private:
+
+    struct ApEntry
+    {
+        unsigned long long mac;     // packed, for cheap comparisons
+        unsigned long generation;   // of the last scan it was seen by
+        SPI::ScannedAccessPoint ap;
+
+        const SPI::Timer& getTimestamp() const
+        {
+            return ap.getTimestamp();
+        }
+
+        bool operator<(const ApEntry& that) const
+        {
+            return mac < that.mac;
+        }
+    };
+
+    struct CellEntry
+    {
+        unsigned long generation;
+        SPI::ScannedCellTower cell;
+
+        const SPI::Timer& getTimestamp() const
+        {
+            return cell.getTimestamp();
+        }
+
+        bool operator<(const CellEntry& that) const
+        {
+            return cell.getCell().compare(that.cell.getCell()) < 0;
+        }
+    };
+
+    template <class Entry>
+    void merge(std::vector<Entry>& window, std::vector<Entry>& latest) const;
+
+    template <class Entry>
+    bool isExpired(const Entry& entry) const;
+
+private:
+
+    ScanAggregator(const ScanAggregator&);
+    ScanAggregator& operator=(const ScanAggregator&);
+
+private:
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    unsigned long _scans;
+    unsigned long _maxAge;
+    unsigned long _generation;
+    unsigned long _scanId;      // of the scan of _generation
+    std::vector<ApEntry> _aps;
+    std::vector<CellEntry> _cells;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ScanCache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <string.h>
+
+namespace WPS {
+namespace API {
+
+using namespace WPS::SPI;
+
+/**
+ * Width of the RSSI buckets, in dBm.
+ * \n
+ * Wide enough to absorb the usual fluctuation between scans.
+ */
+static const int RSSI_QUANTUM = 10;
+
+static const size_t MAX_ENTRIES = 64;
+
+/**
+ * 64-bit FNV-1a
+ */
+class Fnv1a
+{
+public:
+
+    Fnv1a()
+        : _hash(14695981039346656037ULL)
+    {}
+
+    void update(const void* data, size_t size)
+    {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            _hash ^= p[i];
+            _hash *= 1099511628211ULL;
+        }
+    }
+
+    void update(long long value)
+    {
+        unsigned char bytes[8];
+        for (size_t i = 0; i < sizeof(bytes); ++i)
+            bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+        update(bytes, sizeof(bytes));
+    }
+
+    unsigned long long digest() const
+    {
+        return _hash;
+    }
+
+private:
+
+    unsigned long long _hash;
+};
+
+ScanCache::ScanCache()
+    : _mutex(Mutex::newInstance())
+    , _ttl(0)
+    , _hits(0)
+    , _misses(0)
+{}
+
+void
+ScanCache::setTtl(unsigned long ttl)
+{
+    Guard guard(_mutex.get());
+    _ttl = ttl;
+    if (_ttl == 0)
+        _entries.clear();
+}
+
+bool
+ScanCache::lookup(const char* key, const Scan& scan, LiteLocation& location)
+{
+    Guard guard(_mutex.get());
+
+    if (_ttl == 0 || ! scan.gps.empty())
+        return false;
+
+    Entries::const_iterator it = _entries.find(signature(key, scan));
+    if (it == _entries.end() || it->second.stored.elapsed() >= _ttl)
+    {
+        ++_misses;
+        return false;
+    }
+
+    // Keeps its original time, so that the age reported to the caller
+    // is that of the location returned by the server
+    location = it->second.location;
+    ++_hits;
+    return true;
+}
+
+void
+ScanCache::store(const char* key, const Scan& scan, const LiteLocation& location)
+{
+    Guard guard(_mutex.get());
+
+    if (_ttl == 0 || ! scan.gps.empty())
+        return;
+
+    prune();
+
+    Entry& entry = _entries[signature(key, scan)];
+    entry.location = location;
+    entry.stored.reset();
+}
+
+void
+ScanCache::prune()
+{
+    Entries::iterator oldest = _entries.end();
+
+    for (Entries::iterator it = _entries.begin(); it != _entries.end();)
+    {
+        if (it->second.stored.elapsed() >= _ttl)
+            _entries.erase(it++);
+        else
+        {
+            if (oldest == _entries.end() || it->second.stored < oldest->second.stored)
+                oldest = it;
+            ++it;
+        }
+    }
+
+    if (_entries.size() >= MAX_ENTRIES)
+        _entries.erase(oldest);
+}
+
+unsigned long long
+ScanCache::signature(const char* key, const Scan& scan)
+{
+    Fnv1a hash;
+    hash.update(key, strlen(key) + 1);
+
+    std::vector<std::pair<unsigned long long, int> > aps;
+    aps.reserve(scan.aps.size());
+    for (std::vector<ScannedAccessPoint>::const_iterator it = scan.aps.begin();
+         it != scan.aps.end();
+         ++it)
+    {
+        aps.push_back(std::make_pair(it->getMAC().toLong(),
+                                     -it->getRSSI() / RSSI_QUANTUM));
+    }
+
+    // Scans report access points in no particular order,
+    // and the same AP may be reported more than once
+    std::sort(aps.begin(), aps.end());
+    aps.erase(std::unique(aps.begin(), aps.end()), aps.end());
+
+    hash.update((long long) aps.size());
+    for (size_t i = 0; i < aps.size(); ++i)
+    {
+        hash.update((long long) aps[i].first);
+        hash.update((long long) aps[i].second);
+    }
+
+    std::vector<ScannedCellTower> cells(scan.cells);
+    std::sort(cells.begin(), cells.end(), ScannedCellTower::CellLess());
+
+    hash.update((long long) cells.size());
+    for (size_t i = 0; i < cells.size(); ++i)
+    {
+        const CellTower& cell = cells[i].getCell();
+        hash.update((long long) cell.getType());
+        hash.update((long long) cell.getMcc());
+        hash.update((long long) cell.getMnc());
+        hash.update((long long) cell.getCi());
+        hash.update((long long) cell.getLac());
+        hash.update((long long) cell.getTac());
+    }
+
+    return hash.digest();
+}
+
+}
+}
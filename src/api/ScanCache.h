@@ -0,0 +1,111 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_SCANCACHE_H_
+#define WPS_API_SCANCACHE_H_
+
+#include "Wrappers.h"
+
+#include "spi/Concurrent.h"
+#include "spi/Time.h"
+
+#include <map>
+#include <memory>
+
+namespace WPS {
+namespace API {
+
+/**
+ * Locations recently determined for a given scan signature.
+ * \n
+ * A stationary device keeps seeing the same access points at about
+ * the same strength, so the location determined for the last scan
+ * can be returned without asking the server again.
+ *
+ * @see signature()
+ */
+class ScanCache
+{
+public:
+
+    ScanCache();
+
+    /**
+     * Set how long a location stays valid, in milliseconds.
+     * \n
+     * \c 0 disables the cache (the default).
+     */
+    void setTtl(unsigned long ttl);
+
+    /**
+     * @return \c true if a location was cached for \c scan
+     *         and set in \c location.
+     */
+    bool lookup(const char* key, const Scan& scan, LiteLocation& location);
+
+    void store(const char* key, const Scan& scan, const LiteLocation& location);
+
+    unsigned long getHits() const
+    {
+        SPI::Guard guard(_mutex.get());
+        return _hits;
+    }
+
+    unsigned long getMisses() const
+    {
+        SPI::Guard guard(_mutex.get());
+        return _misses;
+    }
+
+    /**
+     * Canonical hash of a scan: its access points sorted by MAC
+     * with quantized RSSI, and its cell towers.
+     * \n
+     * GPS fixes aren't part of the signature;
+     * scans with fixes are never cached.
+     */
+    static unsigned long long signature(const char* key, const Scan& scan);
+
+private:
+
+    struct Entry
+    {
+        LiteLocation location;
+        SPI::Timer stored;
+    };
+
+    typedef std::map<unsigned long long, Entry> Entries;
+
+    void prune();
+
+private:
+
+    ScanCache(const ScanCache&);
+    ScanCache& operator=(const ScanCache&);
+
+private:
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    unsigned long _ttl;
+    Entries _entries;
+    unsigned long _hits;
+    unsigned long _misses;
+};
+
+}
+}
+
+#endif
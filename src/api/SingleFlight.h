@@ -0,0 +1,144 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_SINGLEFLIGHT_H_
+#define WPS_API_SINGLEFLIGHT_H_
+
+#include "spi/Concurrent.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace WPS {
+namespace API {
+
+/**
+ * Coalesces concurrent calls made with the same key:
+ * the first caller runs the call, and those that arrive
+ * while it's in progress wait for it and share its result.
+ */
+template <class Result>
+class SingleFlight
+{
+public:
+
+    SingleFlight()
+        : _mutex(SPI::Mutex::newInstance())
+    {}
+
+    /**
+     * Run <code>function()</code>, unless a call with the same \c key
+     * is already in progress, in which case wait for its result.
+     */
+    template <class Function>
+    Result call(const std::string& key, Function& function)
+    {
+        Flight* flight;
+        bool leader = false;
+        {
+            SPI::Guard guard(_mutex.get());
+
+            typename Flights::iterator it = _flights.find(key);
+            if (it != _flights.end())
+                flight = it->second;
+            else
+            {
+                flight = new Flight;
+                _flights[key] = flight;
+                leader = true;
+            }
+
+            ++flight->refs;
+        }
+
+        if (leader)
+        {
+            flight->result = function();
+
+            // Callers arriving from now on start a new flight
+            {
+                SPI::Guard guard(_mutex.get());
+                _flights.erase(key);
+            }
+
+            flight->done->signal();
+        }
+        else
+        {
+            // The leader's call is bounded by its own timeouts
+            int rc;
+            while ((rc = flight->done->wait(WAIT)) > 0)
+                ;
+
+            // Make the call after all rather than spin on a failing wait
+            if (rc < 0)
+            {
+                release(flight);
+                return function();
+            }
+        }
+
+        const Result result = flight->result;
+        release(flight);
+        return result;
+    }
+
+private:
+
+    struct Flight
+    {
+        Flight()
+            : done(SPI::Event::newInstance())
+            , refs(0)
+        {}
+
+        std::auto_ptr<SPI::Event> done;
+        Result result;
+        size_t refs;    // guarded by SingleFlight::_mutex
+    };
+
+    typedef std::map<std::string, Flight*> Flights;
+
+    void release(Flight* flight)
+    {
+        bool last;
+        {
+            SPI::Guard guard(_mutex.get());
+            last = --flight->refs == 0;
+        }
+
+        if (last)
+            delete flight;
+    }
+
+private:
+
+    SingleFlight(const SingleFlight&);
+    SingleFlight& operator=(const SingleFlight&);
+
+private:
+
+    static const unsigned long WAIT = 60 * 1000;
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    Flights _flights;
+};
+
+}
+}
+
+#endif
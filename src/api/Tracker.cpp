@@ -0,0 +1,87 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Tracker.h"
+#include "Context.h"
+
+#include "spi/Assert.h"
+
+namespace WPS {
+namespace API {
+
+using namespace WPS::SPI;
+
+Tracker::Tracker(Context& context,
+                 const char* key,
+                 unsigned long period,
+                 SHLC_LocationCallback callback,
+                 void* userData)
+    : _context(context)
+    , _key(key)
+    , _period(period)
+    , _callback(callback)
+    , _userData(userData)
+    , _stopEvent(Event::newInstance())
+{
+    // Otherwise requests would be made back to back
+    assert(period > 0);
+}
+
+Tracker::~Tracker()
+{
+    stop();
+}
+
+bool
+Tracker::start()
+{
+    _stopEvent->clear();
+    _thread.reset(JoinableThread::newInstance(this));
+    return _thread.get() != NULL;
+}
+
+void
+Tracker::stop()
+{
+    _stopEvent->signal();
+    _thread.reset();
+}
+
+void
+Tracker::run()
+{
+    do
+    {
+        const Timer started;
+
+        LiteLocation location;
+        const SHLC_ReturnCode rc = _context.location(_key.c_str(), location);
+
+        _callback(rc, rc == SHLC_OK ? (SHLC_Location*) location : NULL, _userData);
+
+        // The period is measured from the start of each request
+        const unsigned long elapsed = started.elapsed();
+        if (elapsed >= _period)
+            continue;
+
+        if (_stopEvent->wait(_period - elapsed) == 0)
+            break;
+    }
+    while (_stopEvent->wait(0) != 0);
+}
+
+}
+}
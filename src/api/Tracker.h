@@ -0,0 +1,93 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_TRACKER_H_
+#define WPS_API_TRACKER_H_
+
+#include "api/skyhookliteclient.h"
+
+#include "spi/Concurrent.h"
+#include "spi/Thread.h"
+
+#include <memory>
+#include <string>
+
+namespace WPS {
+namespace API {
+
+class Context;
+
+/**
+ * Periodically determines location on a dedicated thread
+ * and reports it to a callback.
+ */
+class Tracker
+    : private SPI::JoinableThread::Runnable
+{
+public:
+
+    Tracker(Context& context,
+            const char* key,
+            unsigned long period,
+            SHLC_LocationCallback callback,
+            void* userData);
+
+    /**
+     * @see stop()
+     */
+    ~Tracker();
+
+    /**
+     * Start the tracking thread.
+     *
+     * @return \c true if the thread was started.
+     */
+    bool start();
+
+    /**
+     * Stop the tracking thread.
+     * \n
+     * Returns once the callback has returned, if it was being called.
+     *
+     * @note Must not be called from the callback.
+     */
+    void stop();
+
+private:
+
+    void run();
+
+private:
+
+    Tracker(const Tracker&);
+    Tracker& operator=(const Tracker&);
+
+private:
+
+    Context& _context;
+    const std::string _key;
+    const unsigned long _period;
+    SHLC_LocationCallback _callback;
+    void* _userData;
+
+    std::auto_ptr<SPI::Event> _stopEvent;
+    std::auto_ptr<SPI::JoinableThread> _thread;
+};
+
+}
+}
+
+#endif
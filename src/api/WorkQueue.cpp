@@ -0,0 +1,141 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WorkQueue.h"
+
+#include "spi/Logger.h"
+
+namespace WPS {
+namespace API {
+
+using namespace WPS::SPI;
+
+/**
+ * Idle threads wait without a timeout: \c post() and \c shutdown()
+ * signal the event, which stays signaled once shut down.
+ */
+static const unsigned long WAIT_FOREVER = static_cast<unsigned long>(-1);
+
+WorkQueue::WorkQueue(size_t maxThreads)
+    : _maxThreads(maxThreads)
+    , _mutex(Mutex::newInstance())
+    , _event(Event::newInstance())
+    , _idle(0)
+    , _shutdown(false)
+    , _worker(*this)
+{}
+
+WorkQueue::~WorkQueue()
+{
+    shutdown();
+}
+
+bool
+WorkQueue::post(Task* task)
+{
+    Guard guard(_mutex.get());
+
+    if (_shutdown)
+        return false;
+
+    _tasks.push_back(task);
+
+    // Start another thread if the idle ones can't pick up everything queued
+    if (_idle < _tasks.size() && _threads.size() < _maxThreads)
+    {
+        JoinableThread* thread = JoinableThread::newInstance(&_worker);
+        if (thread != NULL)
+            _threads.push_back(thread);
+        else if (_threads.empty())
+        {
+            Logger("WPS.API.WorkQueue").error("failed to start a thread");
+            _tasks.pop_back();
+            return false;
+        }
+    }
+
+    _event->signal();
+    return true;
+}
+
+void
+WorkQueue::shutdown()
+{
+    std::deque<Task*> pending;
+    std::vector<JoinableThread*> threads;
+    {
+        Guard guard(_mutex.get());
+        _shutdown = true;
+        pending.swap(_tasks);
+        threads.swap(_threads);
+        _event->signal();
+    }
+
+    for (std::deque<Task*>::iterator it = pending.begin(); it != pending.end(); ++it)
+    {
+        (*it)->cancel();
+        delete *it;
+    }
+
+    for (std::vector<JoinableThread*>::iterator it = threads.begin(); it != threads.end(); ++it)
+    {
+        (*it)->join();
+        delete *it;
+    }
+}
+
+void
+WorkQueue::work()
+{
+    for (Task* task = take(); task != NULL; task = take())
+    {
+        task->run();
+        delete task;
+    }
+}
+
+WorkQueue::Task*
+WorkQueue::take()
+{
+    for (;;)
+    {
+        {
+            Guard guard(_mutex.get());
+
+            if (_shutdown)
+                return NULL;
+
+            if (! _tasks.empty())
+            {
+                Task* task = _tasks.front();
+                _tasks.pop_front();
+                return task;
+            }
+
+            // Cleared under the lock so a concurrent post() can't be missed
+            _event->clear();
+            ++_idle;
+        }
+
+        _event->wait(WAIT_FOREVER);
+
+        Guard guard(_mutex.get());
+        --_idle;
+    }
+}
+
+}
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_API_WORKQUEUE_H_
+#define WPS_API_WORKQUEUE_H_
+
+#include "spi/Concurrent.h"
+#include "spi/Thread.h"
+
+#include <memory>
+#include <deque>
+#include <vector>
+
+namespace WPS {
+namespace API {
+
+/**
+ * A pool of library-owned threads executing queued tasks.
+ *
+ * Threads are started on demand, up to \c maxThreads,
+ * so a handle that never makes asynchronous calls doesn't own any.
+ */
+class WorkQueue
+{
+public:
+
+    /**
+     * A unit of work.
+     */
+    class Task
+    {
+    public:
+
+        /**
+         * Execute the task on one of the queue's threads.
+         */
+        virtual void run() =0;
+
+        /**
+         * Called instead of \c run() if the queue is shut down
+         * before the task got to execute.
+         */
+        virtual void cancel()
+        {}
+
+        virtual ~Task()
+        {}
+    };
+
+public:
+
+    explicit WorkQueue(size_t maxThreads);
+
+    /**
+     * @see shutdown()
+     */
+    ~WorkQueue();
+
+    /**
+     * Queue a task for execution.
+     *
+     * @param task the task to execute.
+     *             \n
+     *             The queue takes ownership of the task if it's accepted.
+     *
+     * @return \c true if the task was accepted,
+     *         \c false if the queue is shutting down.
+     */
+    bool post(Task* task);
+
+    /**
+     * Cancel the tasks that haven't started yet,
+     * wait for the running ones to complete and stop the threads.
+     *
+     * @note Must not be called from a task.
+     */
+    void shutdown();
+
+private:
+
+    class Worker
+        : public SPI::JoinableThread::Runnable
+    {
+    public:
+
+        explicit Worker(WorkQueue& queue)
+            : _queue(queue)
+        {}
+
+        void run()
+        {
+            _queue.work();
+        }
+
+    private:
+
+        WorkQueue& _queue;
+    };
+
+    void work();
+
+    /**
+     * Block until a task is available.
+     *
+     * @return the next task or \c NULL if the queue is shutting down.
+     */
+    Task* take();
+
+private:
+
+    WorkQueue(const WorkQueue&);
+    WorkQueue& operator=(const WorkQueue&);
+
+private:
+
+    const size_t _maxThreads;
+
+    std::auto_ptr<SPI::Mutex> _mutex;
+    std::auto_ptr<SPI::Event> _event;   // signaled when tasks are queued
+
+    std::deque<Task*> _tasks;
+    std::vector<SPI::JoinableThread*> _threads;
+    size_t _idle;
+    bool _shutdown;
+
+    Worker _worker;
+};
+
+}
+}
+
+#endif
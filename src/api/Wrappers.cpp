@@ -16,6 +16,7 @@
 
 #include "Wrappers.h"
 
+#include <algorithm>
 #include <cstring>
 
 #include "spi/StdLibC.h"
@@ -37,6 +38,91 @@ convertSpeed(double speed, double f)
     return speed * f;
 }
 
+static SPI::Timer
+timestampFromAge(unsigned long age, const SPI::Timer& now)
+{
+    SPI::Timer timestamp;
+    timestamp.reset(age, now);
+    return timestamp;
+}
+
+static SPI::CellTower
+toCellTower(const SHLC_CellTower& cell)
+{
+    switch (cell.type)
+    {
+        case SHLC_CELL_TYPE_GSM:
+            return SPI::CellTower::GSMTower(cell.mcc, cell.mnc, cell.ci, cell.lac);
+        case SHLC_CELL_TYPE_UMTS:
+            return SPI::CellTower::UMTSTower(cell.mcc, cell.mnc, cell.ci, cell.lac);
+        case SHLC_CELL_TYPE_LTE:
+            return SPI::CellTower::LTETower(cell.mcc, cell.mnc, cell.ci, cell.lac);
+        default:
+            return SPI::CellTower();
+    }
+}
+
+Scan::Scan(const SHLC_Scan& scan)
+{
+    const SPI::Timer now;
+
+    aps.reserve(scan.naps);
+    for (unsigned int i = 0; i < scan.naps; ++i)
+    {
+        const SHLC_AccessPoint& ap = scan.aps[i];
+
+        // SHLC_AccessPoint::mac is in transmission order
+        SPI::MAC::raw_type mac;
+        std::reverse_copy(ap.mac, ap.mac + sizeof(mac), mac);
+
+        SPI::ScannedAccessPoint::SSID ssid;
+        if (ap.ssid != NULL)
+            ssid.assign(ap.ssid, ap.ssid + ap.ssid_length);
+
+        aps.push_back(SPI::ScannedAccessPoint(SPI::MAC(mac),
+                                              ap.rssi,
+                                              timestampFromAge(ap.age, now),
+                                              ssid));
+    }
+
+    cells.reserve(scan.ncells);
+    for (unsigned int i = 0; i < scan.ncells; ++i)
+    {
+        const SHLC_CellTower& cell = scan.cells[i];
+
+        const SPI::CellTower tower = toCellTower(cell);
+        if (! tower)
+            continue;
+
+        const short rssi = std::max<short>(-255, std::min<short>(0, cell.rssi));
+        cells.push_back(SPI::ScannedCellTower(tower,
+                                              cell.timing_advance,
+                                              rssi,
+                                              timestampFromAge(cell.age, now)));
+    }
+
+    gps.reserve(scan.ngps);
+    for (unsigned int i = 0; i < scan.ngps; ++i)
+    {
+        const SHLC_GPSFix& fix = scan.gps[i];
+
+        SPI::GPSData::Fix gpsFix;
+        gpsFix.quality = 1;
+        gpsFix.latitude = fix.latitude;
+        gpsFix.longitude = fix.longitude;
+        gpsFix.hpe = static_cast<float>(fix.hpe);
+        if (fix.has_altitude)
+            gpsFix.altitude = fix.altitude;
+        if (fix.speed >= 0)
+            gpsFix.speed = convertSpeed(fix.speed, KMH_TO_MS);
+        if (fix.bearing >= 0)
+            gpsFix.bearing = fix.bearing;
+        gpsFix.svInFix = fix.nsat;
+        gpsFix.localTime = timestampFromAge(fix.age, now);
+        gps.push_back(gpsFix);
+    }
+}
+
 LiteLocation::operator SHLC_Location*() const
 {
     SHLC_Location* location = new SHLC_Location;
@@ -38,6 +38,16 @@ struct Scan
     std::vector<SPI::ScannedAccessPoint> aps;
     std::vector<SPI::ScannedCellTower> cells;
     std::vector<SPI::GPSData::Fix> gps;
+
+    Scan()
+    {}
+
+    /**
+     * Convert a scan supplied through \c SHLC_location_from_scan().
+     * \n
+     * Invalid cell towers are dropped.
+     */
+    explicit Scan(const SHLC_Scan& scan);
 };
 
 /**
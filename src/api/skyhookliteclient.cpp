@@ -16,414 +16,229 @@
 
 #include "api/skyhookliteclient.h"
 
-#include "spi/WifiAdapter.h"
-#include "spi/CellAdapter.h"
-#include "spi/GPSAdapter.h"
-#include "spi/XmlHttpRequest.h"
-#include "spi/Concurrent.h"
-#include "spi/Logger.h"
-#include "spi/Time.h"
-#include "spi/DOM.h"
-#include "spi/XmlParser.h"
-#include "spi/SystemInformation.h"
-
-#include "Protocol.h"
-#include "XmlUtils.h"
+#include "Context.h"
+#include "Wrappers.h"
 #include "version.h"
 
-#include <md4.h>
-#include <memory>
-#include <vector>
-#include <algorithm>
+#include <new>
 
-using namespace WPS::SPI;
 using namespace WPS::API;
 
-static const unsigned TIMEOUT = 20 * 1000;
-
-class WifiWrapper
-    : public WifiAdapter::Listener
-{
-public:
-
-	WifiWrapper()
-	    : _event(Event::newInstance())
-        , _rc(SPI_ERROR_NOT_READY)
-	{}
-
-	ErrorCode open()
-	{
-		_wifi.reset(WifiAdapter::newInstance());
-		if (_wifi.get() == NULL)
-            return SPI_ERROR;
-        _wifi->setListener(this);
-		return _wifi->open();
-	}
-
-    void close()
-    {
-        _wifi.reset();
-    }
-
-	ErrorCode scan(unsigned long timeout,
-                   std::vector<ScannedAccessPoint>& scannedAPs)
-	{
-        if (_wifi.get() == NULL)
-            return SPI_ERROR;
-
-        _event->clear();
-        _wifi->startScan();
-
-        if (_event->wait(timeout) != 0)
-            return SPI_ERROR;
-
-        if (_rc != SPI_OK)
-            return _rc;
-
-        scannedAPs = _scan;
-        return SPI_OK;
-	}
-
-    std::string getHardwareMAC()
-    {
-        MAC mac;
-        if (_wifi->getHardwareMAC(mac) != SPI_OK)
-            return "";
-        if (mac.toLong() == 0)
-            return "";
-        return mac.toString();
-    }
-
-private:
-
-    void onScanCompleted(const std::vector<ScannedAccessPoint>& scannedAPs)
-    {
-        _rc = SPI_OK;
-    	_scan = scannedAPs;
-        _event->signal();
-    }
-
-    void onScanFailed(ErrorCode code)
-    {
-        _rc = code;
-        _scan.clear();
-        _event->signal();
-    }
-
-private:
-
-	std::auto_ptr<WifiAdapter> _wifi;
-    std::auto_ptr<Event> _event;
-    ErrorCode _rc;
-    std::vector<ScannedAccessPoint> _scan;
-};
-
-class GpsWrapper
-    : public GPSAdapter::Listener
-{
-public:
-
-	GpsWrapper()
-        : _mutex(Mutex::newInstance())
-	{}
-
-	ErrorCode open()
-	{
-		_gps.reset(GPSAdapter::newInstance());
-		if (_gps.get() == NULL)
-            return SPI_ERROR;
-        _gps->setListener(this);
-		return _gps->open();
-	}
-
-    void close()
-    {
-        _gps.reset();
-    }
-
-    const std::vector<GPSData::Fix>& getFixes()
-    {
-        Guard guard(_mutex.get());
-        return _fixes;
-    }
-
-private:
-
-    void onGpsData(const GPSData& gpsData)
-    {
-        Guard guard(_mutex.get());
-
-        if (gpsData.fix.get())
-        {
-            const GPSData::Fix newFix = *gpsData.fix;
-
-            if (_fixes.empty() || _fixes.back().gpsTime != newFix.gpsTime)
-                _fixes.push_back(newFix);
-        }
-    }
-
-    void onGpsError(ErrorCode)
-    {}
-
-private:
-
-    std::auto_ptr<Mutex> _mutex;
-	std::auto_ptr<GPSAdapter> _gps;
-    std::vector<GPSData::Fix> _fixes;
-};
-
-class CellWrapper
-    : public CellAdapter::Listener
-{
-public:
-
-	CellWrapper()
-        : _mutex(Mutex::newInstance())
-	{}
-
-	ErrorCode open()
-	{
-		_cellAdapter.reset(CellAdapter::newInstance());
-		if (_cellAdapter.get() == NULL)
-            return SPI_ERROR;
-        _cellAdapter->setListener(this);
-		return _cellAdapter->open();
-	}
-
-    const std::vector<ScannedCellTower>& getScannedCells()
-    {
-        Guard guard(_mutex.get());
-        return _scannedCells;
-    }
-
-    std::string getIMEI()
-    {
-        Guard guard(_mutex.get());
-        if (_cellAdapter.get() == NULL)
-            return "";
-        std::string imei;
-        if (_cellAdapter->getIMEI(imei) != SPI_OK)
-            return "";
-        return imei;
-    }
-
-private:
-
-    void onCellChanged(const std::vector<ScannedCellTower>& scannedCells)
-    {
-        Guard guard(_mutex.get());
-        _scannedCells = scannedCells;
-    }
-
-    void onCellError(ErrorCode)
-    {}
-
-private:
-
-    std::auto_ptr<Mutex> _mutex;
-	std::auto_ptr<CellAdapter> _cellAdapter;
-    std::vector<ScannedCellTower> _scannedCells;
-};
-
-std::string
-md4(const std::string& input)
+const char*
+SHLC_version()
 {
-    unsigned char digest[16];
-
-    WPS_MD4_CTX ctx;
-    WPS_MD4Init(&ctx);
-    WPS_MD4Update(&ctx, (unsigned char*) input.c_str(), (unsigned int) input.length());
-    WPS_MD4Final(digest, &ctx);
-
-    char buf[64];
-    WPS::SPI::snprintf(buf,
-                       sizeof(buf),
-                       "%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x",
-                       digest[0],
-                       digest[1],
-                       digest[2],
-                       digest[3],
-                       digest[4],
-                       digest[5],
-                       digest[6],
-                       digest[7],
-                       digest[8],
-                       digest[9],
-                       digest[10],
-                       digest[11],
-                       digest[12],
-                       digest[13],
-                       digest[14],
-                       digest[15]);
-    return buf;
+	return SHLC_VERSION;
 }
 
-inline bool
-isNotValidForMeta(char c)
+void*
+SHLC_init()
 {
-    // ASCII non-printable characters or semicolon
-    // (since it acts as a delimiter).
-    return c < 32 || c > 126 || c == ';';
+    Context* context = new (std::nothrow) Context;
+    if (context == NULL)
+        return NULL;
+
+    // Open the adapters upfront so that the first location request
+    // doesn't have to wait for them (and GPS can start acquiring a fix).
+    context->open();
+    return context;
 }
 
-inline bool
-isValidForMeta(const std::string& s)
+void
+SHLC_deinit(const void* handle)
 {
-    return std::find_if(s.begin(), s.end(), isNotValidForMeta) == s.end();
+    delete Context::fromHandle(handle);
 }
 
-inline std::string
-validateForMeta(const std::string& s)
+SHLC_ReturnCode
+SHLC_location(const void* handle,
+			  const char* key,
+              SHLC_Location** location)
 {
-    return isValidForMeta(s) ? s : "";
+    if (handle == NULL || key == NULL || location == NULL)
+        return SHLC_ERROR;
+
+    LiteLocation liteLocation;
+    const SHLC_ReturnCode rc =
+        Context::fromHandle(handle)->location(key, liteLocation);
+    if (rc != SHLC_OK)
+        return rc;
+
+    *location = liteLocation;
+    return SHLC_OK;
 }
 
-static std::string
-getDeviceUsername(WifiWrapper& wifi, CellWrapper& cell)
+SHLC_ReturnCode
+SHLC_location_with_deadline(const void* handle,
+                            const char* key,
+                            unsigned long deadline,
+                            SHLC_Location** location)
 {
-    const std::string mac = wifi.getHardwareMAC();
-    if (! mac.empty())
-        return md4(mac);
+    if (handle == NULL || key == NULL || deadline == 0 || location == NULL)
+        return SHLC_ERROR;
 
-    const std::string imei = cell.getIMEI();
-    if (! imei.empty())
-        return md4(imei);
+    LiteLocation liteLocation;
+    const SHLC_ReturnCode rc =
+        Context::fromHandle(handle)->locationWithDeadline(key, deadline, liteLocation);
+    if (rc != SHLC_OK)
+        return rc;
 
-    return "";
+    *location = liteLocation;
+    return SHLC_OK;
 }
 
-static std::string
-getMetaString()
+SHLC_ReturnCode
+SHLC_location_from_scan(const void* handle,
+                        const char* key,
+                        const SHLC_Scan* scan,
+                        SHLC_Location** location)
 {
-    std::string meta;
-    meta.reserve(64);
-
-    SystemInformation::OSInfo osInfo;
-    SystemInformation::DeviceInfo deviceInfo;
-
-    std::auto_ptr<SystemInformation> sysInfo(SystemInformation::newInstance());
-    if (sysInfo.get())
-    {
-        sysInfo->getOSInfo(osInfo);
-        sysInfo->getDeviceInfo(deviceInfo);
-    }
-
-    meta.append("1;shlc;")
-        .append(SHLC_VERSION)
-        .append(";")
-        .append(validateForMeta(osInfo.type))
-        .append(";")
-        .append(validateForMeta(osInfo.version))
-        .append(";")
-        .append(validateForMeta(deviceInfo.manufacturer))
-        .append(";")
-        .append(validateForMeta(deviceInfo.model));
-
-    return meta;
+    if (handle == NULL || key == NULL || scan == NULL || location == NULL)
+        return SHLC_ERROR;
+
+    LiteLocation liteLocation;
+    const SHLC_ReturnCode rc =
+        Context::fromHandle(handle)->locationFromScan(key,
+                                                      Scan(*scan),
+                                                      scan->username,
+                                                      liteLocation);
+    if (rc != SHLC_OK)
+        return rc;
+
+    *location = liteLocation;
+    return SHLC_OK;
 }
 
-static SHLC_ReturnCode
-getLocation(const char* key,
-            const char* username,
-            const Scan& scan,
-            SHLC_Location** location)
+SHLC_ReturnCode
+SHLC_location_batch(const void* handle,
+                    const char* key,
+                    const SHLC_Scan* scans,
+                    unsigned int count,
+                    SHLC_ReturnCode* rcs,
+                    SHLC_Location** locations)
 {
-    std::string rq;
-    Protocol::locationRQ(key, username, scan, rq);
+    if (handle == NULL || key == NULL)
+        return SHLC_ERROR;
 
-    std::auto_ptr<XmlHttpRequest> xhr(XmlHttpRequest::newInstance());
+    if (count != 0 && (scans == NULL || rcs == NULL || locations == NULL))
+        return SHLC_ERROR;
 
-    xhr->open(XmlHttpRequest::HTTP_POST, "https://api.skyhookwireless.com/wps2/location");
-    xhr->setRequestHeader("Content-Type", "text/xml");
-    xhr->setRequestHeader("Skyhook-Meta", getMetaString());
+    Context::fromHandle(handle)->locationBatch(key, scans, count, rcs, locations);
+    return SHLC_OK;
+}
 
-    ErrorCode code = xhr->send(rq);
-    if (code != SPI_OK)
-        return SHLC_ERROR_SERVER_UNAVAILABLE;
+SHLC_ReturnCode
+SHLC_location_async(const void* handle,
+                    const char* key,
+                    SHLC_LocationCallback callback,
+                    void* user_data)
+{
+    if (handle == NULL || key == NULL || callback == NULL)
+        return SHLC_ERROR;
 
-    switch (xhr->getStatusCode())
-    {
-        case XmlHttpRequest::OK:
-            break;
-        case XmlHttpRequest::UNAUTHORIZED:
-            return SHLC_ERROR_UNAUTHORIZED;
-        default:
-            return SHLC_ERROR_SERVER_UNAVAILABLE;
-    }
+    return Context::fromHandle(handle)->locationAsync(key, callback, user_data);
+}
 
-    const std::string rs = xhr->getResponseData();
+SHLC_ReturnCode
+SHLC_location_queued(const void* handle,
+                     const char* key,
+                     void* user_data)
+{
+    if (handle == NULL || key == NULL)
+        return SHLC_ERROR;
 
-    std::auto_ptr<XmlParser> parser(XmlParser::newInstance());
-    std::auto_ptr<DOMDocument> doc(parser->parse(rs.data(), rs.size()));
-    if (! doc.get())
-        return SHLC_ERROR_LOCATION_CANNOT_BE_DETERMINED;
+    return Context::fromHandle(handle)->locationQueued(key, user_data);
+}
 
-    std::vector<LiteLocation> locations;
-    if (! Protocol::parseLocationRS(doc.get(), 0, locations))
-        return SHLC_ERROR_LOCATION_CANNOT_BE_DETERMINED;
+SHLC_ReturnCode
+SHLC_next_completion(const void* handle,
+                     unsigned long timeout,
+                     void** user_data,
+                     SHLC_ReturnCode* rc,
+                     SHLC_Location** location)
+{
+    if (handle == NULL || user_data == NULL || rc == NULL || location == NULL)
+        return SHLC_ERROR;
 
-    if (locations.empty())
-        return SHLC_ERROR_LOCATION_CANNOT_BE_DETERMINED;
+    CompletionQueue::Completion completion;
+    if (! Context::fromHandle(handle)->nextCompletion(timeout, completion))
+        return SHLC_ERROR_TIMEOUT;
 
-    *location = locations.front();
+    *user_data = completion.userData;
+    *rc = completion.rc;
+    *location = completion.rc == SHLC_OK ? (SHLC_Location*) completion.location : NULL;
     return SHLC_OK;
 }
 
-const char*
-SHLC_version()
+SHLC_ReturnCode
+SHLC_start_tracking(const void* handle,
+                    const char* key,
+                    unsigned long period,
+                    SHLC_LocationCallback callback,
+                    void* user_data)
 {
-	return SHLC_VERSION;
-}
+    if (handle == NULL || key == NULL || period == 0 || callback == NULL)
+        return SHLC_ERROR;
 
-void*
-SHLC_init()
-{
-    /*
-     * This is a placeholder to allow the API to easily add global data
-     */
-    return (void*) 0x1;
+    return Context::fromHandle(handle)->startTracking(key, period, callback, user_data);
 }
 
 void
-SHLC_deinit(const void* handle)
-{}
+SHLC_stop_tracking(const void* handle)
+{
+    if (handle == NULL)
+        return;
+
+    Context::fromHandle(handle)->stopTracking();
+}
 
 SHLC_ReturnCode
-SHLC_location(const void* handle,
-			  const char* key,
-              SHLC_Location** location)
+SHLC_set_option(const void* handle,
+                SHLC_Option option,
+                unsigned long value)
 {
-	WifiWrapper wifi;
-    CellWrapper cell;
-    GpsWrapper gps;
-    Scan scan;
+    if (handle == NULL)
+        return SHLC_ERROR;
 
-    gps.open();
-    cell.open();
+    return Context::fromHandle(handle)->setOption(option, value);
+}
 
-	if (wifi.open() != SPI_OK)
-		return SHLC_ERROR_RADIO_NOT_AVAILABLE;
+SHLC_ReturnCode
+SHLC_get_statistics(const void* handle,
+                    SHLC_Statistics* statistics)
+{
+    if (handle == NULL || statistics == NULL)
+        return SHLC_ERROR;
 
-    const std::string username = getDeviceUsername(wifi, cell);
-    if (username.empty())
-        return SHLC_ERROR_UNAUTHORIZED;
+    Context::fromHandle(handle)->getStatistics(*statistics);
+    return SHLC_OK;
+}
 
-    if (wifi.scan(TIMEOUT, scan.aps) != SPI_OK)
-        return SHLC_ERROR_RADIO_NOT_AVAILABLE;
+SHLC_ReturnCode
+SHLC_set_server_url(const void* handle,
+                    const char* url)
+{
+    if (handle == NULL || url == NULL || *url == '\0')
+        return SHLC_ERROR;
 
-    /*
-     * Wi-Fi scan completed
-     */
-    scan.gps = gps.getFixes();
-    scan.cells = cell.getScannedCells();
+    Context::fromHandle(handle)->setServerUrl(url);
+    return SHLC_OK;
+}
 
-    if (scan.aps.empty() && scan.cells.empty() && scan.gps.empty())
-        return SHLC_ERROR_NO_BEACONS_IN_RANGE;
+SHLC_ReturnCode
+SHLC_set_compression_dictionary(const void* handle,
+                                const void* dictionary,
+                                unsigned long size)
+{
+    if (handle == NULL || (dictionary == NULL && size > 0))
+        return SHLC_ERROR;
+
+    const std::string data =
+        dictionary == NULL
+            ? std::string()
+            : std::string(static_cast<const char*>(dictionary), size);
 
-    /*
-     * Determine location remotely
-     */
-    return getLocation(key, username.c_str(), scan, location);
+    Context::fromHandle(handle)->setCompressionDictionary(data);
+    return SHLC_OK;
 }
 
 void
@@ -38,5 +38,67 @@ Thread::id()
 #endif
 }
 
+/*********************************************************************/
+/* PthreadJoinableThread                                             */
+/*********************************************************************/
+
+class PthreadJoinableThread
+    : public JoinableThread
+{
+public:
+
+    PthreadJoinableThread()
+        : _joined(true)
+    {}
+
+    ~PthreadJoinableThread()
+    {
+        join();
+    }
+
+    bool start(Runnable* runnable)
+    {
+        if (pthread_create(&_thread, NULL, threadProc, runnable) != 0)
+            return false;
+
+        _joined = false;
+        return true;
+    }
+
+    void join()
+    {
+        if (_joined)
+            return;
+
+        pthread_join(_thread, NULL);
+        _joined = true;
+    }
+
+private:
+
+    static void* threadProc(void* arg)
+    {
+        reinterpret_cast<Runnable*>(arg)->run();
+        return NULL;
+    }
+
+private:
+
+    pthread_t _thread;
+    bool _joined;
+};
+
+JoinableThread*
+JoinableThread::newInstance(Runnable* runnable)
+{
+    PthreadJoinableThread* thread = new PthreadJoinableThread;
+    if (! thread->start(runnable))
+    {
+        delete thread;
+        return NULL;
+    }
+    return thread;
+}
+
 }
 }
@@ -31,28 +31,26 @@
  *
  * @param     FROM The base type of the src array
  * @param     TO   The base type of the dest array
- * @param[in] from_charset The charset of the src array
- * @param[in] to_charset   The charset of the dest array
+ * @param[in] converter    From the charset of the src array to the one
+ *                         of the dest array, as returned by iconv_open().
+ *                         It's reset, and left open for the next call.
  * @param[in] src          The src array
  * @param[in] src_size     The # of elements in src, n/i terminating 0
- * @return    an allocated array of TO, caller responsible for delete
+ * @return    the converted string, empty if src can't be converted
  */
 template <typename FROM, typename TO>
-std::basic_string<TO> iconvert(const char* from_charset,
-                               const char* to_charset,
+std::basic_string<TO> iconvert(iconv_t converter,
                                const FROM* src,
                                size_t src_size)
 {
     const size_t  dest_bytes = (src_size + 2) * 4; //worst case, with room for leading byte order & trailing \0
     const size_t  src_bytes  = (src_size + 1) * sizeof(FROM);
 
-    iconv_t       converter  = iconv_open(to_charset, from_charset);
-
-    if (converter == (iconv_t)(-1))
-        return std::basic_string<TO>();
+    // converted in place, rather than copied from a buffer
+    std::basic_string<TO> to;
+    to.resize(dest_bytes / sizeof(TO) + 1);
 
-    char  outbuf[dest_bytes];
-    char* outptr            = outbuf;
+    char* outptr            = reinterpret_cast<char*>(&to[0]);
 #if HAVE_ICONV_WITH_CONST_INPUT
     const char* inptr       = reinterpret_cast<const char*>(src);
 #else
@@ -67,16 +65,33 @@ std::basic_string<TO> iconvert(const char* from_charset,
     // convert (remember, ret value is # of irreversable conversions)
     size_t nconv = iconv(converter, &inptr, &inleft, &outptr, &outleft);
 
-    iconv_close(converter);
-
     if (nconv == (size_t)(-1))
         return std::basic_string<TO>();
 
-    const size_t to_length = (dest_bytes - outleft) / sizeof(TO) - 1;
-    std::basic_string<TO> to;
-    to.resize(to_length);
-    for(size_t i = 0; i < to_length; i++)
-        to[i] = reinterpret_cast<TO*>(outbuf)[i];
+    to.resize((dest_bytes - outleft) / sizeof(TO) - 1);
+    return to;
+}
+
+/**
+ * Same as above, opening and closing a converter for this call only.
+ *
+ * @param[in] from_charset The charset of the src array
+ * @param[in] to_charset   The charset of the dest array
+ */
+template <typename FROM, typename TO>
+std::basic_string<TO> iconvert(const char* from_charset,
+                               const char* to_charset,
+                               const FROM* src,
+                               size_t src_size)
+{
+    iconv_t       converter  = iconv_open(to_charset, from_charset);
+
+    if (converter == (iconv_t)(-1))
+        return std::basic_string<TO>();
+
+    std::basic_string<TO> to = iconvert<FROM, TO>(converter, src, src_size);
+
+    iconv_close(converter);
     return to;
 }
 
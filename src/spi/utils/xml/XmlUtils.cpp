@@ -21,45 +21,198 @@
 #include <stdint.h>
 #include <limits>
 
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#endif
+
 #include "spi/Assert.h"
 
 namespace WPS {
 namespace API {
 
+/***************************************************************************/
+/* Blocks                                                                  */
+/***************************************************************************/
+
+/*
+ * Where SIMD instructions are available, the leading characters that need
+ * no special treatment are skipped 16 at a time, and the scalar code only
+ * runs from the first block that has one. SSIDs are 32 bytes at most, so
+ * a shorter tail is copied to a padded block rather than left to the
+ * scalar code.
+ */
+
+#if defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define WPS_XML_UTILS_BLOCKS
+#endif
+
+#ifdef WPS_XML_UTILS_BLOCKS
+
+static const size_t BLOCK_SIZE = 16;
+
+#if defined(__SSE2__)
+
+/**
+ * @return \c true if all 16 characters at \c p are printable ASCII.
+ */
+static inline bool
+isPrintableAsciiBlock(const unsigned char* p)
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    // Signed comparison: bytes from 0x80 are negative
+    return _mm_movemask_epi8(_mm_cmplt_epi8(v, _mm_set1_epi8(0x20))) == 0;
+}
+
+/**
+ * @return \c true if none of the 16 characters at \c p is to be escaped.
+ */
+static inline bool
+isUnescapedBlock(const unsigned char* p)
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i special =
+        _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('&')),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8('"'))),
+            _mm_or_si128(
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('<')),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8('>')))));
+    return _mm_movemask_epi8(special) == 0;
+}
+
+#else
+
+static inline bool
+isZero(uint8x16_t v)
+{
+#if defined(__aarch64__)
+    return vmaxvq_u8(v) == 0;
+#else
+    uint8x8_t m = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+    m = vpmax_u8(m, m);
+    m = vpmax_u8(m, m);
+    m = vpmax_u8(m, m);
+    return vget_lane_u8(m, 0) == 0;
+#endif
+}
+
+/**
+ * @return \c true if all 16 characters at \c p are printable ASCII.
+ */
+static inline bool
+isPrintableAsciiBlock(const unsigned char* p)
+{
+    const uint8x16_t v = vld1q_u8(p);
+    return isZero(vorrq_u8(vcltq_u8(v, vdupq_n_u8(0x20)),
+                           vcgeq_u8(v, vdupq_n_u8(0x80))));
+}
+
+/**
+ * @return \c true if none of the 16 characters at \c p is to be escaped.
+ */
+static inline bool
+isUnescapedBlock(const unsigned char* p)
+{
+    const uint8x16_t v = vld1q_u8(p);
+    return isZero(
+        vorrq_u8(
+            vorrq_u8(vceqq_u8(v, vdupq_n_u8('&')),
+                     vceqq_u8(v, vdupq_n_u8('"'))),
+            vorrq_u8(
+                vceqq_u8(v, vdupq_n_u8('\'')),
+                vorrq_u8(vceqq_u8(v, vdupq_n_u8('<')),
+                         vceqq_u8(v, vdupq_n_u8('>'))))));
+}
+
+#endif
+
+/**
+ * @return the number of leading characters of \c s for which
+ *         \c isBlock() holds, rounded down to a block, or \c size.
+ *
+ * @param pad a character for which it holds, to fill a shorter tail.
+ */
+static inline size_t
+blockSpan(const unsigned char* s,
+          size_t size,
+          bool (*isBlock)(const unsigned char*),
+          unsigned char pad)
+{
+    size_t i = 0;
+    for (; size - i >= BLOCK_SIZE; i += BLOCK_SIZE)
+    {
+        if (! isBlock(s + i))
+            return i;
+    }
+
+    if (i == size)
+        return i;
+
+    unsigned char tail[BLOCK_SIZE];
+    SPI::memset(tail, pad, sizeof(tail));
+    SPI::memcpy(tail, s + i, size - i);
+    return isBlock(tail) ? size : i;
+}
+
+#endif
+
 /***************************************************************************/
 /* xmlEscape                                                               */
 /***************************************************************************/
 
-std::string
-xmlEscape(const std::string& s)
+static inline bool
+isEscaped(const unsigned char c)
+{
+    return c == '&'
+        || c == '"'
+        || c == '\''
+        || c == '<'
+        || c == '>';
+}
+
+size_t
+xmlUnescapedSpan(const unsigned char* s, size_t size)
 {
-    std::string::const_iterator it = s.begin();
-    for (; it != s.end(); ++it)
+    size_t i = 0;
+#ifdef WPS_XML_UTILS_BLOCKS
+    i = blockSpan(s, size, isUnescapedBlock, ' ');
+#endif
+
+    for (; i != size; ++i)
     {
-        const unsigned char c = *it;
-        assert(c != '\0');
-
-        if (c == '&'
-                || c == '"'
-                || c == '\''
-                || c == '<'
-                || c == '>')
+        assert(s[i] != '\0');
+
+        if (isEscaped(s[i]))
             break;
     }
 
-    if (it == s.end())
+    return i;
+}
+
+std::string
+xmlEscape(const std::string& s)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s.data());
+    const unsigned char* const end = p + s.size();
+
+    size_t run = xmlUnescapedSpan(p, end - p);
+    if (run == s.size())
         return s;
 
     std::string result;
     result.reserve(s.size());
-    result.append(s.begin(), it);
 
-    for (; it != s.end(); ++it)
+    for (;;)
     {
-        const unsigned char c = *it;
-        assert(c != '\0');
+        result.append(reinterpret_cast<const char*>(p), run);
+        p += run;
+        if (p == end)
+            break;
 
-        switch (c)
+        switch (*p++)
         {
         case '&':
             result.append("&amp;");
@@ -76,9 +229,9 @@ xmlEscape(const std::string& s)
         case '\'':
             result.append("&apos;");
             break;
-        default:
-            result.append(1, c);
         }
+
+        run = xmlUnescapedSpan(p, end - p);
     }
 
     return result;
@@ -114,14 +267,13 @@ decodeUtf8FirstByte(const char c)
 }
 
 static Utf8Char
-decodeUtf8Char(std::vector<unsigned char>::const_iterator p,
-               std::vector<unsigned char>::const_iterator end)
+decodeUtf8Char(const unsigned char* p, const unsigned char* end)
 {
     Utf8Char c = decodeUtf8FirstByte(*p);
     if (! c.first)
         return c;
 
-    if (static_cast<size_t>(std::distance(p, end)) < c.first)
+    if (static_cast<size_t>(end - p) < c.first)
         return Utf8Char(0, 0);  // not enough bytes in input
 
     for (size_t i = 1; i < c.first; ++i)
@@ -165,22 +317,33 @@ isValidXmlUtf8(const unsigned c)
 }
 
 bool
-xmlUtf8Test(const std::vector<unsigned char>& v)
+xmlUtf8Test(const unsigned char* s, size_t size)
 {
-    for (std::vector<unsigned char>::const_iterator it = v.begin();
-         it != v.end();
-         ++it)
+    const unsigned char* const end = s + size;
+
+#ifdef WPS_XML_UTILS_BLOCKS
+    // Most SSIDs are printable ASCII, valid as they are
+    s += blockSpan(s, size, isPrintableAsciiBlock, ' ');
+#endif
+
+    while (s != end)
     {
-        const Utf8Char c = decodeUtf8Char(it, v.end());
+        const Utf8Char c = decodeUtf8Char(s, end);
         if (isUtf8OverlongSequence(c) || ! isValidXmlUtf8(c.second))
             return false;
 
         assert(c.first > 0);
-        it += c.first - 1;
+        s += c.first;
     }
 
     return true;
 }
 
+bool
+xmlUtf8Test(const std::vector<unsigned char>& v)
+{
+    return v.empty() || xmlUtf8Test(&v[0], v.size());
+}
+
 }
 }
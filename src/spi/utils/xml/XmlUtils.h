@@ -17,6 +17,7 @@
 #ifndef WPS_API_XML_UTILS_H_
 #define WPS_API_XML_UTILS_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -24,7 +25,15 @@ namespace WPS {
 namespace API {
 
 std::string xmlEscape(const std::string& s);
+
+/**
+ * @return the number of leading characters of \c s that \c xmlEscape()
+ *         leaves as they are.
+ */
+std::size_t xmlUnescapedSpan(const unsigned char* s, std::size_t size);
+
 bool xmlUtf8Test(const std::vector<unsigned char>& s);
+bool xmlUtf8Test(const unsigned char* s, std::size_t size);
 
 }
 }
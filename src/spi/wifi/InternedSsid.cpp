@@ -0,0 +1,255 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "spi/InternedSsid.h"
+#include "spi/Concurrent.h"
+
+#include "xml/XmlUtils.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+
+namespace WPS {
+namespace SPI {
+
+/**
+ * Longer SSIDs aren't valid, they aren't worth a place in the table.
+ */
+static const std::size_t MAX_SSID_SIZE = 32;
+
+struct InternedSsid::Entry
+{
+    explicit Entry(const Bytes& bytes)
+        : bytes(bytes)
+        , validXml(API::xmlUtf8Test(bytes))
+        , references(0)
+    {
+        if (validXml)
+        {
+            escapedXml = API::xmlEscape(
+                std::string(reinterpret_cast<const char*>(&bytes[0]),
+                            bytes.size()));
+        }
+    }
+
+    const Bytes bytes;
+    const bool validXml;
+    std::string escapedXml;
+
+    // Instances referring to an interned entry
+    mutable long references;
+};
+
+/**
+ * Distinct SSIDs and their entries. Entries no instance refers to are
+ * kept, as they'll likely be scanned again, until the table is full.
+ * \n
+ * Copying and destroying instances only updates reference counts,
+ * atomically where the compiler allows it. An entry is only looked up,
+ * and its count raised from 0, with the table locked, which is also
+ * when unreferenced entries are deleted.
+ */
+class InternedSsid::Table
+{
+public:
+
+    Table()
+        : _mutex(Mutex::newInstance())
+#ifndef __GNUC__
+        , _countMutex(Mutex::newInstance())
+#endif
+        , _unreferenced(0)
+    {}
+
+    /**
+     * @return the entry for <code>bytes</code>, with a reference taken,
+     *         \c NULL if there isn't one and the table is full.
+     */
+    const Entry* intern(const Bytes& bytes)
+    {
+        Guard guard(_mutex.get());
+
+        const Entries::const_iterator it = _entries.find(bytes);
+        if (it != _entries.end())
+        {
+            if (add(it->second->references, 1) == 1)
+                add(_unreferenced, -1);
+            return it->second;
+        }
+
+        if (_entries.size() >= InternedSsid::MAX_INTERNED)
+        {
+            if (add(_unreferenced, 0) <= 0)
+                return NULL;
+
+            evictUnreferenced();
+        }
+
+        const Entry* entry = new Entry(bytes);
+        entry->references = 1;
+        _entries.insert(Entries::value_type(bytes, entry));
+        return entry;
+    }
+
+    /**
+     * Takes another reference to an entry that already has one.
+     */
+    void acquire(const Entry* entry)
+    {
+        add(entry->references, 1);
+    }
+
+    void release(const Entry* entry)
+    {
+        if (add(entry->references, -1) == 0)
+            add(_unreferenced, 1);
+    }
+
+    std::size_t size() const
+    {
+        Guard guard(_mutex.get());
+        return _entries.size();
+    }
+
+private:
+
+    typedef std::map<Bytes, const Entry*> Entries;
+
+    /**
+     * @return <code>counter</code> once <code>delta</code> is added.
+     */
+    long add(long& counter, long delta)
+    {
+#ifdef __GNUC__
+        return __sync_add_and_fetch(&counter, delta);
+#else
+        Guard guard(_countMutex.get());
+        return counter += delta;
+#endif
+    }
+
+    void evictUnreferenced()
+    {
+        long evicted = 0;
+        for (Entries::iterator it = _entries.begin(); it != _entries.end();)
+        {
+            if (add(it->second->references, 0) == 0)
+            {
+                delete it->second;
+                _entries.erase(it++);
+                ++evicted;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        add(_unreferenced, -evicted);
+    }
+
+    const std::auto_ptr<Mutex> _mutex;
+#ifndef __GNUC__
+    const std::auto_ptr<Mutex> _countMutex;
+#endif
+    Entries _entries;
+    long _unreferenced;  // entries with no references, roughly
+};
+
+/*static*/ InternedSsid::Table&
+InternedSsid::table()
+{
+    // Never destroyed, as instances may outlive static destructors
+    static Table* instance = new Table;
+    return *instance;
+}
+
+static const InternedSsid::Bytes EMPTY_BYTES;
+static const std::string EMPTY_STRING;
+
+InternedSsid::InternedSsid(const Bytes& bytes)
+    : _entry(NULL)
+    , _owned(false)
+{
+    if (bytes.empty())
+        return;
+
+    if (bytes.size() <= MAX_SSID_SIZE)
+        _entry = table().intern(bytes);
+
+    if (_entry == NULL)
+    {
+        _entry = new Entry(bytes);
+        _owned = true;
+    }
+}
+
+InternedSsid::InternedSsid(const InternedSsid& that)
+    : _entry(that._owned ? new Entry(*that._entry) : that._entry)
+    , _owned(that._owned)
+{
+    if (_entry != NULL && ! _owned)
+        table().acquire(_entry);
+}
+
+InternedSsid&
+InternedSsid::operator=(const InternedSsid& that)
+{
+    if (this != &that)
+    {
+        InternedSsid copy(that);
+        std::swap(_entry, copy._entry);
+        std::swap(_owned, copy._owned);
+    }
+    return *this;
+}
+
+InternedSsid::~InternedSsid()
+{
+    if (_owned)
+        delete _entry;
+    else if (_entry != NULL)
+        table().release(_entry);
+}
+
+const InternedSsid::Bytes&
+InternedSsid::getBytes() const
+{
+    return _entry ? _entry->bytes : EMPTY_BYTES;
+}
+
+bool
+InternedSsid::isValidXml() const
+{
+    return _entry ? _entry->validXml : true;
+}
+
+const std::string&
+InternedSsid::getEscapedXml() const
+{
+    return _entry ? _entry->escapedXml : EMPTY_STRING;
+}
+
+/*static*/ std::size_t
+InternedSsid::getInternedCount()
+{
+    return table().size();
+}
+
+}
+}
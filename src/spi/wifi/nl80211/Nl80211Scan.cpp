@@ -0,0 +1,204 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Nl80211Scan.h"
+
+#include "spi/Logger.h"
+#include "spi/Time.h"
+
+#include <algorithm>
+
+#include <netlink/genl/genl.h>
+
+#include <linux/nl80211.h>
+
+#define WPS_LOG_CATEGORY "WPS.SPI.Nl80211WifiAdapter"
+
+#define WLAN_CAPABILITY_IBSS (1<<1)
+
+namespace WPS {
+namespace SPI {
+namespace Nl80211 {
+
+/**********************************************************************/
+/* BSS IE parsing routine                                             */
+/**********************************************************************/
+
+typedef bool (*IeHandler)(unsigned char type,
+                          unsigned char size,
+                          unsigned char* data,
+                          void* arg);
+
+static void
+parseBssIe(nlattr* ie, IeHandler handler, void* arg)
+{
+    int totalSize = nla_len(ie);
+    unsigned char* p0 = static_cast<unsigned char*>(nla_data(ie));
+    unsigned char* p = p0;
+
+    while (p - p0 < totalSize)
+    {
+        // BSS Information Element:
+        //   0x00: type (unsigned char)
+        //   0x01: size (unsigned char)
+        //   0x02: data
+
+        const unsigned char type = *p++;
+        const unsigned char size = *p++;
+
+        if (! handler(type, size, p, arg))
+            break;
+
+        p += size;
+    }
+}
+
+static bool
+ssidIeHandler(unsigned char type,
+              unsigned char size,
+              unsigned char* data,
+              void* arg)
+{
+    // Skip a non-SSID type
+    if (type != 0x00)
+        return true;  // continue
+
+    ScannedAccessPoint::SSID* ssid =
+        reinterpret_cast<ScannedAccessPoint::SSID*>(arg);
+
+    ssid->assign(data, data + size);
+    return false;  // stop
+}
+
+MAC
+toMAC(void* data)
+{
+    MAC::raw_type mac;
+    unsigned char* p = reinterpret_cast<unsigned char*>(data);
+    std::reverse_copy(p, p + 6, mac);
+    return MAC(mac);
+}
+
+/**********************************************************************/
+/* parseAccessPoint                                                   */
+/**********************************************************************/
+
+bool
+parseAccessPoint(nl_msg* msg, std::auto_ptr<AP>& ap)
+{
+    Logger logger(WPS_LOG_CATEGORY ".parseAccessPoint");
+
+    genlmsghdr* hdr =
+        reinterpret_cast<genlmsghdr*>(nlmsg_data(nlmsg_hdr(msg)));
+
+    if (hdr->cmd != NL80211_CMD_NEW_SCAN_RESULTS)
+        return false;
+
+    int rc;
+    nlattr* tb[NL80211_ATTR_MAX + 1];
+    nlattr* bss[NL80211_BSS_MAX + 1];
+    static nla_policy bssPolicy[NL80211_BSS_MAX + 1] = {
+        { },         // ---
+        { },         //NL80211_BSS_BSSID
+        { NLA_U32 }, //NL80211_BSS_FREQUENCY
+        { NLA_U64 }, //NL80211_BSS_TSF,
+        { NLA_U16 }, //NL80211_BSS_BEACON_INTERVAL,
+        { NLA_U16 }, //NL80211_BSS_CAPABILITY,
+        { },         //NL80211_BSS_INFORMATION_ELEMENTS,
+        { NLA_U32 }, //NL80211_BSS_SIGNAL_MBM,
+        { NLA_U8 },  //NL80211_BSS_SIGNAL_UNSPEC,
+        { NLA_U32 }, //NL80211_BSS_STATUS,
+        { NLA_U32 }, //NL80211_BSS_SEEN_MS_AGO,
+        { },         //NL80211_BSS_BEACON_IES,
+    };
+
+    rc = nla_parse(tb,
+                   NL80211_ATTR_MAX,
+                   genlmsg_attrdata(hdr, 0),
+                   genlmsg_attrlen(hdr, 0),
+                   NULL);
+    if (rc < 0)
+    {
+        logger.error("nla_parse() failed: %s", nl_geterror(rc));
+        return false;
+    }
+
+    if (! tb[NL80211_ATTR_BSS])
+    {
+        logger.error("NL80211_ATTR_BSS was not found in the netlink message");
+        return false;
+    }
+
+    rc = nla_parse_nested(bss,
+                          NL80211_BSS_MAX,
+                          tb[NL80211_ATTR_BSS],
+                          bssPolicy);
+    if (rc < 0)
+    {
+        logger.error("nla_parse_nested() failed: %s", nl_geterror(rc));
+        return false;
+    }
+
+    if (! bss[NL80211_BSS_BSSID]
+            || ! bss[NL80211_BSS_CAPABILITY]
+            || ! bss[NL80211_BSS_SEEN_MS_AGO]
+            || ! bss[NL80211_BSS_SIGNAL_MBM])
+    {
+        logger.error("some of the BSS attributes are missing");
+        return false;
+    }
+
+    // Skip ad-hoc points
+    unsigned int capability = nla_get_u16(bss[NL80211_BSS_CAPABILITY]);
+    if (capability & WLAN_CAPABILITY_IBSS)
+        return false;
+
+    const MAC mac = toMAC(nla_data(bss[NL80211_BSS_BSSID]));
+
+    Timer age;
+    age.reset(nla_get_u32(bss[NL80211_BSS_SEEN_MS_AGO]));
+
+    // Search for SSID in Wi-Fi Information Elements
+    ScannedAccessPoint::SSID ssid;
+    parseBssIe(bss[NL80211_BSS_INFORMATION_ELEMENTS],
+               ssidIeHandler,
+               &ssid);
+
+    // Signal value is signed while being encoded into uint32_t.
+    // Also it's in mBm, so we convert it into dBm.
+    const int signal =
+        static_cast<int32_t>(nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM])) / 100;
+
+    nlattr* nlStatus = bss[NL80211_BSS_STATUS];
+    const int status =
+        nlStatus ? static_cast<int>(nla_get_u32(nlStatus))
+                 : -1;
+
+    if (logger.isDebugEnabled())
+        logger.debug("scanned AP %s %d %lums (status: %d)",
+                     MAC(mac).toString().c_str(),
+                     signal,
+                     age.elapsed(),
+                     status);
+
+    ap.reset(new AP(ScannedAccessPoint(mac, signal, age, ssid),
+                    status == NL80211_BSS_STATUS_ASSOCIATED));
+    return true;
+}
+
+}
+}
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_SPI_NL80211SCAN_H_
+#define WPS_SPI_NL80211SCAN_H_
+
+#include "spi/ScannedAccessPoint.h"
+
+#include <memory>
+#include <utility>
+
+struct nl_msg;
+
+namespace WPS {
+namespace SPI {
+namespace Nl80211 {
+
+/**
+ * A scanned access point, with \c true if we are associated with it.
+ */
+typedef std::pair<ScannedAccessPoint, bool> AP;
+
+/**
+ * @return the MAC address in \c data, in the kernel's byte order.
+ */
+MAC toMAC(void* data);
+
+/**
+ * Parse a \c NL80211_CMD_NEW_SCAN_RESULTS message.
+ *
+ * @return \c false if \c msg is not a scan result, is malformed
+ *         or describes an ad-hoc point.
+ */
+bool parseAccessPoint(nl_msg* msg, std::auto_ptr<AP>& ap);
+
+}
+}
+}
+
+#endif
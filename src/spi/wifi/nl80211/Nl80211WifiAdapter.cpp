@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include "Nl80211Scan.h"
+
 #include "spi/WifiAdapter.h"
 #include "spi/Concurrent.h"
 #include "spi/Logger.h"
@@ -39,8 +41,6 @@
 
 #define WPS_LOG_CATEGORY "WPS.SPI.Nl80211WifiAdapter"
 
-#define WLAN_CAPABILITY_IBSS (1<<1)
-
 namespace WPS {
 namespace SPI {
 
@@ -66,6 +66,8 @@ public:
         , _listeningThread(0)
         , _cancelFd(-1)
         , _shouldBringDown(false)
+        , _bssMutex(Mutex::newInstance())
+        , _maxScanAge(0)
     {
         init();
     }
@@ -97,6 +99,10 @@ public:
         if (isOpen())
             return SPI_OK;
 
+        // Start from what the kernel already knows, later
+        // scans update it through the listening thread
+        updateBssTable();
+
         _cancelFd = eventfd(0, 0);
         if (_cancelFd < 0)
         {
@@ -147,6 +153,14 @@ public:
     {
         assert(isOpen());
 
+        std::vector<ScannedAccessPoint> scan;
+        if (getRecentBss(scan))
+        {
+            _logger.debug("reporting %d recently seen access points", (int) scan.size());
+            _listener->onScanCompleted(scan);
+            return;
+        }
+
         _logger.debug("starting scan");
 
         int rc;
@@ -154,6 +168,7 @@ public:
         if (! msg)
         {
             _logger.error("prepareMessage(NL80211_CMD_TRIGGER_SCAN) failed");
+            _listener->onScanFailed(SPI_ERROR);
             return;
         }
 
@@ -163,6 +178,7 @@ public:
         {
             _logger.error("nlmsg_alloc() failed");
             nlmsg_free(msg);
+            _listener->onScanFailed(SPI_ERROR);
             return;
         }
 
@@ -172,6 +188,7 @@ public:
             _logger.error("nla_put() failed: %s", nl_geterror(rc));
             nlmsg_free(msg);
             nlmsg_free(ssids);
+            _listener->onScanFailed(SPI_ERROR);
             return;
         }
 
@@ -181,6 +198,7 @@ public:
             _logger.error("nla_put_nested() failed: %s", nl_geterror(rc));
             nlmsg_free(msg);
             nlmsg_free(ssids);
+            _listener->onScanFailed(SPI_ERROR);
             return;
         }
 
@@ -194,6 +212,12 @@ public:
         _logger.debug("scan started");
     }
 
+    void setMaxScanAge(unsigned long maxAge)
+    {
+        Guard guard(_bssMutex.get());
+        _maxScanAge = maxAge;
+    }
+
     ErrorCode getConnectedMAC(MAC& mac)
     {
         if (! isInitialized())
@@ -234,7 +258,7 @@ public:
             return SPI_ERROR;
         }
 
-        mac = toMAC(nl_addr_get_binary_addr(addr));
+        mac = Nl80211::toMAC(nl_addr_get_binary_addr(addr));
         rtnl_link_put(link);
 
         if (_logger.isDebugEnabled())
@@ -456,70 +480,16 @@ private:
         return true;
     }
 
-    // BSS IE parsing routine
-
-    typedef bool (*IeHandler)(unsigned char type,
-                              unsigned char size,
-                              unsigned char* data,
-                              void* arg);
-
-    static void parseBssIe(nlattr* ie, IeHandler handler, void* arg)
-    {
-        int totalSize = nla_len(ie);
-        unsigned char* p0 = static_cast<unsigned char*>(nla_data(ie));
-        unsigned char* p = p0;
-
-        while (p - p0 < totalSize)
-        {
-            // BSS Information Element:
-            //   0x00: type (unsigned char)
-            //   0x01: size (unsigned char)
-            //   0x02: data
-
-            const unsigned char type = *p++;
-            const unsigned char size = *p++;
-
-            if (! handler(type, size, p, arg))
-                break;
-
-            p += size;
-        }
-    }
-
-    static bool ssidIeHandler(unsigned char type,
-                              unsigned char size,
-                              unsigned char* data,
-                              void* arg)
-    {
-        // Skip a non-SSID type
-        if (type != 0x00)
-            return true;  // continue
-
-        ScannedAccessPoint::SSID* ssid =
-            reinterpret_cast<ScannedAccessPoint::SSID*>(arg);
-
-        ssid->assign(data, data + size);
-        return false;  // stop
-    }
-
     // Scan result parsing routines
 
-    typedef std::pair<ScannedAccessPoint, bool> AP;  // bool for the "associated" flag
+    typedef Nl80211::AP AP;
     typedef std::vector<ScannedAccessPoint> Scan;
 
-    static MAC toMAC(void* data)
-    {
-        MAC::raw_type mac;
-        unsigned char* p = reinterpret_cast<unsigned char*>(data);
-        std::reverse_copy(p, p + 6, mac);
-        return MAC(mac);
-    }
-
     static int parseConnectedAp(nl_msg* msg, void* arg)
     {
         std::auto_ptr<AP> ap;
 
-        if (! parseAccessPoint(msg, ap))
+        if (! Nl80211::parseAccessPoint(msg, ap))
             return NL_SKIP;
 
         if (! ap->second)  // not connected
@@ -534,7 +504,7 @@ private:
     {
         std::auto_ptr<AP> ap;
 
-        if (! parseAccessPoint(msg, ap))
+        if (! Nl80211::parseAccessPoint(msg, ap))
             return NL_SKIP;
 
         Scan* scan = reinterpret_cast<Scan*>(arg);
@@ -542,108 +512,6 @@ private:
         return NL_OK;
     }
 
-    static bool parseAccessPoint(nl_msg* msg, std::auto_ptr<AP>& ap)
-    {
-        Logger logger(WPS_LOG_CATEGORY ".parseAccessPoint");
-
-        genlmsghdr* hdr =
-            reinterpret_cast<genlmsghdr*>(nlmsg_data(nlmsg_hdr(msg)));
-
-        if (hdr->cmd != NL80211_CMD_NEW_SCAN_RESULTS)
-            return false;
-
-        int rc;
-        nlattr* tb[NL80211_ATTR_MAX + 1];
-        nlattr* bss[NL80211_BSS_MAX + 1];
-        static nla_policy bssPolicy[NL80211_BSS_MAX + 1] = {
-            { },         // ---
-            { },         //NL80211_BSS_BSSID
-            { NLA_U32 }, //NL80211_BSS_FREQUENCY
-            { NLA_U64 }, //NL80211_BSS_TSF,
-            { NLA_U16 }, //NL80211_BSS_BEACON_INTERVAL,
-            { NLA_U16 }, //NL80211_BSS_CAPABILITY,
-            { },         //NL80211_BSS_INFORMATION_ELEMENTS,
-            { NLA_U32 }, //NL80211_BSS_SIGNAL_MBM,
-            { NLA_U8 },  //NL80211_BSS_SIGNAL_UNSPEC,
-            { NLA_U32 }, //NL80211_BSS_STATUS,
-            { NLA_U32 }, //NL80211_BSS_SEEN_MS_AGO,
-            { },         //NL80211_BSS_BEACON_IES,
-        };
-
-        rc = nla_parse(tb,
-                       NL80211_ATTR_MAX,
-                       genlmsg_attrdata(hdr, 0),
-                       genlmsg_attrlen(hdr, 0),
-                       NULL);
-        if (rc < 0)
-        {
-            logger.error("nla_parse() failed: %s", nl_geterror(rc));
-            return false;
-        }
-
-        if (! tb[NL80211_ATTR_BSS])
-        {
-            logger.error("NL80211_ATTR_BSS was not found in the netlink message");
-            return false;
-        }
-
-        rc = nla_parse_nested(bss,
-                              NL80211_BSS_MAX,
-                              tb[NL80211_ATTR_BSS],
-                              bssPolicy);
-        if (rc < 0)
-        {
-            logger.error("nla_parse_nested() failed: %s", nl_geterror(rc));
-            return false;
-        }
-
-        if (! bss[NL80211_BSS_BSSID]
-                || ! bss[NL80211_BSS_CAPABILITY]
-                || ! bss[NL80211_BSS_SEEN_MS_AGO]
-                || ! bss[NL80211_BSS_SIGNAL_MBM])
-        {
-            logger.error("some of the BSS attributes are missing");
-            return false;
-        }
-
-        // Skip ad-hoc points
-        unsigned int capability = nla_get_u16(bss[NL80211_BSS_CAPABILITY]);
-        if (capability & WLAN_CAPABILITY_IBSS)
-            return false;
-
-        const MAC mac = toMAC(nla_data(bss[NL80211_BSS_BSSID]));
-
-        Timer age;
-        age.reset(nla_get_u32(bss[NL80211_BSS_SEEN_MS_AGO]));
-
-        // Search for SSID in Wi-Fi Information Elements
-        ScannedAccessPoint::SSID ssid;
-        parseBssIe(bss[NL80211_BSS_INFORMATION_ELEMENTS],
-                   ssidIeHandler,
-                   &ssid);
-
-        // Signal value is signed while being encoded into uint32_t.
-        // Also it's in mBm, so we convert it into dBm.
-        const int signal =
-            static_cast<int32_t>(nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM])) / 100;
-
-        nlattr* nlStatus = bss[NL80211_BSS_STATUS];
-        const int status =
-            nlStatus ? static_cast<int>(nla_get_u32(nlStatus))
-                     : -1;
-
-        if (logger.isDebugEnabled())
-            logger.debug("scanned AP %s %d %lums (status: %d)",
-                         MAC(mac).toString().c_str(),
-                         signal,
-                         age.elapsed(),
-                         status);
-
-        ap.reset(new AP(ScannedAccessPoint(mac, signal, age, ssid),
-                        status == NL80211_BSS_STATUS_ASSOCIATED));
-        return true;
-    }
-
     // NL80211_CMD_GET_SCAN wrapper
 
     ErrorCode getScan(nl_recvmsg_msg_cb_t handler, void* arg)
@@ -661,6 +529,45 @@ private:
         return SPI_OK;
     }
 
+    // BSS table
+
+    /**
+     * Refresh the copy of the kernel's BSS table.
+     */
+    ErrorCode updateBssTable()
+    {
+        Scan scan;
+        ErrorCode code = getScan(parseScannedAp, &scan);
+        if (code != SPI_OK)
+            return code;
+
+        Guard guard(_bssMutex.get());
+        _bssTable.swap(scan);
+        return SPI_OK;
+    }
+
+    /**
+     * Get the access points seen within <code>_maxScanAge</code>,
+     * the BSS table being kept current by the scans of any application.
+     *
+     * @return <code>false</code> if there are none.
+     */
+    bool getRecentBss(Scan& scan)
+    {
+        Guard guard(_bssMutex.get());
+
+        if (_maxScanAge == 0)
+            return false;
+
+        for (Scan::const_iterator it = _bssTable.begin(); it != _bssTable.end(); ++it)
+        {
+            if (it->getTimestamp().elapsed() <= _maxScanAge)
+                scan.push_back(*it);
+        }
+
+        return ! scan.empty();
+    }
+
     // Scan listening thread
 
     void onScanCompleted()
@@ -669,12 +576,20 @@ private:
 
         _logger.debug("scan completed");
 
-        std::vector<ScannedAccessPoint> scan;
-        ErrorCode code = getScan(parseScannedAp, &scan);
-        if (code == SPI_OK)
-            _listener->onScanCompleted(scan);
-        else
+        ErrorCode code = updateBssTable();
+        if (code != SPI_OK)
+        {
             _listener->onScanFailed(code);
+            return;
+        }
+
+        Scan scan;
+        {
+            Guard guard(_bssMutex.get());
+            scan = _bssTable;
+        }
+
+        _listener->onScanCompleted(scan);
     }
 
     static int parseEvent(nl_msg* msg, void* arg)
@@ -859,6 +774,11 @@ private:
     pthread_t _listeningThread;
     int _cancelFd;
     bool _shouldBringDown;
+
+    // Guards the following, shared with the listening thread
+    std::auto_ptr<Mutex> _bssMutex;
+    Scan _bssTable;  // as of the last scan, with the age of each AP
+    unsigned long _maxScanAge;
 };
 
 /**********************************************************************/
@@ -69,7 +69,8 @@ public:
         const Timer now;
 
         const std::string ssidString("static");
-        const ScannedAccessPoint::SSID ssid(ssidString.begin(), ssidString.end());
+        const InternedSsid ssid(
+            ScannedAccessPoint::SSID(ssidString.begin(), ssidString.end()));
 
         std::vector<ScannedAccessPoint> scan;
         for (size_t i = 0; i < sizeof(macs) / sizeof(MAC::raw_type); ++i)
@@ -26,7 +26,13 @@
 #include <memory>
 
 #include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include <curl/curl.h>
+#include <zlib.h>
+#ifdef WPS_XHR_ZSTD
+#include <zstd.h>
+#endif
 
 #include "spi/Assert.h"
 
@@ -35,6 +41,24 @@
 namespace WPS {
 namespace SPI {
 
+/**
+ * curl_global_init() isn't thread-safe, so it's done once when
+ * the library is loaded rather than around each request
+ * (requests may now be sent from several threads at once).
+ */
+static struct CurlGlobal
+{
+    CurlGlobal()
+    {
+        curl_global_init(CURL_GLOBAL_ALL);
+    }
+
+    ~CurlGlobal()
+    {
+        curl_global_cleanup();
+    }
+} curlGlobal;
+
 class CurlXmlHttpRequest
     : public XmlHttpRequest
 {
@@ -42,17 +66,38 @@ public:
 
     CurlXmlHttpRequest()
         : _logger(WPS_LOG_CATEGORY)
+        , _responseHandler(NULL)
         , _statusCode((HttpStatusCode) -1)
         , _curl(NULL)
         , _curlHeaderList(NULL)
+        , _timeout(0)
+        , _encoding(ENCODING_IDENTITY)
+        , _deflaterWindowBits(0)
+#ifdef WPS_XHR_ZSTD
+        , _zstdContext(NULL)
+        , _zstdDictionary(NULL)
+#endif
+        , _abortMutex(Mutex::newInstance())
+        , _aborted(false)
     {
         _errorBuffer[0] = '\0';
     }
 
     ~CurlXmlHttpRequest()
     {
+        if (_curl != NULL)
+            curl_easy_cleanup(_curl);
+
         if (_curlHeaderList != NULL)
             curl_slist_free_all(_curlHeaderList);
+
+        if (_deflaterWindowBits != 0)
+            deflateEnd(&_deflater);
+
+#ifdef WPS_XHR_ZSTD
+        ZSTD_freeCDict(_zstdDictionary);
+        ZSTD_freeCCtx(_zstdContext);
+#endif
     }
 
     void open(HttpMethod method, const std::string& url)
@@ -63,29 +108,47 @@ public:
 
     void setRequestHeader(const std::string& header, const std::string& value)
     {
+        Headers::const_iterator it = _requestHeaders.find(header);
+        if (it != _requestHeaders.end() && it->second == value)
+            return;
+
         _requestHeaders[header] = value;
+
+        // Rebuilt by the next send()
+        if (_curlHeaderList != NULL)
+        {
+            curl_slist_free_all(_curlHeaderList);
+            _curlHeaderList = NULL;
+        }
     }
 
     ErrorCode send(const std::string& text)
     {
         _requestText = text;
+        _requestBody.clear();
+        _responseText.clear();
+        _responseHeaders.clear();
+        _statusCode = (HttpStatusCode) -1;
+        _statusText.clear();
 
-        curl_global_init(CURL_GLOBAL_ALL);
+        if (_responseHandler != NULL)
+            _responseHandler->begin();
 
-        _curl = curl_easy_init();
-        if (! _curl)
-        {
-            _logger.error("curl_easy_init failed");
+        if (isAborted())
+            return SPI_ERROR;
+
+        if (! resetHandle())
+            return SPI_ERROR;
+
+        if (_method == HTTP_POST
+                && _encoding != ENCODING_IDENTITY
+                && ! compress())
             return SPI_ERROR;
-        }
 
         configure();
 
         CURLcode rc = curl_easy_perform(_curl);
 
-        curl_easy_cleanup(_curl);
-        curl_global_cleanup();
-
         /* we only return HTTP error code when status code wasn't changed;
          * e.g. in case of 407 status code returned by proxy
          * cURL returns CURLE_RECV_ERROR, however we should return HTTP_ERROR_OK
@@ -97,6 +160,75 @@ public:
             return SPI_OK;
     }
 
+    void setTimeout(unsigned long timeout)
+    {
+        _timeout = timeout;
+    }
+
+    bool setContentEncoding(ContentEncoding encoding,
+                            const std::string& dictionary)
+    {
+        bool supported = true;
+
+        switch (encoding)
+        {
+        case ENCODING_IDENTITY:
+        case ENCODING_GZIP:
+        case ENCODING_DEFLATE:
+            break;
+
+        case ENCODING_ZSTD:
+#ifdef WPS_XHR_ZSTD
+            // Digested again by the next send()
+            if (dictionary != _dictionary)
+            {
+                ZSTD_freeCDict(_zstdDictionary);
+                _zstdDictionary = NULL;
+                _dictionary = dictionary;
+            }
+#else
+            (void) dictionary;
+            encoding = ENCODING_IDENTITY;
+            supported = false;
+#endif
+            break;
+        }
+
+        // The Content-Encoding header is part of the header list
+        if (encoding != _encoding && _curlHeaderList != NULL)
+        {
+            curl_slist_free_all(_curlHeaderList);
+            _curlHeaderList = NULL;
+        }
+
+        _encoding = encoding;
+        return supported;
+    }
+
+    bool setResponseHandler(ResponseHandler* handler)
+    {
+        _responseHandler = handler;
+        return true;
+    }
+
+    void abort()
+    {
+        Guard guard(_abortMutex.get());
+
+        _aborted = true;
+
+        // The progress callback may not be called for up to a second
+        // while waiting for the server, shutting the connections down
+        // wakes curl_easy_perform() up right away. The sockets stay
+        // open until curl closes them, so they can't be reused meanwhile.
+        for (Sockets::const_iterator it = _sockets.begin();
+             it != _sockets.end();
+             ++it)
+        {
+            ::shutdown(*it, SHUT_RDWR);
+        }
+    }
+
     std::string getResponseHeader(const std::string& header) const
     {
         Headers::const_iterator it = _responseHeaders.find(header);
@@ -122,6 +254,36 @@ public:
 
 private:
 
+    bool isAborted()
+    {
+        Guard guard(_abortMutex.get());
+        return _aborted;
+    }
+
+    /**
+     * Prepare the easy handle for a new transfer.
+     * \n
+     * The handle is kept for the lifetime of this instance since
+     * it owns the connection cache: the next send() reuses the
+     * connection kept alive by the previous one, and its TLS session.
+     */
+    bool resetHandle()
+    {
+        if (_curl == NULL)
+        {
+            _curl = curl_easy_init();
+            if (! _curl)
+            {
+                _logger.error("curl_easy_init failed");
+                return false;
+            }
+        }
+        else
+            curl_easy_reset(_curl);
+
+        return true;
+    }
+
     void configure()
     {
         curl_easy_setopt(_curl, CURLOPT_URL, _url.c_str());
@@ -131,6 +293,47 @@ private:
 #endif
         curl_easy_setopt(_curl, CURLOPT_SSLVERSION, CURL_SSLVERSION_SSLv3);
 
+        if (_timeout > 0)
+        {
+            curl_easy_setopt(_curl, CURLOPT_CONNECTTIMEOUT_MS, (long) _timeout);
+            curl_easy_setopt(_curl, CURLOPT_TIMEOUT_MS, (long) _timeout);
+        }
+        else
+        {
+            curl_easy_setopt(_curl, CURLOPT_CONNECTTIMEOUT, TIMEOUT);
+            curl_easy_setopt(_curl, CURLOPT_TIMEOUT, TIMEOUT);
+        }
+
+        curl_easy_setopt(_curl, CURLOPT_ERRORBUFFER, _errorBuffer);
+        curl_easy_setopt(_curl, CURLOPT_NOSIGNAL, 1);
+        curl_easy_setopt(_curl, CURLOPT_DNS_CACHE_TIMEOUT, 300); // 5 min
+
+        // Whatever libcurl was built to decode
+#if LIBCURL_VERSION_NUM >= 0x071506
+        curl_easy_setopt(_curl, CURLOPT_ACCEPT_ENCODING, "");
+#else
+        curl_easy_setopt(_curl, CURLOPT_ENCODING, "");
+#endif
+
+        // Support for abort()
+        curl_easy_setopt(_curl, CURLOPT_OPENSOCKETFUNCTION, &openSocketCallback);
+        curl_easy_setopt(_curl, CURLOPT_OPENSOCKETDATA, this);
+        curl_easy_setopt(_curl, CURLOPT_CLOSESOCKETFUNCTION, &closeSocketCallback);
+        curl_easy_setopt(_curl, CURLOPT_CLOSESOCKETDATA, this);
+        curl_easy_setopt(_curl, CURLOPT_NOPROGRESS, 0);
+#if LIBCURL_VERSION_NUM >= 0x072000
+        curl_easy_setopt(_curl, CURLOPT_XFERINFOFUNCTION, &progressCallback);
+        curl_easy_setopt(_curl, CURLOPT_XFERINFODATA, this);
+#else
+        curl_easy_setopt(_curl, CURLOPT_PROGRESSFUNCTION, &progressCallback);
+        curl_easy_setopt(_curl, CURLOPT_PROGRESSDATA, this);
+#endif
+#ifndef NDEBUG
+        curl_easy_setopt(_curl, CURLOPT_VERBOSE, 1);
+        curl_easy_setopt(_curl, CURLOPT_DEBUGFUNCTION, &debugCallback);
+        curl_easy_setopt(_curl, CURLOPT_DEBUGDATA, this);
+#endif
+
         switch (_method)
         {
         case HTTP_GET:
@@ -146,19 +349,25 @@ private:
             break;
         }
 
-        curl_easy_setopt(_curl, CURLOPT_CONNECTTIMEOUT, TIMEOUT);
-        curl_easy_setopt(_curl, CURLOPT_TIMEOUT, TIMEOUT);
-
         if (_method != HTTP_HEAD)
         {
-            assert(_curlHeaderList == NULL);
-
-            for (Headers::const_iterator it = _requestHeaders.begin();
-                it != _requestHeaders.end();
-                ++it)
+            // Kept across send() calls until the headers change
+            if (_curlHeaderList == NULL)
             {
-                std::string header = it->first + ": " + it->second;
-                _curlHeaderList = curl_slist_append(_curlHeaderList, header.c_str());
+                for (Headers::const_iterator it = _requestHeaders.begin();
+                    it != _requestHeaders.end();
+                    ++it)
+                {
+                    std::string header = it->first + ": " + it->second;
+                    _curlHeaderList = curl_slist_append(_curlHeaderList, header.c_str());
+                }
+
+                if (_encoding != ENCODING_IDENTITY)
+                {
+                    std::string header = std::string("Content-Encoding: ")
+                                       + getEncodingName(_encoding);
+                    _curlHeaderList = curl_slist_append(_curlHeaderList, header.c_str());
+                }
             }
 
             if (_curlHeaderList)
@@ -166,22 +375,146 @@ private:
         }
 
         if (_method == HTTP_POST)
-            curl_easy_setopt(_curl, CURLOPT_POSTFIELDS, _requestText.c_str());
+        {
+            const std::string& body =
+                _encoding == ENCODING_IDENTITY ? _requestText : _requestBody;
+
+            // Compressed bodies aren't null-terminated strings
+            curl_easy_setopt(_curl, CURLOPT_POSTFIELDSIZE, (long) body.size());
+            curl_easy_setopt(_curl, CURLOPT_POSTFIELDS, body.data());
+        }
 
-        curl_easy_setopt(_curl, CURLOPT_ERRORBUFFER, _errorBuffer);
         curl_easy_setopt(_curl, CURLOPT_WRITEFUNCTION, &writeCallback);
         curl_easy_setopt(_curl, CURLOPT_WRITEDATA, this);
-        curl_easy_setopt(_curl, CURLOPT_NOSIGNAL, 1);
-        curl_easy_setopt(_curl, CURLOPT_DNS_CACHE_TIMEOUT, 300); // 5 min
-#ifndef NDEBUG
-        curl_easy_setopt(_curl, CURLOPT_VERBOSE, 1);
-        curl_easy_setopt(_curl, CURLOPT_DEBUGFUNCTION, &debugCallback);
-        curl_easy_setopt(_curl, CURLOPT_DEBUGDATA, this);
-#endif
         curl_easy_setopt(_curl, CURLOPT_HEADERFUNCTION, &headerCallback);
         curl_easy_setopt(_curl, CURLOPT_WRITEHEADER, this);
     }
 
+    static const char* getEncodingName(ContentEncoding encoding)
+    {
+        switch (encoding)
+        {
+        case ENCODING_GZIP:
+            return "gzip";
+        case ENCODING_DEFLATE:
+            return "deflate";
+        case ENCODING_ZSTD:
+            return "zstd";
+        default:
+            return "identity";
+        }
+    }
+
+    /**
+     * Compress <code>_requestText</code> into <code>_requestBody</code>.
+     */
+    bool compress()
+    {
+#ifdef WPS_XHR_ZSTD
+        if (_encoding == ENCODING_ZSTD)
+            return compressZstd();
+#endif
+
+        // HTTP's deflate is the zlib format, gzip adds 16 to the window bits
+        const int windowBits = _encoding == ENCODING_GZIP ? 15 + 16 : 15;
+
+        // The deflater's state (a few hundred kB) is kept across requests
+        if (_deflaterWindowBits != windowBits)
+        {
+            if (_deflaterWindowBits != 0)
+                deflateEnd(&_deflater);
+
+            _deflaterWindowBits = 0;
+            _deflater = z_stream();
+
+            // The higher levels cost several times the CPU for a few bytes
+            if (deflateInit2(&_deflater,
+                             Z_DEFAULT_COMPRESSION,
+                             Z_DEFLATED,
+                             windowBits,
+                             8,
+                             Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+                _logger.error("deflateInit2 failed");
+                return false;
+            }
+
+            _deflaterWindowBits = windowBits;
+        }
+        else
+            deflateReset(&_deflater);
+
+        _requestBody.resize(deflateBound(&_deflater, _requestText.size()));
+
+        _deflater.next_in =
+            reinterpret_cast<Bytef*>(const_cast<char*>(_requestText.data()));
+        _deflater.avail_in = _requestText.size();
+        _deflater.next_out = reinterpret_cast<Bytef*>(&_requestBody[0]);
+        _deflater.avail_out = _requestBody.size();
+
+        if (deflate(&_deflater, Z_FINISH) != Z_STREAM_END)
+        {
+            _logger.error("deflate failed");
+            return false;
+        }
+
+        _requestBody.resize(_deflater.total_out);
+        return true;
+    }
+
+#ifdef WPS_XHR_ZSTD
+    bool compressZstd()
+    {
+        if (_zstdContext == NULL)
+        {
+            _zstdContext = ZSTD_createCCtx();
+            if (_zstdContext == NULL)
+            {
+                _logger.error("ZSTD_createCCtx failed");
+                return false;
+            }
+        }
+
+        if (_zstdDictionary == NULL && ! _dictionary.empty())
+        {
+            _zstdDictionary = ZSTD_createCDict(_dictionary.data(),
+                                               _dictionary.size(),
+                                               ZSTD_LEVEL);
+            if (_zstdDictionary == NULL)
+            {
+                _logger.error("ZSTD_createCDict failed");
+                return false;
+            }
+        }
+
+        _requestBody.resize(ZSTD_compressBound(_requestText.size()));
+
+        const size_t size =
+            _zstdDictionary != NULL
+                ? ZSTD_compress_usingCDict(_zstdContext,
+                                           &_requestBody[0],
+                                           _requestBody.size(),
+                                           _requestText.data(),
+                                           _requestText.size(),
+                                           _zstdDictionary)
+                : ZSTD_compressCCtx(_zstdContext,
+                                    &_requestBody[0],
+                                    _requestBody.size(),
+                                    _requestText.data(),
+                                    _requestText.size(),
+                                    ZSTD_LEVEL);
+
+        if (ZSTD_isError(size))
+        {
+            _logger.error("zstd compression failed: %s", ZSTD_getErrorName(size));
+            return false;
+        }
+
+        _requestBody.resize(size);
+        return true;
+    }
+#endif
+
     static ErrorCode translateCurlError(CURLcode result)
     {
         switch (result)
@@ -297,13 +630,62 @@ private:
 
         const size_t len = size * nmemb;
 
-        _this->_responseText.append(reinterpret_cast<const char*>(ptr), len);
+        // Already decompressed by curl
+        if (_this->_responseHandler != NULL)
+            _this->_responseHandler->data(reinterpret_cast<const char*>(ptr), len);
+        else
+            _this->_responseText.append(reinterpret_cast<const char*>(ptr), len);
         return len;
     }
 
+    static curl_socket_t openSocketCallback(void* param,
+                                            curlsocktype,
+                                            struct curl_sockaddr* address)
+    {
+        CurlXmlHttpRequest* _this = reinterpret_cast<CurlXmlHttpRequest*>(param);
+
+        Guard guard(_this->_abortMutex.get());
+
+        if (_this->_aborted)
+            return CURL_SOCKET_BAD;
+
+        const curl_socket_t s =
+            ::socket(address->family, address->socktype, address->protocol);
+        if (s != CURL_SOCKET_BAD)
+            _this->_sockets.insert(s);
+        return s;
+    }
+
+    static int closeSocketCallback(void* param, curl_socket_t s)
+    {
+        CurlXmlHttpRequest* _this = reinterpret_cast<CurlXmlHttpRequest*>(param);
+
+        Guard guard(_this->_abortMutex.get());
+
+        _this->_sockets.erase(s);
+        return ::close(s);
+    }
+
+#if LIBCURL_VERSION_NUM >= 0x072000
+    static int progressCallback(void* param,
+                                curl_off_t, curl_off_t,
+                                curl_off_t, curl_off_t)
+#else
+    static int progressCallback(void* param,
+                                double, double,
+                                double, double)
+#endif
+    {
+        CurlXmlHttpRequest* _this = reinterpret_cast<CurlXmlHttpRequest*>(param);
+
+        // Non-zero fails the transfer with CURLE_ABORTED_BY_CALLBACK
+        return _this->isAborted() ? 1 : 0;
+    }
+
 protected:
 
     typedef std::map<std::string, std::string> Headers;
+    typedef std::set<curl_socket_t> Sockets;
 
     Logger _logger;
 
@@ -313,16 +695,40 @@ protected:
     Headers _requestHeaders;
     Headers _responseHeaders;
     std::string _requestText;
+    std::string _requestBody;   // _requestText compressed
     std::string _responseText;
+    ResponseHandler* _responseHandler;  // _responseText is unused if set
     HttpStatusCode _statusCode;
     std::string _statusText;
     CURL* _curl;
     curl_slist* _curlHeaderList;
     char _errorBuffer[CURL_ERROR_SIZE];
+    unsigned long _timeout;
+
+    ContentEncoding _encoding;
+    z_stream _deflater;
+    int _deflaterWindowBits;    // 0 until _deflater is initialized
+#ifdef WPS_XHR_ZSTD
+    std::string _dictionary;
+    ZSTD_CCtx* _zstdContext;
+    ZSTD_CDict* _zstdDictionary;
+#endif
+
+    // Guards the abort state, which is accessed by abort()
+    // while send() is in progress on another thread
+    std::auto_ptr<Mutex> _abortMutex;
+    bool _aborted;
+    Sockets _sockets;
 
 private:
 
     static const unsigned int TIMEOUT = 30;
+
+#ifdef WPS_XHR_ZSTD
+    // zstd's default level: the higher ones cost far more CPU and
+    // gain little on requests this small
+    static const int ZSTD_LEVEL = 3;
+#endif
 };
 
 /**********************************************************************/
@@ -0,0 +1,368 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InSituDOM.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace WPS {
+namespace SPI {
+
+static inline std::string
+to_string(const char* s)
+{
+    return s ? s : "";
+}
+
+/*********************************************************************/
+/*                                                                   */
+/* InSituDOMDocument                                                 */
+/*                                                                   */
+/*********************************************************************/
+
+const size_t InSituDOMDocument::NONE;
+
+InSituDOMDocument::InSituDOMDocument(const char* xml, size_t size)
+    : _buffer(size + 1)
+{
+    // Tokenized in place, the caller's copy is left alone
+    std::copy(xml, xml + size, _buffer.begin());
+    _buffer[size] = '\0';
+}
+
+bool
+InSituDOMDocument::parse()
+{
+    const size_t size = _buffer.size() - 1;
+
+    // Each tag opens at most an element and ends a text
+    const size_t tags = std::count(_buffer.begin(), _buffer.end() - 1, '<');
+    _nodes.reserve(2 * tags + 1);
+
+    InSituTokenizer tokenizer(*this);
+    const bool wellFormed = tokenizer.tokenize(&_buffer[0], size);
+
+    _open.clear();
+    _lastChild.clear();
+
+    if (! wellFormed)
+        _nodes.clear();
+    return wellFormed;
+}
+
+DOMNode*
+InSituDOMDocument::getDocumentElement() const
+{
+    return new InSituDOMNode(this, getNode(_nodes.empty() ? NONE : 0));
+}
+
+const InSituDOMDocument::Attribute*
+InSituDOMDocument::findAttribute(const Node* node,
+                                 const char* namespaceURI,
+                                 const char* localName) const
+{
+    if (node->namespaceURI == NULL)
+        return NULL;
+
+    const Attribute* attribute = node->attributeCount > 0
+        ? &_attributes[node->firstAttribute]
+        : NULL;
+    for (size_t i = 0; i < node->attributeCount; ++i, ++attribute)
+    {
+        if (strcmp(attribute->localName, localName) == 0
+                && strcmp(attribute->namespaceURI, namespaceURI) == 0)
+            return attribute;
+    }
+
+    return NULL;
+}
+
+static inline const InSituDOMDocument::Node*
+to_node(const void* node)
+{
+    return static_cast<const InSituDOMDocument::Node*>(node);
+}
+
+const void*
+InSituDOMDocument::getRootNode() const
+{
+    return getNode(_nodes.empty() ? NONE : 0);
+}
+
+const void*
+InSituDOMDocument::getFirstChild(const void* node) const
+{
+    return getNode(to_node(node)->firstChild);
+}
+
+const void*
+InSituDOMDocument::getNextSibling(const void* node) const
+{
+    return getNode(to_node(node)->nextSibling);
+}
+
+bool
+InSituDOMDocument::isElement(const void* node,
+                             const char* namespaceURI,
+                             const char* localName) const
+{
+    const Node* p_node = to_node(node);
+    return p_node->namespaceURI != NULL
+        && strcmp(p_node->localName, localName) == 0
+        && strcmp(p_node->namespaceURI, namespaceURI) == 0;
+}
+
+const char*
+InSituDOMDocument::getText(const void* node) const
+{
+    const Node* p_node = to_node(node);
+    if (p_node->namespaceURI == NULL)
+        return p_node->text;
+
+    // The text directly contained, as libxml's first child
+    const Node* child = getNode(p_node->firstChild);
+    return child != NULL && child->namespaceURI == NULL ? child->text : "";
+}
+
+const char*
+InSituDOMDocument::getAttributeNS(const void* node,
+                                  const char* namespaceURI,
+                                  const char* localName) const
+{
+    const Attribute* attribute =
+        findAttribute(to_node(node), namespaceURI, localName);
+    return attribute != NULL ? attribute->value : "";
+}
+
+void
+InSituDOMDocument::startElement(const char* namespaceURI,
+                                const char* prefix,
+                                const char* localName,
+                                const Attribute* attributes,
+                                size_t size)
+{
+    Node node;
+    node.namespaceURI = namespaceURI;
+    node.prefix = prefix;
+    node.localName = localName;
+    node.text = NULL;
+    node.firstChild = NONE;
+    node.nextSibling = NONE;
+    node.firstAttribute = _attributes.size();
+    node.attributeCount = size;
+
+    _attributes.insert(_attributes.end(), attributes, attributes + size);
+
+    append(node);
+    _open.push_back(_nodes.size() - 1);
+    _lastChild.push_back(NONE);
+}
+
+void
+InSituDOMDocument::endElement()
+{
+    _open.pop_back();
+    _lastChild.pop_back();
+}
+
+void
+InSituDOMDocument::characters(const char* data, size_t)
+{
+    Node node;
+    node.namespaceURI = NULL;
+    node.prefix = NULL;
+    node.localName = NULL;
+    node.text = data;
+    node.firstChild = NONE;
+    node.nextSibling = NONE;
+    node.firstAttribute = 0;
+    node.attributeCount = 0;
+
+    append(node);
+}
+
+void
+InSituDOMDocument::append(const Node& node)
+{
+    _nodes.push_back(node);
+    const size_t index = _nodes.size() - 1;
+
+    // The root element has no parent
+    if (_open.empty())
+        return;
+
+    if (_lastChild.back() == NONE)
+        _nodes[_open.back()].firstChild = index;
+    else
+        _nodes[_lastChild.back()].nextSibling = index;
+    _lastChild.back() = index;
+}
+
+/*********************************************************************/
+/*                                                                   */
+/* InSituDOMNode                                                     */
+/*                                                                   */
+/*********************************************************************/
+
+InSituDOMNode::InSituDOMNode(const InSituDOMDocument* document,
+                             const InSituDOMDocument::Node* node)
+    : _document(document)
+    , _node(node)
+    , _attribute(NULL)
+{}
+
+InSituDOMNode::InSituDOMNode(const InSituDOMDocument* document,
+                             const InSituDOMDocument::Attribute* attribute)
+    : _document(document)
+    , _node(NULL)
+    , _attribute(attribute)
+{}
+
+std::string
+InSituDOMNode::getNodeName() const
+{
+    const std::string prefix = getPrefix();
+    return prefix.empty() ? getLocalName() : prefix + ":" + getLocalName();
+}
+
+std::string
+InSituDOMNode::getNodeValue() const
+{
+    if (_attribute)
+        return to_string(_attribute->value);
+
+    if (! _node)
+        return "";
+
+    if (_node->namespaceURI == NULL)
+        return to_string(_node->text);
+
+    const InSituDOMDocument::Node* child = _document->getNode(_node->firstChild);
+    return child != NULL && child->namespaceURI == NULL ? to_string(child->text) : "";
+}
+
+std::string
+InSituDOMNode::getNamespaceURI() const
+{
+    if (_attribute)
+        return to_string(_attribute->namespaceURI);
+    return to_string(_node ? _node->namespaceURI : NULL);
+}
+
+std::string
+InSituDOMNode::getPrefix() const
+{
+    if (_attribute)
+        return to_string(_attribute->prefix);
+    return to_string(_node ? _node->prefix : NULL);
+}
+
+std::string
+InSituDOMNode::getLocalName() const
+{
+    if (_attribute)
+        return to_string(_attribute->localName);
+
+    // libxml names text nodes "text"
+    if (_node && _node->namespaceURI == NULL)
+        return "text";
+    return to_string(_node ? _node->localName : NULL);
+}
+
+DOMNodeList*
+InSituDOMNode::getChildNodes() const
+{
+    return new InSituDOMNodeList(_document,
+                                 _node ? _node->firstChild : InSituDOMDocument::NONE);
+}
+
+std::string
+InSituDOMNode::getAttributeNS(const std::string& namespaceURI,
+                              const std::string& localName) const
+{
+    if (! _node)
+        return "";
+
+    const InSituDOMDocument::Attribute* attribute =
+        _document->findAttribute(_node, namespaceURI.c_str(), localName.c_str());
+    return attribute != NULL ? to_string(attribute->value) : "";
+}
+
+DOMNode*
+InSituDOMNode::getAttributeNodeNS(const std::string& namespaceURI,
+                                  const std::string& localName) const
+{
+    if (! _node)
+        return 0;
+
+    const InSituDOMDocument::Attribute* attribute =
+        _document->findAttribute(_node, namespaceURI.c_str(), localName.c_str());
+    return attribute != NULL ? new InSituDOMNode(_document, attribute) : 0;
+}
+
+/*********************************************************************/
+/*                                                                   */
+/* InSituDOMNodeList                                                 */
+/*                                                                   */
+/*********************************************************************/
+
+InSituDOMNodeList::InSituDOMNodeList(const InSituDOMDocument* document,
+                                     size_t first)
+    : _document(document)
+    , _first(first)
+    , _last(first)
+    , _lastIndex(0)
+{}
+
+DOMNode*
+InSituDOMNodeList::getItem(unsigned long index) const
+{
+    // Resume from the last item rather than the head when we can
+    unsigned long i = 0;
+    const InSituDOMDocument::Node* node = _document->getNode(_first);
+    if (_last != InSituDOMDocument::NONE && index >= _lastIndex)
+    {
+        i = _lastIndex;
+        node = _document->getNode(_last);
+    }
+
+    for (; node; node = _document->getNode(node->nextSibling), ++i)
+    {
+        if (index == i)
+        {
+            _last = node - _document->getNode(0);
+            _lastIndex = i;
+            return new InSituDOMNode(_document, node);
+        }
+    }
+
+    return 0;
+}
+
+unsigned long
+InSituDOMNodeList::getLength() const
+{
+    unsigned long len = 0;
+    for (const InSituDOMDocument::Node* node = _document->getNode(_first);
+         node;
+         node = _document->getNode(node->nextSibling))
+        ++len;
+    return len;
+}
+
+}
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_SPI_INSITUDOM_H_
+#define WPS_SPI_INSITUDOM_H_
+
+#include "spi/DOM.h"
+
+#include "InSituTokenizer.h"
+
+#include <vector>
+
+namespace WPS {
+namespace SPI {
+
+class InSituDOMDocument;
+
+/*********************************************************************/
+/*                                                                   */
+/* InSituDOMDocument                                                 */
+/*                                                                   */
+/*********************************************************************/
+
+/**
+ * A document tokenized in its own copy of the text, with elements and
+ * text as an array of nodes whose strings point into that copy.
+ * \n
+ * Strings are returned in UTF-8, as they are in the document.
+ */
+class InSituDOMDocument
+    : public DOMDocument
+    , private InSituTokenizer::Handler
+{
+public:
+
+    static const size_t NONE = static_cast<size_t>(-1);
+
+    struct Node
+    {
+        const char* namespaceURI;   // NULL for text
+        const char* prefix;
+        const char* localName;
+        const char* text;           // for text
+        size_t firstChild;
+        size_t nextSibling;
+        size_t firstAttribute;      // in _attributes
+        size_t attributeCount;
+    };
+
+    typedef InSituTokenizer::Attribute Attribute;
+
+    InSituDOMDocument(const char* xml, size_t size);
+
+    /**
+     * @return <code>false</code> if the document isn't well-formed.
+     */
+    bool parse();
+
+    DOMNode* getDocumentElement() const;
+
+    /**
+     * @return the node at \c index, \c NULL if \c NONE.
+     */
+    const Node* getNode(size_t index) const
+    {
+        return index != NONE ? &_nodes[index] : NULL;
+    }
+
+    const Attribute* findAttribute(const Node* node,
+                                   const char* namespaceURI,
+                                   const char* localName) const;
+
+protected:
+
+    const void* getRootNode() const;
+    const void* getFirstChild(const void* node) const;
+    const void* getNextSibling(const void* node) const;
+    bool isElement(const void* node,
+                   const char* namespaceURI,
+                   const char* localName) const;
+    const char* getText(const void* node) const;
+    const char* getAttributeNS(const void* node,
+                               const char* namespaceURI,
+                               const char* localName) const;
+
+private:
+
+    void startElement(const char* namespaceURI,
+                      const char* prefix,
+                      const char* localName,
+                      const Attribute* attributes,
+                      size_t size);
+    void endElement();
+    void characters(const char* data, size_t size);
+
+    /**
+     * Append \c node as the last child of the open element.
+     */
+    void append(const Node& node);
+
+private:
+
+    std::vector<char> _buffer;      // the document, NUL-terminated
+    std::vector<Node> _nodes;       // the root element first
+    std::vector<Attribute> _attributes;
+
+    // While parsing, the open elements and their last child
+    std::vector<size_t> _open;
+    std::vector<size_t> _lastChild;
+};
+
+/*********************************************************************/
+/*                                                                   */
+/* InSituDOMNode                                                     */
+/*                                                                   */
+/*********************************************************************/
+
+/**
+ * An element, text or attribute of an \c InSituDOMDocument.
+ */
+class InSituDOMNode
+    : public DOMNode
+{
+public:
+
+    InSituDOMNode(const InSituDOMDocument* document,
+                  const InSituDOMDocument::Node* node);
+    InSituDOMNode(const InSituDOMDocument* document,
+                  const InSituDOMDocument::Attribute* attribute);
+
+    std::string getNodeName() const;
+    std::string getNodeValue() const;
+    std::string getNamespaceURI() const;
+    std::string getPrefix() const;
+    std::string getLocalName() const;
+
+    DOMNodeList* getChildNodes() const;
+
+    std::string getAttributeNS(const std::string& namespaceURI,
+                               const std::string& localName) const;
+
+    DOMNode* getAttributeNodeNS(const std::string& namespaceURI,
+                                const std::string& localName) const;
+
+private:
+
+    const InSituDOMDocument* _document;
+    const InSituDOMDocument::Node* _node;             // NULL for attributes
+    const InSituDOMDocument::Attribute* _attribute;
+};
+
+/*********************************************************************/
+/*                                                                   */
+/* InSituDOMNodeList                                                 */
+/*                                                                   */
+/*********************************************************************/
+
+class InSituDOMNodeList
+    : public DOMNodeList
+{
+public:
+
+    InSituDOMNodeList(const InSituDOMDocument* document, size_t first);
+
+    DOMNode* getItem(unsigned long index) const;
+
+    unsigned long getLength() const;
+
+private:
+
+    const InSituDOMDocument* _document;
+    const size_t _first;
+
+    // The last item returned, so that iterating by index is linear
+    mutable size_t _last;
+    mutable unsigned long _lastIndex;
+};
+
+}
+}
+
+#endif
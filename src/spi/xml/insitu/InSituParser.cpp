@@ -0,0 +1,64 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InSituDOM.h"
+#include "InSituParser.h"
+
+#include <memory>
+
+namespace WPS {
+namespace SPI {
+
+/*********************************************************************
+ *
+ * InSituParser
+ *
+ *********************************************************************/
+
+InSituParser::InSituParser()
+    : _logger("WPS.SPI.XmlParser.InSituParser")
+{}
+
+InSituParser::~InSituParser()
+{}
+
+DOMDocument*
+InSituParser::parse(const char* xml, size_t size)
+{
+    std::auto_ptr<InSituDOMDocument> doc(new InSituDOMDocument(xml, size));
+    if (! doc->parse())
+    {
+        _logger.error("error parsing xml");
+        return NULL;
+    }
+
+    return doc.release();
+}
+
+/*********************************************************************
+ *
+ * XmlParser::newInstance
+ *
+ *********************************************************************/
+
+XmlParser*
+XmlParser::newInstance()
+{
+    return new InSituParser();
+}
+
+}
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_SPI_INSITUPARSER_H_
+#define WPS_SPI_INSITUPARSER_H_
+
+#include "spi/Logger.h"
+#include "spi/XmlParser.h"
+
+namespace WPS {
+namespace SPI {
+
+class InSituParser
+    : public XmlParser
+{
+public:
+
+    InSituParser();
+    ~InSituParser();
+
+    DOMDocument* parse(const char* xml, size_t size);
+
+private:
+
+    Logger _logger;
+};
+
+}
+}
+
+#endif
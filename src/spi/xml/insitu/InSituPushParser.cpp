@@ -0,0 +1,115 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InSituPushParser.h"
+
+namespace WPS {
+namespace SPI {
+
+/*********************************************************************
+ *
+ * InSituPushParser
+ *
+ *********************************************************************/
+
+InSituPushParser::InSituPushParser(XmlContentHandler& handler)
+    : _logger("WPS.SPI.XmlPushParser.InSituPushParser")
+    , _handler(handler)
+    , _tokenizer(*this)
+{}
+
+InSituPushParser::~InSituPushParser()
+{}
+
+void
+InSituPushParser::reset()
+{
+    _buffer.clear();
+}
+
+bool
+InSituPushParser::parse(const char* data, size_t size)
+{
+    _buffer.insert(_buffer.end(), data, data + size);
+    return true;
+}
+
+bool
+InSituPushParser::finish()
+{
+    const size_t size = _buffer.size();
+    _buffer.push_back('\0');
+
+    const bool wellFormed = _tokenizer.tokenize(&_buffer[0], size);
+    _buffer.clear();
+
+    if (! wellFormed)
+    {
+        _logger.error("error parsing xml");
+        return false;
+    }
+
+    return true;
+}
+
+void
+InSituPushParser::startElement(const char* namespaceURI,
+                               const char*,
+                               const char* localName,
+                               const InSituTokenizer::Attribute* attributes,
+                               size_t size)
+{
+    _attributes.resize(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        _attributes[i].namespaceURI = attributes[i].namespaceURI;
+        _attributes[i].localName = attributes[i].localName;
+        _attributes[i].value = attributes[i].value;
+        _attributes[i].valueSize = attributes[i].valueSize;
+    }
+
+    _handler.startElement(namespaceURI,
+                          localName,
+                          size > 0 ? &_attributes[0] : NULL,
+                          size);
+}
+
+void
+InSituPushParser::endElement()
+{
+    _handler.endElement();
+}
+
+void
+InSituPushParser::characters(const char* data, size_t size)
+{
+    _handler.characters(data, size);
+}
+
+/*********************************************************************
+ *
+ * XmlPushParser::newInstance
+ *
+ *********************************************************************/
+
+XmlPushParser*
+XmlPushParser::newInstance(XmlContentHandler& handler)
+{
+    return new InSituPushParser(handler);
+}
+
+}
+}
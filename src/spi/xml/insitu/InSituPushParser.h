@@ -0,0 +1,71 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_SPI_INSITUPUSHPARSER_H_
+#define WPS_SPI_INSITUPUSHPARSER_H_
+
+#include "spi/Logger.h"
+#include "spi/XmlPushParser.h"
+
+#include "InSituTokenizer.h"
+
+#include <vector>
+
+namespace WPS {
+namespace SPI {
+
+/**
+ * Keeps the parts of the document and tokenizes it once complete,
+ * so the handler only receives its content from <code>finish()</code>.
+ */
+class InSituPushParser
+    : public XmlPushParser
+    , private InSituTokenizer::Handler
+{
+public:
+
+    InSituPushParser(XmlContentHandler& handler);
+    ~InSituPushParser();
+
+    void reset();
+    bool parse(const char* data, size_t size);
+    bool finish();
+
+private:
+
+    void startElement(const char* namespaceURI,
+                      const char* prefix,
+                      const char* localName,
+                      const InSituTokenizer::Attribute* attributes,
+                      size_t size);
+    void endElement();
+    void characters(const char* data, size_t size);
+
+private:
+
+    Logger _logger;
+    XmlContentHandler& _handler;
+    InSituTokenizer _tokenizer;
+
+    // Reused from one document to the next
+    std::vector<char> _buffer;
+    std::vector<XmlAttribute> _attributes;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,588 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InSituTokenizer.h"
+
+#include <string.h>
+
+namespace WPS {
+namespace SPI {
+
+static const char XML_NAMESPACE[] = "http://www.w3.org/XML/1998/namespace";
+
+static inline bool
+isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool
+isNameStart(char c)
+{
+    const unsigned char u = static_cast<unsigned char>(c);
+    return (u >= 'a' && u <= 'z')
+        || (u >= 'A' && u <= 'Z')
+        || u == '_' || u == ':'
+        || u >= 0x80;
+}
+
+static inline bool
+isNameChar(char c)
+{
+    return isNameStart(c)
+        || (c >= '0' && c <= '9')
+        || c == '-' || c == '.';
+}
+
+static inline char*
+skipSpaces(char* p)
+{
+    while (isSpace(*p))
+        ++p;
+    return p;
+}
+
+static inline char*
+skipName(char* p)
+{
+    while (isNameChar(*p))
+        ++p;
+    return p;
+}
+
+static inline bool
+startsWith(const char* p, const char* prefix)
+{
+    return strncmp(p, prefix, strlen(prefix)) == 0;
+}
+
+/**
+ * @return where the UTF-8 encoding of \c c ends, \c NULL if it isn't
+ *         a character allowed in a document.
+ */
+static char*
+encode(char* w, unsigned long c)
+{
+    if (c < 0x20 && c != 0x9 && c != 0xA && c != 0xD)
+        return NULL;
+    if ((c >= 0xD800 && c <= 0xDFFF) || c == 0xFFFE || c == 0xFFFF || c > 0x10FFFF)
+        return NULL;
+
+    if (c < 0x80)
+    {
+        *w++ = static_cast<char>(c);
+    }
+    else if (c < 0x800)
+    {
+        *w++ = static_cast<char>(0xC0 | (c >> 6));
+        *w++ = static_cast<char>(0x80 | (c & 0x3F));
+    }
+    else if (c < 0x10000)
+    {
+        *w++ = static_cast<char>(0xE0 | (c >> 12));
+        *w++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        *w++ = static_cast<char>(0x80 | (c & 0x3F));
+    }
+    else
+    {
+        *w++ = static_cast<char>(0xF0 | (c >> 18));
+        *w++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+        *w++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        *w++ = static_cast<char>(0x80 | (c & 0x3F));
+    }
+
+    return w;
+}
+
+/**
+ * Decode the reference between \c name and \c end (the ';') into \c w,
+ * which is never ahead of it.
+ *
+ * @return where the decoded character ends, \c NULL if it's unknown.
+ */
+static char*
+decodeReference(char* w, const char* name, const char* end)
+{
+    const size_t length = end - name;
+
+    if (length == 2 && name[0] == 'l' && name[1] == 't')
+        *w++ = '<';
+    else if (length == 2 && name[0] == 'g' && name[1] == 't')
+        *w++ = '>';
+    else if (length == 3 && strncmp(name, "amp", 3) == 0)
+        *w++ = '&';
+    else if (length == 4 && strncmp(name, "apos", 4) == 0)
+        *w++ = '\'';
+    else if (length == 4 && strncmp(name, "quot", 4) == 0)
+        *w++ = '"';
+    else if (length >= 2 && name[0] == '#')
+    {
+        const bool hex = name[1] == 'x';
+        const char* p = name + (hex ? 2 : 1);
+        if (p == end)
+            return NULL;
+
+        unsigned long c = 0;
+        for (; p < end; ++p)
+        {
+            unsigned long digit;
+            if (*p >= '0' && *p <= '9')
+                digit = *p - '0';
+            else if (hex && *p >= 'a' && *p <= 'f')
+                digit = *p - 'a' + 10;
+            else if (hex && *p >= 'A' && *p <= 'F')
+                digit = *p - 'A' + 10;
+            else
+                return NULL;
+
+            c = c * (hex ? 16 : 10) + digit;
+            if (c > 0x10FFFF)
+                return NULL;
+        }
+
+        return encode(w, c);
+    }
+    else
+        return NULL;
+
+    return w;
+}
+
+/**
+ * Decode references and normalize line ends (and whitespace in
+ * attribute values) between \c p and \c end, in place.
+ *
+ * @return the end of the decoded string, \c NULL if it's malformed.
+ */
+static char*
+decode(char* p, char* end, bool attribute)
+{
+    // Most strings have nothing to decode, and are left alone
+    while (p < end
+            && *p != '&'
+            && *p != '\r'
+            && ! (attribute && (*p == '\t' || *p == '\n')))
+        ++p;
+
+    char* w = p;
+    while (p < end)
+    {
+        const char c = *p;
+        if (c == '&')
+        {
+            char* semicolon = p + 1;
+            while (semicolon < end && *semicolon != ';')
+                ++semicolon;
+            if (semicolon == end)
+                return NULL;
+
+            w = decodeReference(w, p + 1, semicolon);
+            if (w == NULL)
+                return NULL;
+            p = semicolon + 1;
+        }
+        else if (c == '\r')
+        {
+            *w++ = attribute ? ' ' : '\n';
+            if (++p < end && *p == '\n')
+                ++p;
+        }
+        else if (attribute && (c == '\t' || c == '\n'))
+        {
+            *w++ = ' ';
+            ++p;
+        }
+        else
+            *w++ = *p++;
+    }
+
+    return w;
+}
+
+/**
+ * Split a qualified name in place.
+ */
+static inline void
+split(char* name, const char*& prefix, const char*& localName)
+{
+    char* colon = strchr(name, ':');
+    if (colon != NULL)
+    {
+        *colon = '\0';
+        prefix = name;
+        localName = colon + 1;
+    }
+    else
+    {
+        prefix = "";
+        localName = name;
+    }
+}
+
+/*********************************************************************
+ *
+ * InSituTokenizer
+ *
+ *********************************************************************/
+
+InSituTokenizer::InSituTokenizer(Handler& handler)
+    : _handler(handler)
+    , _rootClosed(false)
+{}
+
+bool
+InSituTokenizer::tokenize(char* buffer, size_t size)
+{
+    _rootClosed = false;
+    _bindings.clear();
+    _open.clear();
+
+    char* p = buffer;
+    char* const end = buffer + size;
+
+    // UTF-8 byte order mark
+    if (startsWith(p, "\xEF\xBB\xBF"))
+        p += 3;
+
+    const char* const start = p;
+
+    while (p < end)
+    {
+        if (*p != '<')
+        {
+            char* text = p;
+            char* lt = p + strcspn(p, "<");
+            if (lt != end && *lt != '<')
+                return false;   // NUL in the document
+
+            if (_open.empty())
+            {
+                // Only whitespace around the root element
+                for (; p < lt; ++p)
+                {
+                    if (! isSpace(*p))
+                        return false;
+                }
+            }
+            else
+            {
+                char* textEnd = decode(text, lt, false);
+                if (textEnd == NULL)
+                    return false;
+
+                // Possibly over the '<'
+                *textEnd = '\0';
+                if (textEnd != text)
+                    _handler.characters(text, textEnd - text);
+            }
+
+            if (lt == end)
+                break;
+            p = lt;
+        }
+
+        // *p is (or was) '<'
+        ++p;
+
+        if (*p == '/')
+            p = endTag(p + 1);
+        else if (*p == '!')
+            p = markupDeclaration(p + 1);
+        else if (*p == '?')
+            p = processingInstruction(p + 1, start);
+        else
+            p = startTag(p);
+
+        if (p == NULL)
+            return false;
+    }
+
+    return _rootClosed && _open.empty();
+}
+
+char*
+InSituTokenizer::startTag(char* p)
+{
+    // A single root element
+    if (_open.empty() && _rootClosed)
+        return NULL;
+
+    if (! isNameStart(*p))
+        return NULL;
+
+    char* name = p;
+    char* nameEnd = p = skipName(p);
+
+    const size_t bindings = _bindings.size();
+    _rawAttributes.clear();
+
+    for (;;)
+    {
+        const bool spaced = isSpace(*p);
+        p = skipSpaces(p);
+
+        if (*p == '>' || *p == '/')
+            break;
+
+        if (! spaced || ! isNameStart(*p))
+            return NULL;
+
+        char* attributeName = p;
+        char* attributeNameEnd = p = skipName(p);
+
+        p = skipSpaces(p);
+        if (*p != '=')
+            return NULL;
+        p = skipSpaces(p + 1);
+
+        const char quote = *p;
+        if (quote != '"' && quote != '\'')
+            return NULL;
+
+        char* value = ++p;
+        while (*p != quote && *p != '<' && *p != '\0')
+            ++p;
+        if (*p != quote)
+            return NULL;
+
+        char* valueEnd = decode(value, p, true);
+        if (valueEnd == NULL)
+            return NULL;
+        ++p;
+
+        // Over the '=' (or a space) and the quote, read already
+        *attributeNameEnd = '\0';
+        *valueEnd = '\0';
+
+        if (strcmp(attributeName, "xmlns") == 0)
+        {
+            Binding binding = { "", value };
+            _bindings.push_back(binding);
+        }
+        else if (startsWith(attributeName, "xmlns:"))
+        {
+            // Prefixes can't be undeclared in XML 1.0
+            if (valueEnd == value)
+                return NULL;
+
+            Binding binding = { attributeName + 6, value };
+            _bindings.push_back(binding);
+        }
+        else
+        {
+            RawAttribute attribute = {
+                attributeName, value, static_cast<size_t>(valueEnd - value)
+            };
+            _rawAttributes.push_back(attribute);
+        }
+    }
+
+    const bool empty = *p == '/';
+    if (empty)
+    {
+        if (p[1] != '>')
+            return NULL;
+        p += 2;
+    }
+    else
+        ++p;
+
+    // Over a space, the '>' or the '/', read already
+    *nameEnd = '\0';
+
+    // Resolved once all the declarations of the element are known
+    OpenElement element;
+    element.bindings = bindings;
+    split(name, element.prefix, element.localName);
+
+    const char* namespaceURI = lookup(element.prefix);
+    if (namespaceURI == NULL)
+        return NULL;
+
+    _attributes.resize(_rawAttributes.size());
+    for (size_t i = 0; i < _rawAttributes.size(); ++i)
+    {
+        Attribute& attribute = _attributes[i];
+        split(_rawAttributes[i].name, attribute.prefix, attribute.localName);
+        attribute.value = _rawAttributes[i].value;
+        attribute.valueSize = _rawAttributes[i].valueSize;
+
+        // Unprefixed attributes are in no namespace
+        attribute.namespaceURI = *attribute.prefix ? lookup(attribute.prefix) : "";
+        if (attribute.namespaceURI == NULL)
+            return NULL;
+
+        for (size_t j = 0; j < i; ++j)
+        {
+            if (strcmp(_attributes[j].localName, attribute.localName) == 0
+                    && strcmp(_attributes[j].namespaceURI, attribute.namespaceURI) == 0)
+                return NULL;
+        }
+    }
+
+    _handler.startElement(namespaceURI,
+                          element.prefix,
+                          element.localName,
+                          _attributes.empty() ? NULL : &_attributes[0],
+                          _attributes.size());
+
+    _open.push_back(element);
+    if (empty)
+        closeElement();
+
+    return p;
+}
+
+char*
+InSituTokenizer::endTag(char* p)
+{
+    if (_open.empty())
+        return NULL;
+
+    char* name = p;
+    char* nameEnd = p = skipName(p);
+    p = skipSpaces(p);
+    if (*p != '>')
+        return NULL;
+
+    // Matches the qualified name of the start tag
+    const OpenElement& element = _open.back();
+    const size_t prefixLength = strlen(element.prefix);
+    const size_t localNameLength = strlen(element.localName);
+    if (prefixLength > 0)
+    {
+        if (static_cast<size_t>(nameEnd - name) != prefixLength + 1 + localNameLength
+                || strncmp(name, element.prefix, prefixLength) != 0
+                || name[prefixLength] != ':'
+                || strncmp(name + prefixLength + 1, element.localName, localNameLength) != 0)
+            return NULL;
+    }
+    else if (static_cast<size_t>(nameEnd - name) != localNameLength
+                || strncmp(name, element.localName, localNameLength) != 0)
+        return NULL;
+
+    closeElement();
+    return p + 1;
+}
+
+char*
+InSituTokenizer::markupDeclaration(char* p)
+{
+    if (startsWith(p, "--"))
+    {
+        char* commentEnd = strstr(p + 2, "-->");
+        return commentEnd != NULL ? commentEnd + 3 : NULL;
+    }
+
+    if (startsWith(p, "[CDATA["))
+    {
+        if (_open.empty())
+            return NULL;
+
+        char* data = p + 7;
+        char* dataEnd = strstr(data, "]]>");
+        if (dataEnd == NULL)
+            return NULL;
+
+        *dataEnd = '\0';
+        if (dataEnd != data)
+            _handler.characters(data, dataEnd - data);
+        return dataEnd + 3;
+    }
+
+    if (startsWith(p, "DOCTYPE"))
+    {
+        if (! _open.empty() || _rootClosed)
+            return NULL;
+
+        // Without an internal subset, which could declare entities
+        while (*p != '>' && *p != '[' && *p != '\0')
+            ++p;
+        return *p == '>' ? p + 1 : NULL;
+    }
+
+    return NULL;
+}
+
+char*
+InSituTokenizer::processingInstruction(char* p, const char* start)
+{
+    char* target = p;
+    char* targetEnd = skipName(p);
+    if (targetEnd == target)
+        return NULL;
+
+    char* instructionEnd = strstr(targetEnd, "?>");
+    if (instructionEnd == NULL)
+        return NULL;
+
+    if (targetEnd - target == 3 && strncmp(target, "xml", 3) == 0)
+    {
+        // The XML declaration only starts the document
+        if (target - 2 != start)
+            return NULL;
+
+        // Strings are passed as they are
+        *instructionEnd = '\0';
+        const char* encoding = strstr(targetEnd, "encoding");
+        if (encoding != NULL)
+        {
+            encoding = strpbrk(encoding, "\"'");
+            if (encoding == NULL)
+                return NULL;
+            ++encoding;
+
+            if (strncasecmp(encoding, "utf-8", 5) != 0
+                    && strncasecmp(encoding, "us-ascii", 8) != 0)
+                return NULL;
+        }
+    }
+
+    return instructionEnd + 2;
+}
+
+const char*
+InSituTokenizer::lookup(const char* prefix) const
+{
+    for (std::vector<Binding>::const_reverse_iterator it = _bindings.rbegin();
+         it != _bindings.rend();
+         ++it)
+    {
+        if (strcmp(it->prefix, prefix) == 0)
+            return it->namespaceURI;
+    }
+
+    if (*prefix == '\0')
+        return "";
+    if (strcmp(prefix, "xml") == 0)
+        return XML_NAMESPACE;
+    return NULL;
+}
+
+void
+InSituTokenizer::closeElement()
+{
+    _handler.endElement();
+
+    _bindings.resize(_open.back().bindings);
+    _open.pop_back();
+
+    if (_open.empty())
+        _rootClosed = true;
+}
+
+}
+}
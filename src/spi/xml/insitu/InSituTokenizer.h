@@ -0,0 +1,149 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_SPI_INSITUTOKENIZER_H_
+#define WPS_SPI_INSITUTOKENIZER_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace WPS {
+namespace SPI {
+
+/**
+ * Tokenizes an XML document in place, without copying or allocating
+ * its strings: names and values are terminated by NUL characters
+ * written over the markup that follows them, and entities are decoded
+ * where they are.
+ * \n
+ * Supports what the server's responses use: UTF-8 (or ASCII) documents
+ * with namespaces, the predefined entities and character references,
+ * CDATA sections, comments and processing instructions. Documents with
+ * an internal DTD subset or another encoding aren't well-formed here.
+ */
+class InSituTokenizer
+{
+public:
+
+    /**
+     * An attribute of an element, namespace declarations excluded.
+     */
+    struct Attribute
+    {
+        const char* namespaceURI;   // "" if none
+        const char* prefix;         // "" if none
+        const char* localName;
+        const char* value;
+        std::size_t valueSize;
+    };
+
+    /**
+     * Receives the content of the document as it's tokenized.
+     * \n
+     * The strings passed point into the buffer, are NUL-terminated,
+     * and remain valid as long as the buffer.
+     */
+    class Handler
+    {
+    public:
+
+        virtual ~Handler()
+        {}
+
+        virtual void startElement(const char* namespaceURI,
+                                  const char* prefix,
+                                  const char* localName,
+                                  const Attribute* attributes,
+                                  std::size_t size) =0;
+
+        virtual void endElement() =0;
+
+        /**
+         * Text or CDATA section, which are never empty.
+         */
+        virtual void characters(const char* data, std::size_t size) =0;
+    };
+
+    explicit InSituTokenizer(Handler& handler);
+
+    /**
+     * @param buffer the document, followed by a NUL character
+     *               at <code>buffer[size]</code>.
+     * @param size the size of the document
+     *
+     * @return <code>false</code> if the document isn't well-formed,
+     *         in which case the handler may have received part of it.
+     */
+    bool tokenize(char* buffer, std::size_t size);
+
+private:
+
+    struct Binding
+    {
+        const char* prefix;
+        const char* namespaceURI;
+    };
+
+    struct OpenElement
+    {
+        const char* prefix;
+        const char* localName;
+        std::size_t bindings;       // in scope in the parent
+    };
+
+    /**
+     * An attribute before its namespace is resolved.
+     */
+    struct RawAttribute
+    {
+        char* name;
+        const char* value;
+        std::size_t valueSize;
+    };
+
+    char* startTag(char* p);
+    char* endTag(char* p);
+    char* markupDeclaration(char* p);
+    char* processingInstruction(char* p, const char* buffer);
+
+    /**
+     * @return the namespace bound to \c prefix, \c NULL if none.
+     */
+    const char* lookup(const char* prefix) const;
+
+    void closeElement();
+
+private:
+
+    InSituTokenizer(const InSituTokenizer&);
+    InSituTokenizer& operator=(const InSituTokenizer&);
+
+private:
+
+    Handler& _handler;
+    bool _rootClosed;
+
+    // Reused from one document to the next
+    std::vector<Binding> _bindings;
+    std::vector<OpenElement> _open;
+    std::vector<RawAttribute> _rawAttributes;
+    std::vector<Attribute> _attributes;
+};
+
+}
+}
+
+#endif
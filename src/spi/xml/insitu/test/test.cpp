@@ -0,0 +1,381 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "LocationRSDecoder.h"
+#include "Protocol.h"
+
+#include "spi/XmlParser.h"
+
+#ifdef TEST_INSITU_TOKENIZER
+#  include "InSituTokenizer.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "spi/Assert.h"
+
+using namespace WPS::API;
+using namespace WPS::SPI;
+
+inline void assert_delta(double n, double n1, double d = 0.00001)
+{
+    assert(std::fabs(n - n1) < d);
+}
+
+/*
+ * Malformed documents that every backend must reject
+ */
+static const char* const MALFORMED[] =
+{
+    "",
+    "<LocationRS",
+    "<LocationRS><location>",
+    "<LocationRS><location></LocationRS>",
+    "<LocationRS></location>",
+    "<LocationRS a='1' a='2'/>",
+    "<LocationRS a='1' a=\"1\"/>",
+    "<LocationRS>&#0;</LocationRS>",
+    "<LocationRS>&#x0;</LocationRS>",
+    "<LocationRS>&#x110000;</LocationRS>",
+    "<LocationRS>&#4294967346;</LocationRS>",
+    "<LocationRS>&#x10000000000000041;</LocationRS>",
+    "<LocationRS>&#;</LocationRS>",
+    "<LocationRS>&bogus;</LocationRS>",
+    "<LocationRS/><LocationRS/>",
+    "<LocationRS/>text",
+    "<LocationRS a=1/>",
+    "<LocationRS><![CDATA[x</LocationRS>",
+    "<LocationRS><!-- x </LocationRS>"
+};
+
+/*
+ * Documents valid as XML 1.0 but not as namespace-well-formed XML,
+ * or beyond what the in-situ tokenizer supports
+ */
+static const char* const MALFORMED_IN_SITU[] =
+{
+    "<p:LocationRS/>",
+    "<LocationRS p:a='1'/>",
+    "<LocationRS xmlns:p='urn:p'><p:location/></LocationRS><p:x/>",
+    "<LocationRS xmlns:p='urn:p' xmlns:q='urn:p' p:a='1' q:a='2'/>",
+    "<!DOCTYPE LocationRS [<!ENTITY e 'x'>]><LocationRS>&e;</LocationRS>",
+    "<!DOCTYPE LocationRS [<!ELEMENT LocationRS ANY>]><LocationRS/>",
+    "<?xml version='1.0' encoding='ISO-8859-1'?><LocationRS/>"
+};
+
+struct ExpectedLocation
+{
+    double latitude;
+    double longitude;
+    double hpe;
+    unsigned short nap;
+    unsigned short nsat;
+    unsigned short ncell;
+    unsigned short nlac;
+};
+
+struct LocationRS
+{
+    const char* xml;
+    std::size_t size;
+    const ExpectedLocation* locations;
+};
+
+static const ExpectedLocation ONE_LOCATION[] =
+{
+    { 42.351599, -71.048601, 25, 42, 3, 1, 2 }
+};
+
+static const ExpectedLocation SEVERAL_LOCATIONS[] =
+{
+    { -1.5, 2.25, 10, 7, 0, 0, 0 },
+    { 3, 0, 0, 0, 0, 0, 0 },
+    { 4, 0, 0, 0, 0, 0, 0 }
+};
+static const LocationRS LOCATION_RS[] =
+{
+    {
+        "<?xml version='1.0'?>"
+        "<LocationRS version='2.26' xmlns='http://skyhookwireless.com/wps/2005'>"
+            "<location nap='42' ncell='1' nsat='3' nlac='2' age='500' rqtime='0'>"
+                "<latitude>42.351599</latitude>"
+                "<longitude>-71.048601</longitude>"
+                "<hpe>25</hpe>"
+            "</location>"
+        "</LocationRS>",
+        1,
+        ONE_LOCATION
+    },
+    {
+        "<LocationRS xmlns='http://skyhookwireless.com/wps/2005' xmlns:x='urn:x'>\n"
+        "  <x:location nap='1'><latitude>1</latitude></x:location>\n"
+        "  <location x:nap='9' nap='7' age='10'>\n"
+        "    <hpe>1&#x30;</hpe>"
+            "<latitude>-1.5</latitude>"
+            "<latitude>9</latitude>"
+            "<longitude><![CDATA[2.25]]></longitude>"
+        "  </location>\n"
+        "  <location rqtime='1000'><latitude>3</latitude></location>"
+        "<location><!-- c --><latitude>4<?pi?></latitude></location>"
+        "</LocationRS>",
+        3,
+        SEVERAL_LOCATIONS
+    },
+    {
+        "<LocationRS xmlns='http://skyhookwireless.com/wps/2005'>"
+            "<error>Unable to locate</error>"
+        "</LocationRS>",
+        0,
+        NULL
+    },
+    {
+        "<LocationRS xmlns='http://skyhookwireless.com/wps/2005'>"
+            "<location><latitude>1</latitude></location>"
+        "</LocationRS>garbage",
+        0,
+        NULL
+    },
+    {
+        "<LocationRS xmlns='http://skyhookwireless.com/wps/2005'>"
+            "<location><latitude>1</latitude></location>",
+        0,
+        NULL
+    }
+};
+
+static const std::size_t LOCATION_RS_SIZE = sizeof(LOCATION_RS) / sizeof(*LOCATION_RS);
+
+void assert_locations(const LocationRS& expected,
+                      bool parsed,
+                      const std::vector<LiteLocation>& locations)
+{
+    assert(parsed == (expected.size > 0));
+    assert(locations.size() == expected.size);
+
+    for (std::size_t i = 0; i < locations.size(); ++i)
+    {
+        const ExpectedLocation& e = expected.locations[i];
+        const LiteLocation& l = locations[i];
+
+        assert_delta(l.latitude, e.latitude);
+        assert_delta(l.longitude, e.longitude);
+        assert_delta(l.hpe, e.hpe);
+        assert(l.nap == e.nap);
+        assert(l.nsat == e.nsat);
+        assert(l.ncell == e.ncell);
+        assert(l.nlac == e.nlac);
+    }
+}
+
+void test_parse_location_rs()
+{
+    std::auto_ptr<XmlParser> parser(XmlParser::newInstance());
+
+    for (std::size_t d = 0; d < LOCATION_RS_SIZE; ++d)
+    {
+        const std::string xml(LOCATION_RS[d].xml);
+        std::auto_ptr<DOMDocument> doc(parser->parse(xml.data(), xml.size()));
+
+        std::vector<LiteLocation> locations;
+        const bool parsed =
+            doc.get() != NULL && Protocol::parseLocationRS(doc.get(), 0, locations);
+
+        assert_locations(LOCATION_RS[d], parsed, locations);
+    }
+}
+
+void test_decode_location_rs()
+{
+    LocationRSDecoder decoder;
+
+    for (std::size_t d = 0; d < LOCATION_RS_SIZE; ++d)
+    {
+        const std::string xml(LOCATION_RS[d].xml);
+
+        // Every way the response may be split as it's received
+        for (std::size_t chunk = 1; chunk <= xml.size(); ++chunk)
+        {
+            decoder.begin();
+            for (std::size_t i = 0; i < xml.size(); i += chunk)
+                decoder.data(xml.data() + i, std::min(chunk, xml.size() - i));
+
+            std::vector<LiteLocation> locations;
+            const bool decoded = decoder.getLocations(locations);
+
+            assert_locations(LOCATION_RS[d], decoded, locations);
+        }
+    }
+}
+
+class NullContentHandler
+    : public XmlContentHandler
+{
+public:
+
+    void startElement(const char*, const char*, const XmlAttribute*, std::size_t)
+    {}
+
+    void endElement()
+    {}
+
+    void characters(const char*, std::size_t)
+    {}
+};
+
+void assert_malformed(const char* xml)
+{
+    const std::size_t size = std::strlen(xml);
+
+    std::auto_ptr<XmlParser> parser(XmlParser::newInstance());
+    std::auto_ptr<DOMDocument> doc(parser->parse(xml, size));
+    assert(doc.get() == NULL);
+
+    NullContentHandler handler;
+    std::auto_ptr<XmlPushParser> pushParser(XmlPushParser::newInstance(handler));
+
+    for (std::size_t chunk = 1; chunk <= std::max(size, std::size_t(1)); ++chunk)
+    {
+        pushParser->reset();
+
+        bool wellFormed = true;
+        for (std::size_t i = 0; wellFormed && i < size; i += chunk)
+            wellFormed = pushParser->parse(xml + i, std::min(chunk, size - i));
+
+        assert(! wellFormed || ! pushParser->finish());
+    }
+}
+
+void test_malformed()
+{
+    for (std::size_t i = 0; i < sizeof(MALFORMED) / sizeof(*MALFORMED); ++i)
+        assert_malformed(MALFORMED[i]);
+}
+
+#ifdef TEST_INSITU_TOKENIZER
+
+void test_malformed_in_situ()
+{
+    for (std::size_t i = 0; i < sizeof(MALFORMED_IN_SITU) / sizeof(*MALFORMED_IN_SITU); ++i)
+        assert_malformed(MALFORMED_IN_SITU[i]);
+}
+
+/**
+ * Writes what it receives as markup, with namespaces in braces.
+ */
+class RecordingHandler
+    : public InSituTokenizer::Handler
+{
+public:
+
+    void startElement(const char* namespaceURI,
+                      const char* prefix,
+                      const char* localName,
+                      const InSituTokenizer::Attribute* attributes,
+                      std::size_t size)
+    {
+        _names.push_back(std::string("{") + namespaceURI + "}" + localName);
+        record << "<" << _names.back();
+        if (*prefix)
+            record << "(" << prefix << ")";
+
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            assert(std::strlen(attributes[i].value) == attributes[i].valueSize);
+
+            record << " {" << attributes[i].namespaceURI << "}"
+                   << attributes[i].localName
+                   << "=[" << attributes[i].value << "]";
+        }
+
+        record << ">";
+    }
+
+    void endElement()
+    {
+        record << "</" << _names.back() << ">";
+        _names.pop_back();
+    }
+
+    void characters(const char* data, std::size_t size)
+    {
+        assert(size > 0);
+        record << "[" << std::string(data, size) << "]";
+    }
+
+    std::ostringstream record;
+
+private:
+
+    std::vector<std::string> _names;
+};
+
+std::string tokenize(const char* xml)
+{
+    std::vector<char> buffer(xml, xml + std::strlen(xml) + 1);
+
+    RecordingHandler handler;
+    InSituTokenizer tokenizer(handler);
+    assert(tokenizer.tokenize(&buffer[0], buffer.size() - 1));
+
+    return handler.record.str();
+}
+
+void test_tokenize()
+{
+    assert(tokenize("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                    "<r xmlns=\"urn:d\" xmlns:x=\"urn:x\" a=\"1 &amp; 2\">"
+                    "<x:e x:a=\"q&#65;&#x42;\" a=\"  s\tp \">"
+                    "<![CDATA[<raw>]]>t&lt;x</x:e><!-- c --><e/>\ntail</r>\n")
+           == "<{urn:d}r {}a=[1 & 2]>"
+              "<{urn:x}e(x) {urn:x}a=[qAB] {}a=[  s p ]>[<raw>][t<x]</{urn:x}e>"
+              "<{urn:d}e></{urn:d}e>[\ntail]"
+              "</{urn:d}r>");
+
+    // Prefixes are scoped to the element declaring them
+    assert(tokenize("<r xmlns:p=\"urn:p\"><p:q xmlns:p=\"urn:o\"><p:z/></p:q><p:y/></r>")
+           == "<{}r><{urn:o}q(p)><{urn:o}z(p)></{urn:o}z></{urn:o}q>"
+              "<{urn:p}y(p)></{urn:p}y></{}r>");
+
+    // Undeclaring the default namespace
+    assert(tokenize("<r xmlns=\"urn:d\"><e xmlns=\"\"/></r>")
+           == "<{urn:d}r><{}e></{}e></{urn:d}r>");
+
+    // Characters beyond the BMP, and the largest one allowed
+    assert(tokenize("<r>&#x1F600;&#1114111;</r>")
+           == "<{}r>[\xF0\x9F\x98\x80\xF4\x8F\xBF\xBF]</{}r>");
+}
+
+#endif
+
+int main(int argc, char* argv[])
+{
+    test_parse_location_rs();
+    test_decode_location_rs();
+    test_malformed();
+#ifdef TEST_INSITU_TOKENIZER
+    test_malformed_in_situ();
+    test_tokenize();
+#endif
+
+    return 0;
+}
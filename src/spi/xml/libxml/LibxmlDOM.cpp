@@ -15,13 +15,19 @@
  */
 
 #include "LibxmlDOM.h"
+#include "LibxmlParser.h"
+
+#include "spi/Concurrent.h"
 
 #if defined(__linux__) || defined(__APPLE__) || defined(__CYGWIN__)
 #  include "iconvert.h"
+#  include <langinfo.h>
+#  include <strings.h>
 #endif
 
 #include <cwchar>
 #include <memory>
+#include <vector>
 
 namespace WPS {
 namespace SPI {
@@ -30,18 +36,192 @@ namespace SPI {
 
 typedef std::basic_string<xmlChar> xstring;
 
+/**
+ * iconv converters between UTF-8 and the charset of the current locale,
+ * kept open rather than opened for every string.
+ * \n
+ * A converter is only used by one thread at a time,
+ * those that aren't in use are kept here.
+ */
+class Converters
+{
+public:
+
+    enum Direction
+    {
+        FROM_UTF8,
+        TO_UTF8
+    };
+
+    Converters()
+        : _mutex(Mutex::newInstance())
+    {}
+
+    ~Converters()
+    {
+        close();
+    }
+
+    /**
+     * @return a converter in \c direction, <tt>(iconv_t) -1</tt>
+     *         if the current charset isn't supported.
+     */
+    iconv_t acquire(Direction direction)
+    {
+        const char* codeset = nl_langinfo(CODESET);
+
+        {
+            Guard guard(_mutex.get());
+
+            // Those of the previous locale are of no use anymore
+            if (_codeset != codeset)
+            {
+                close();
+                _codeset = codeset;
+            }
+
+            if (! _idle[direction].empty())
+            {
+                iconv_t converter = _idle[direction].back();
+                _idle[direction].pop_back();
+                return converter;
+            }
+        }
+
+        return direction == FROM_UTF8
+            ? iconv_open(codeset, "utf-8")
+            : iconv_open("utf-8", codeset);
+    }
+
+    void release(Direction direction, iconv_t converter)
+    {
+        {
+            Guard guard(_mutex.get());
+
+            if (_codeset == nl_langinfo(CODESET)
+                    && _idle[direction].size() < MAX_IDLE)
+            {
+                _idle[direction].push_back(converter);
+                return;
+            }
+        }
+
+        iconv_close(converter);
+    }
+
+private:
+
+    void close()
+    {
+        for (int direction = FROM_UTF8; direction <= TO_UTF8; ++direction)
+        {
+            for (size_t i = 0; i < _idle[direction].size(); ++i)
+                iconv_close(_idle[direction][i]);
+            _idle[direction].clear();
+        }
+    }
+
+private:
+
+    static const size_t MAX_IDLE = 4;
+
+    std::auto_ptr<Mutex> _mutex;
+    std::string _codeset;
+    std::vector<iconv_t> _idle[TO_UTF8 + 1];
+};
+
+static Converters&
+converters()
+{
+    static Converters converters;
+    return converters;
+}
+
+/**
+ * A converter borrowed from \c converters() for a single conversion.
+ */
+class PooledConverter
+{
+public:
+
+    explicit PooledConverter(Converters::Direction direction)
+        : _direction(direction)
+        , _converter(converters().acquire(direction))
+    {}
+
+    ~PooledConverter()
+    {
+        if (_converter != (iconv_t) -1)
+            converters().release(_direction, _converter);
+    }
+
+    iconv_t get() const
+    {
+        return _converter;
+    }
+
+private:
+
+    PooledConverter(const PooledConverter&);
+    PooledConverter& operator=(const PooledConverter&);
+
+private:
+
+    const Converters::Direction _direction;
+    const iconv_t _converter;
+};
+
+/**
+ * @return \c true if converting \c str between UTF-8
+ *         and the charset of the current locale leaves it as is.
+ */
+static inline bool
+isIdentity(const char* str, size_t length)
+{
+    const char* codeset = nl_langinfo(CODESET);
+    if (strcasecmp(codeset, "UTF-8") == 0 || strcasecmp(codeset, "utf8") == 0)
+        return true;
+
+    // ASCII is the same in every charset a locale may use
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (static_cast<unsigned char>(str[i]) >= 0x80)
+            return false;
+    }
+
+    return true;
+}
+
 static inline std::string
 to_string(const xmlChar* p_xml)
 {
     if (! p_xml)
         return "";
-    return iconvert<xmlChar, char>("utf-8", "", p_xml, xmlStrlen(p_xml));
+
+    const char* str = reinterpret_cast<const char*>(p_xml);
+    const size_t length = xmlStrlen(p_xml);
+    if (isIdentity(str, length))
+        return std::string(str, length);
+
+    PooledConverter converter(Converters::FROM_UTF8);
+    if (converter.get() == (iconv_t) -1)
+        return "";
+    return iconvert<xmlChar, char>(converter.get(), p_xml, length);
 }
 
 static inline xstring
 to_xstring(const std::string& str)
 {
-    return iconvert<char, xmlChar>("", "utf-8", str.c_str(), str.length());
+    if (isIdentity(str.c_str(), str.length()))
+    {
+        const xmlChar* p_xml = reinterpret_cast<const xmlChar*>(str.c_str());
+        return xstring(p_xml, str.length());
+    }
+
+    PooledConverter converter(Converters::TO_UTF8);
+    if (converter.get() == (iconv_t) -1)
+        return xstring();
+    return iconvert<char, xmlChar>(converter.get(), str.c_str(), str.length());
 }
 
 #else
@@ -169,16 +349,30 @@ LibxmlDOMNode::getAttributeNodeNS(const std::string& namespaceURI,
 
 LibxmlDOMNodeList::LibxmlDOMNodeList(xmlNode* nodeList)
     : _p_nodeList(nodeList)
+    , _p_last(nodeList)
+    , _lastIndex(0)
 {}
 
 DOMNode*
 LibxmlDOMNodeList::getItem(unsigned long index) const
 {
+    // Resume from the last item rather than the head when we can
     unsigned long i = 0;
-    for (xmlNode* iter = _p_nodeList; iter;  iter = iter->next, ++i)
+    xmlNode* iter = _p_nodeList;
+    if (_p_last && index >= _lastIndex)
+    {
+        i = _lastIndex;
+        iter = _p_last;
+    }
+
+    for (; iter; iter = iter->next, ++i)
     {
         if (index == i)
+        {
+            _p_last = iter;
+            _lastIndex = i;
             return new LibxmlDOMNode(iter);
+        }
     }
 
     return 0;
@@ -199,14 +393,19 @@ LibxmlDOMNodeList::getLength() const
 /*                                                                   */
 /*********************************************************************/
 
-LibxmlDOMDocument::LibxmlDOMDocument(xmlDoc* p_doc)
+LibxmlDOMDocument::LibxmlDOMDocument(xmlDoc* p_doc, xmlParserCtxt* p_ctxt)
     : _p_doc(p_doc)
+    , _p_ctxt(p_ctxt)
 {}
 
 LibxmlDOMDocument::~LibxmlDOMDocument()
 {
     if (_p_doc)
         xmlFreeDoc(_p_doc);
+
+    // Only once the document no longer uses its dictionary
+    if (_p_ctxt)
+        LibxmlParser::releaseContext(_p_ctxt);
 }
 
 DOMNode*
@@ -215,5 +414,83 @@ LibxmlDOMDocument::getDocumentElement() const
     return new LibxmlDOMNode(xmlDocGetRootElement(_p_doc));
 }
 
+static inline const xmlNode*
+to_node(const void* node)
+{
+    return static_cast<const xmlNode*>(node);
+}
+
+static inline const char*
+to_chars(const xmlChar* p_xml)
+{
+    return p_xml ? reinterpret_cast<const char*>(p_xml) : "";
+}
+
+static inline const xmlChar*
+to_xmlChars(const char* s)
+{
+    return reinterpret_cast<const xmlChar*>(s);
+}
+
+const void*
+LibxmlDOMDocument::getRootNode() const
+{
+    return _p_doc ? xmlDocGetRootElement(_p_doc) : 0;
+}
+
+const void*
+LibxmlDOMDocument::getFirstChild(const void* node) const
+{
+    return to_node(node)->children;
+}
+
+const void*
+LibxmlDOMDocument::getNextSibling(const void* node) const
+{
+    return to_node(node)->next;
+}
+
+bool
+LibxmlDOMDocument::isElement(const void* node,
+                             const char* namespaceURI,
+                             const char* localName) const
+{
+    const xmlNode* p_node = to_node(node);
+    if (p_node->type != XML_ELEMENT_NODE)
+        return false;
+
+    const xmlChar* ns = p_node->ns ? p_node->ns->href : 0;
+    return xmlStrEqual(p_node->name, to_xmlChars(localName))
+        && nsEqual(ns, to_xmlChars(namespaceURI));
+}
+
+const char*
+LibxmlDOMDocument::getText(const void* node) const
+{
+    // See LibxmlDOMNode::getNodeValue()
+    const xmlNode* p_node = to_node(node);
+    return to_chars(p_node->children ? p_node->children->content : 0);
+}
+
+const char*
+LibxmlDOMDocument::getAttributeNS(const void* node,
+                                  const char* namespaceURI,
+                                  const char* localName) const
+{
+    const xmlNode* p_node = to_node(node);
+    if (p_node->type != XML_ELEMENT_NODE)
+        return "";
+
+    for (xmlAttr* iter = p_node->properties; iter; iter = iter->next)
+    {
+        const xmlChar* ns = iter->ns ? iter->ns->href : 0;
+        if (nsEqual(ns, to_xmlChars(namespaceURI))
+                && xmlStrEqual(iter->name, to_xmlChars(localName)))
+            return to_chars(iter->children ? iter->children->content : 0);
+    }
+
+    return "";
+}
+
 }
 }
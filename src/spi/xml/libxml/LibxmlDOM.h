@@ -78,6 +78,10 @@ private:
     // libxml has no functional list support, it's just an old-fashioned
     // "struct with a pointer to next" type of list.
     xmlNode* _p_nodeList;
+
+    // The last item returned, so that iterating by index is linear
+    mutable xmlNode* _p_last;
+    mutable unsigned long _lastIndex;
 };
 
 /*********************************************************************/
@@ -91,14 +95,33 @@ class LibxmlDOMDocument
 {
 public:
 
-    LibxmlDOMDocument(xmlDoc* p_doc);
+    /**
+     * @param p_ctxt the context that parsed the document, whose dictionary
+     *               the document uses, or \c NULL. It is returned to the
+     *               parser once the document is freed.
+     */
+    LibxmlDOMDocument(xmlDoc* p_doc, xmlParserCtxt* p_ctxt = NULL);
     ~LibxmlDOMDocument();
     
     DOMNode* getDocumentElement() const;
 
+protected:
+
+    const void* getRootNode() const;
+    const void* getFirstChild(const void* node) const;
+    const void* getNextSibling(const void* node) const;
+    bool isElement(const void* node,
+                   const char* namespaceURI,
+                   const char* localName) const;
+    const char* getText(const void* node) const;
+    const char* getAttributeNS(const void* node,
+                               const char* namespaceURI,
+                               const char* localName) const;
+
 private:
 
     xmlDoc* _p_doc;
+    xmlParserCtxt* _p_ctxt;
 };
 
 }
@@ -17,11 +17,101 @@
 #include "LibxmlDOM.h"
 #include "LibxmlParser.h"
 
+#include "spi/Concurrent.h"
+
+#include <libxml/dict.h>
 #include <libxml/parser.h>
 
+#include <memory>
+#include <vector>
+
 namespace WPS {
 namespace SPI {
 
+/*********************************************************************
+ *
+ * Parser contexts
+ *
+ *********************************************************************/
+
+/**
+ * Parser contexts kept between documents, rather than a new context
+ * and dictionary for each one.
+ * \n
+ * A context is only used by one thread at a time,
+ * those that aren't in use are kept here.
+ * \n
+ * Documents use the dictionary of their context, which isn't thread-safe,
+ * so a context is only released once its document has been freed.
+ */
+class ParserContexts
+{
+public:
+
+    ParserContexts()
+        : _mutex(Mutex::newInstance())
+    {}
+
+    ~ParserContexts()
+    {
+        for (size_t i = 0; i < _idle.size(); ++i)
+            xmlFreeParserCtxt(_idle[i]);
+    }
+
+    /**
+     * @return an idle context, or a new one if there is none.
+     */
+    xmlParserCtxt* acquire()
+    {
+        {
+            Guard guard(_mutex.get());
+
+            if (! _idle.empty())
+            {
+                xmlParserCtxt* ctxt = _idle.back();
+                _idle.pop_back();
+                return ctxt;
+            }
+        }
+
+        return xmlNewParserCtxt();
+    }
+
+    void release(xmlParserCtxt* ctxt)
+    {
+        // The dictionary keeps every name parsed so far,
+        // don't let unexpected documents grow it for good
+        if (ctxt->dict == NULL
+            || static_cast<size_t>(xmlDictSize(ctxt->dict)) <= MAX_DICT_SIZE)
+        {
+            Guard guard(_mutex.get());
+
+            if (_idle.size() < MAX_IDLE)
+            {
+                _idle.push_back(ctxt);
+                return;
+            }
+        }
+
+        xmlFreeParserCtxt(ctxt);
+    }
+
+private:
+
+    static const size_t MAX_IDLE = 4;
+    static const size_t MAX_DICT_SIZE = 256;
+
+    std::auto_ptr<Mutex> _mutex;
+    std::vector<xmlParserCtxt*> _idle;
+};
+
+static ParserContexts&
+parserContexts()
+{
+    static ParserContexts contexts;
+    return contexts;
+}
+
 /*********************************************************************
  *
  * LibxmlParser
@@ -45,14 +135,29 @@ LibxmlParser::parse(const char* xml, size_t size)
     static const int options
         = XML_PARSE_NOERROR | XML_PARSE_NOWARNING | XML_PARSE_PEDANTIC;
 
-    xmlDoc* doc = xmlReadMemory(xml, size, "", NULL, options);
+    xmlParserCtxt* ctxt = parserContexts().acquire();
+    if (! ctxt)
+    {
+        _logger.error("error creating parser context");
+        return NULL;
+    }
+
+    xmlDoc* doc = xmlCtxtReadMemory(ctxt, xml, size, "", NULL, options);
     if (! doc)
     {
+        parserContexts().release(ctxt);
         _logger.error("error parsing xml");
         return NULL;
     }
 
-    return new LibxmlDOMDocument(doc);
+    // Kept until the document is freed, as they share the dictionary
+    return new LibxmlDOMDocument(doc, ctxt);
+}
+
+void
+LibxmlParser::releaseContext(xmlParserCtxt* ctxt)
+{
+    parserContexts().release(ctxt);
 }
 
 /*********************************************************************
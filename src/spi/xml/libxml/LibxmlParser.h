@@ -20,6 +20,8 @@
 #include "spi/Logger.h"
 #include "spi/XmlParser.h"
 
+#include <libxml/parser.h>
+
 namespace WPS {
 namespace SPI {
 
@@ -33,6 +35,12 @@ public:
 
     DOMDocument* parse(const char* xml, size_t size);
 
+    /**
+     * Return the context a document was parsed with,
+     * once the document has been freed.
+     */
+    static void releaseContext(xmlParserCtxt* ctxt);
+
 private:
 
     Logger _logger;
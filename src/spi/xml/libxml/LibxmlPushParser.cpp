@@ -0,0 +1,167 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LibxmlPushParser.h"
+
+#include <string.h>
+
+namespace WPS {
+namespace SPI {
+
+/*********************************************************************
+ *
+ * LibxmlPushParser
+ *
+ *********************************************************************/
+
+// See LibxmlParser::parse()
+static const int options
+    = XML_PARSE_NOERROR | XML_PARSE_NOWARNING | XML_PARSE_PEDANTIC;
+
+static inline const char*
+to_chars(const xmlChar* s)
+{
+    return s ? reinterpret_cast<const char*>(s) : "";
+}
+
+LibxmlPushParser::LibxmlPushParser(XmlContentHandler& handler)
+    : _logger("WPS.SPI.XmlPushParser.LibxmlPushParser")
+    , _handler(handler)
+    , _ctxt(NULL)
+{
+    xmlSAXHandler sax;
+    ::memset(&sax, 0, sizeof(sax));
+    sax.initialized = XML_SAX2_MAGIC;
+    sax.startElementNs = &startElementNs;
+    sax.endElementNs = &endElementNs;
+    sax.characters = &characters;
+    sax.cdataBlock = &characters;
+
+    // Copies sax
+    _ctxt = xmlCreatePushParserCtxt(&sax, this, NULL, 0, "");
+    if (_ctxt != NULL)
+        xmlCtxtUseOptions(_ctxt, options);
+    else
+        _logger.error("error creating push parser");
+}
+
+LibxmlPushParser::~LibxmlPushParser()
+{
+    if (_ctxt != NULL)
+        xmlFreeParserCtxt(_ctxt);
+}
+
+void
+LibxmlPushParser::reset()
+{
+    if (_ctxt == NULL)
+        return;
+
+    xmlCtxtResetPush(_ctxt, NULL, 0, "", NULL);
+    xmlCtxtUseOptions(_ctxt, options);
+}
+
+bool
+LibxmlPushParser::parse(const char* data, size_t size)
+{
+    if (_ctxt == NULL || ! _ctxt->wellFormed)
+        return false;
+
+    xmlParseChunk(_ctxt, data, static_cast<int>(size), 0);
+    if (! _ctxt->wellFormed)
+    {
+        _logger.error("error parsing xml");
+        return false;
+    }
+
+    return true;
+}
+
+bool
+LibxmlPushParser::finish()
+{
+    if (_ctxt == NULL || ! _ctxt->wellFormed)
+        return false;
+
+    xmlParseChunk(_ctxt, NULL, 0, 1);
+    if (! _ctxt->wellFormed)
+    {
+        _logger.error("error parsing xml");
+        return false;
+    }
+
+    return true;
+}
+
+void
+LibxmlPushParser::startElementNs(void* ctx,
+                                 const xmlChar* localname,
+                                 const xmlChar*,
+                                 const xmlChar* URI,
+                                 int,
+                                 const xmlChar**,
+                                 int nb_attributes,
+                                 int,
+                                 const xmlChar** attributes)
+{
+    LibxmlPushParser* _this = static_cast<LibxmlPushParser*>(ctx);
+
+    // Five pointers per attribute: localname, prefix, URI, value, end
+    _this->_attributes.resize(nb_attributes);
+    for (int i = 0; i < nb_attributes; ++i, attributes += 5)
+    {
+        XmlAttribute& attribute = _this->_attributes[i];
+        attribute.namespaceURI = to_chars(attributes[2]);
+        attribute.localName = to_chars(attributes[0]);
+        attribute.value = to_chars(attributes[3]);
+        attribute.valueSize = attributes[4] - attributes[3];
+    }
+
+    _this->_handler.startElement(to_chars(URI),
+                                 to_chars(localname),
+                                 nb_attributes > 0 ? &_this->_attributes[0] : NULL,
+                                 nb_attributes);
+}
+
+void
+LibxmlPushParser::endElementNs(void* ctx,
+                               const xmlChar*,
+                               const xmlChar*,
+                               const xmlChar*)
+{
+    static_cast<LibxmlPushParser*>(ctx)->_handler.endElement();
+}
+
+void
+LibxmlPushParser::characters(void* ctx, const xmlChar* ch, int len)
+{
+    static_cast<LibxmlPushParser*>(ctx)->_handler.characters(to_chars(ch), len);
+}
+
+/*********************************************************************
+ *
+ * XmlPushParser::newInstance
+ *
+ *********************************************************************/
+
+XmlPushParser*
+XmlPushParser::newInstance(XmlContentHandler& handler)
+{
+    return new LibxmlPushParser(handler);
+}
+
+}
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2014-present Skyhook Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WPS_SPI_LIBXMLPUSHPARSER_H_
+#define WPS_SPI_LIBXMLPUSHPARSER_H_
+
+#include "spi/Logger.h"
+#include "spi/XmlPushParser.h"
+
+#include <vector>
+
+#include <libxml/parser.h>
+
+namespace WPS {
+namespace SPI {
+
+class LibxmlPushParser
+    : public XmlPushParser
+{
+public:
+
+    LibxmlPushParser(XmlContentHandler& handler);
+    ~LibxmlPushParser();
+
+    void reset();
+    bool parse(const char* data, size_t size);
+    bool finish();
+
+private:
+
+    static void startElementNs(void* ctx,
+                               const xmlChar* localname,
+                               const xmlChar* prefix,
+                               const xmlChar* URI,
+                               int nb_namespaces,
+                               const xmlChar** namespaces,
+                               int nb_attributes,
+                               int nb_defaulted,
+                               const xmlChar** attributes);
+
+    static void endElementNs(void* ctx,
+                             const xmlChar* localname,
+                             const xmlChar* prefix,
+                             const xmlChar* URI);
+
+    static void characters(void* ctx, const xmlChar* ch, int len);
+
+private:
+
+    Logger _logger;
+    XmlContentHandler& _handler;
+    xmlParserCtxt* _ctxt;
+
+    // Reused from one element to the next
+    std::vector<XmlAttribute> _attributes;
+};
+
+}
+}
+
+#endif